@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#ifdef __ANDROID__
+#include <dlfcn.h>
+#endif
+
+#include <gs101/displaycolor/displaycolor_gs101.h>
+#include <gs101/displaycolor/hdr10plus_dtm_gs101.h>
+
+/*
+ * hdr10plus::GenerateDtm() against curves computed by hand, and on a device
+ * as a reference for the DTM data of the displaycolor the HWC loads,
+ * libdisplaycolor.so or the library in $DISPLAY_COLOR_LIB.
+ */
+namespace displaycolor {
+namespace {
+
+using hdr10plus::DtmConfig;
+using hdr10plus::HdrDynamicMetadata;
+
+// luminance of posx 65535: the range of PQ
+constexpr float kInputMaxLuminance = 10000.0f;
+// of the normalized curves, at the posx of displaycolor
+constexpr double kCurveTolerance = 1.0 / 32;
+// of posy against the curves computed by hand: 1/32 of a 16-bit step
+constexpr double kPosyTolerance = 1 << (11 - 5);
+// posy of the output 1.0, when the output luminance is the targeted display
+constexpr double kPosyMax = 65535.0 * (1 << 11);
+
+std::vector<HdrDynamicMetadata> metadataSets() {
+    std::vector<HdrDynamicMetadata> sets;
+    HdrDynamicMetadata metadata;
+    metadata.is_valid = true;
+    metadata.tm_flag = 1;
+
+    // a knee and a few anchors, the scene brighter than the display
+    metadata.display_maximum_luminance = 500;
+    metadata.maxscl = {40000, 30000, 20000};
+    metadata.tm_knee_x = 1000;
+    metadata.tm_knee_y = 1500;
+    metadata.bezier_curve_anchors = {300, 600, 800};
+    sets.push_back(metadata);
+
+    // no knee, all anchors
+    metadata.tm_knee_x = 0;
+    metadata.tm_knee_y = 0;
+    metadata.bezier_curve_anchors.clear();
+    for (uint16_t i = 0; i < hdr10plus::kMaxBezierAnchors; i++)
+        metadata.bezier_curve_anchors.push_back(1023 * (i + 1) / 17 + 20);
+    sets.push_back(metadata);
+
+    // the whole PQ range, to a bright display
+    metadata.display_maximum_luminance = 1000;
+    metadata.maxscl = {0, 0, 0};
+    metadata.tm_knee_x = 2048;
+    metadata.tm_knee_y = 1024;
+    metadata.bezier_curve_anchors = {512};
+    sets.push_back(metadata);
+
+    return sets;
+}
+
+TEST(Hdr10PlusDtmTest, RangesCoverTheCurve) {
+    for (const auto &metadata : metadataSets()) {
+        DtmConfig config{};
+        ASSERT_TRUE(hdr10plus::GenerateDtm(metadata, kInputMaxLuminance, 800.0f, config));
+
+        for (size_t i = 1; i < config.tf_data.posx.size(); i++) {
+            EXPECT_GT(config.tf_data.posx[i], config.tf_data.posx[i - 1]) << "point " << i;
+            EXPECT_GE(config.tf_data.posy[i], config.tf_data.posy[i - 1]) << "point " << i;
+        }
+
+        // TM_RNGX in the scale of posx, TM_RNGY in the 9 MSBs of the 27-bit posy
+        EXPECT_EQ(config.rng_x_min, 0);
+        EXPECT_EQ(config.rng_x_max, config.tf_data.posx.back());
+        EXPECT_EQ(config.rng_y_min, 0);
+        EXPECT_EQ(config.rng_y_max, ((1u << 27) - 1) >> 18);
+        EXPECT_LE(config.tf_data.posy.back() >> 18, config.rng_y_max);
+    }
+}
+
+// Bezier curve of the control points 0, @anchors..., 1 at @t, in Bernstein form
+double bezierAt(const std::vector<double> &anchors, double t) {
+    const size_t order = anchors.size() + 1;
+    double y = 0, binomial = 1;
+    for (size_t j = 0; j <= order; j++) {
+        double p = (j == 0) ? 0.0 : (j == order) ? 1.0 : anchors[j - 1];
+        y += binomial * std::pow(t, j) * std::pow(1 - t, order - j) * p;
+        binomial = binomial * (order - j) / (j + 1);
+    }
+    return y;
+}
+
+TEST(Hdr10PlusDtmTest, MatchesHandComputedCurve) {
+    HdrDynamicMetadata metadata;
+    metadata.is_valid = true;
+    metadata.tm_flag = 1;
+    metadata.display_maximum_luminance = 1000;
+    // the scene over the whole input: posx[i] is 65535 * (i / 32)^2
+    metadata.maxscl = {100000, 0, 0};
+    // the knee at (1/3, 2/3), then the quadratic curve of the control points 0, 1, 1
+    metadata.tm_knee_x = 1365;
+    metadata.tm_knee_y = 2730;
+    metadata.bezier_curve_anchors = {1023};
+
+    DtmConfig config{};
+    ASSERT_TRUE(hdr10plus::GenerateDtm(metadata, kInputMaxLuminance, 1000.0f, config));
+    const auto &posx = config.tf_data.posx;
+    const auto &posy = config.tf_data.posy;
+
+    // below the knee, y = 2x: posx 16384
+    EXPECT_EQ(posx[16], 16384);
+    EXPECT_NEAR(posy[16], 2 * 16384 * 2048, kPosyTolerance);
+    // above the knee, y = 2/3 + (2t - t^2) / 3 where t = (x - 1/3) * 3/2
+    EXPECT_EQ(posx[20], 25600);  // t = 0.0859464, y = 0.7215020
+    EXPECT_NEAR(posy[20], 96836885.6, kPosyTolerance);
+    EXPECT_EQ(posx[24], 36863);  // t = 0.3437400, y = 0.8564409
+    EXPECT_NEAR(posy[24], 114947802.0, kPosyTolerance);
+    // the peak of the input to the peak of the display
+    EXPECT_EQ(posx[32], 65535);
+    EXPECT_NEAR(posy[32], kPosyMax, kPosyTolerance);
+
+    // all of the points against the Bernstein form of the curve
+    for (size_t i = 0; i < posx.size(); i++) {
+        double x = posx[i] / 65535.0;
+        double y = (x <= 1.0 / 3) ? 2 * x : 2.0 / 3 + bezierAt({1.0}, (x - 1.0 / 3) * 1.5) / 3;
+        EXPECT_NEAR(posy[i], y * kPosyMax, kPosyTolerance) << "point " << i;
+    }
+
+    // no knee and evenly spaced anchors: the Bezier curve is y = x
+    metadata.tm_knee_x = 0;
+    metadata.tm_knee_y = 0;
+    metadata.bezier_curve_anchors = {341, 682};
+    ASSERT_TRUE(hdr10plus::GenerateDtm(metadata, kInputMaxLuminance, 1000.0f, config));
+    for (size_t i = 0; i < posx.size(); i++) {
+        double x = posx[i] / 65535.0;
+        EXPECT_NEAR(posy[i], bezierAt({341 / 1023.0, 682 / 1023.0}, x) * kPosyMax, kPosyTolerance)
+                << "point " << i;
+        EXPECT_NEAR(posy[i], posx[i] * 2048.0, kPosyTolerance) << "point " << i;
+    }
+
+    // the scene at a tenth of the input, to a display at half of the output: the
+    // points up to the scene maximum at 6553.5, then flat at half of the posy range
+    metadata.display_maximum_luminance = 500;
+    metadata.maxscl = {10000, 10000, 10000};
+    ASSERT_TRUE(hdr10plus::GenerateDtm(metadata, kInputMaxLuminance, 1000.0f, config));
+    EXPECT_EQ(posx[31], 6554);
+    EXPECT_EQ(posx[32], 65535);
+    EXPECT_NEAR(posy[31], kPosyMax / 2, kPosyTolerance);
+    EXPECT_NEAR(posy[32], kPosyMax / 2, kPosyTolerance);
+}
+
+#ifdef __ANDROID__
+// @posy of @config at @posx, interpolated between the points
+double posyAt(const DtmConfig &config, double posx) {
+    const auto &x = config.tf_data.posx;
+    const auto &y = config.tf_data.posy;
+    size_t k = 0;
+    while ((k + 2 < x.size()) && (x[k + 1] <= posx))
+        k++;
+    if (x[k + 1] <= x[k])
+        return y[k];
+    double t = std::clamp((posx - x[k]) / (x[k + 1] - x[k]), 0.0, 1.0);
+    return y[k] + t * (static_cast<double>(y[k + 1]) - y[k]);
+}
+
+IDisplayColorGS101 *loadDisplayColor() {
+    const char *name = std::getenv("DISPLAY_COLOR_LIB");
+    void *handle = dlopen(name ? name : "libdisplaycolor.so", RTLD_LAZY);
+    if (!handle)
+        return nullptr;
+    auto get = reinterpret_cast<IDisplayColorGS101 *(*)(size_t)>(
+            dlsym(handle, "GetDisplayColorGS101"));
+    return get ? get(1) : nullptr;
+}
+
+TEST(Hdr10PlusDtmTest, MatchesDisplayColor) {
+    IDisplayColorGS101 *displayColor = loadDisplayColor();
+    if (!displayColor)
+        GTEST_SKIP() << "no displaycolor to compare with";
+
+    for (const auto &metadata : metadataSets()) {
+        DisplayScene scene;
+        LayerColorData layer;
+        layer.dataspace = hwc::Dataspace::BT2020_PQ;
+        layer.dynamic_metadata = metadata;
+        scene.layer_data.push_back(layer);
+        scene.color_mode = hwc::ColorMode::BT2100_PQ;
+        scene.render_intent = hwc::RenderIntent::TONE_MAP_ENHANCE;
+        for (size_t i = 0; i < scene.matrix.size(); i++)
+            scene.matrix[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+        // the panel at its peak, brighter than the targeted displays: posy is not clamped
+        scene.dbv = 4095;
+        ASSERT_EQ(displayColor->Update(DisplayType::DISPLAY_PRIMARY, scene), 0);
+
+        auto dpps = displayColor->GetPipelineData(DisplayType::DISPLAY_PRIMARY)->Dpp();
+        ASSERT_EQ(dpps.size(), 1u);
+        const auto &dtm = dpps[0].get().Dtm();
+        ASSERT_TRUE(dtm.enable);
+        ASSERT_NE(dtm.config, nullptr);
+        const DtmConfig &actual = *dtm.config;
+
+        // the output luminance only scales posy: both curves are normalized to their end
+        DtmConfig expected{};
+        ASSERT_TRUE(hdr10plus::GenerateDtm(metadata, kInputMaxLuminance,
+                                           metadata.display_maximum_luminance, expected));
+        EXPECT_EQ(actual.coeff_r, expected.coeff_r);
+        EXPECT_EQ(actual.coeff_g, expected.coeff_g);
+        EXPECT_EQ(actual.coeff_b, expected.coeff_b);
+        EXPECT_EQ(actual.rng_x_min, expected.rng_x_min);
+        EXPECT_EQ(actual.rng_x_max, expected.rng_x_max);
+        EXPECT_EQ(actual.rng_y_min, expected.rng_y_min);
+        EXPECT_EQ(actual.rng_y_max, expected.rng_y_max);
+
+        double actualEnd = actual.tf_data.posy.back();
+        double expectedEnd = expected.tf_data.posy.back();
+        ASSERT_GT(actualEnd, 0);
+        for (size_t i = 0; i < actual.tf_data.posx.size(); i++) {
+            double posx = actual.tf_data.posx[i];
+            EXPECT_NEAR(actual.tf_data.posy[i] / actualEnd, posyAt(expected, posx) / expectedEnd,
+                        kCurveTolerance)
+                    << "point " << i << " at " << posx << ", knee " << metadata.tm_knee_x;
+        }
+    }
+}
+#endif  // __ANDROID__
+
+}  // namespace
+}  // namespace displaycolor
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <gs101/displaycolor/reference_pipeline_gs101.h>
+
+#include "reference_pipeline_test.h"
+
+/*
+ * Throughput of DppPipeline and DqePipeline::Process() over a 1080x2400
+ * frame, one plane per channel. items_per_second is pixels per second.
+ */
+
+namespace displaycolor {
+namespace {
+
+constexpr size_t kPixels = 1080 * 2400;
+
+struct Frame {
+    std::vector<uint16_t> r, g, b;
+
+    explicit Frame(uint32_t code_max) : r(kPixels), g(kPixels), b(kPixels) {
+        for (size_t i = 0; i < kPixels; i++) {
+            r[i] = static_cast<uint16_t>(i % (code_max + 1));
+            g[i] = static_cast<uint16_t>(i * 7 % (code_max + 1));
+            b[i] = static_cast<uint16_t>(i * 13 % (code_max + 1));
+        }
+    }
+};
+
+// @stages: bits of EOTF, GM, DTM and OETF
+void BM_Dpp(benchmark::State &state) {
+    const auto stages = state.range(0);
+    test::TestDpp dpp(0);
+    dpp.eotf.enable = stages & 1;
+    dpp.gm.enable = stages & 2;
+    dpp.dtm.enable = stages & 4;
+    dpp.oetf.enable = stages & 8;
+    reference::DppPipeline pipeline(dpp);
+
+    Frame frame(1023);
+    for (auto _ : state) {
+        pipeline.Process(frame.r.data(), frame.g.data(), frame.b.data(), kPixels);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kPixels);
+}
+BENCHMARK(BM_Dpp)->Arg(0)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(15);
+
+// every stage but CGC, at the bit depth of the DPU
+void BM_Dqe(benchmark::State &state) {
+    const int code_bits = static_cast<int>(state.range(0));
+    test::TestDqe dqe(code_bits, 0);
+    reference::DqePipeline pipeline(dqe, code_bits == 8 ? BitDepth::kEight : BitDepth::kTen);
+
+    Frame frame((1u << code_bits) - 1);
+    for (auto _ : state) {
+        pipeline.Process(frame.r.data(), frame.g.data(), frame.b.data(), kPixels);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kPixels);
+}
+BENCHMARK(BM_Dqe)->Arg(8)->Arg(10);
+
+}  // namespace
+}  // namespace displaycolor
+
+BENCHMARK_MAIN();
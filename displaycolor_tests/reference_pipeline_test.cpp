@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <gs101/displaycolor/reference_pipeline_gs101.h>
+
+#include "reference_pipeline_test.h"
+
+/*
+ * DppPipeline and DqePipeline against a conversion of one pixel at a time,
+ * in 64-bit arithmetic straight from the formats of reference_pipeline_gs101.h.
+ */
+namespace displaycolor {
+namespace {
+
+using reference::DppPipeline;
+using reference::DqePipeline;
+using test::TestDpp;
+using test::TestDqe;
+
+// @tf at @x, interpolated between the points and clamped to [0, @y_max]
+template <typename TfData>
+int64_t interpolate(const TfData &tf, int64_t x, int64_t y_max) {
+    size_t k = 0;
+    while (k + 1 < tf.posx.size() && tf.posx[k + 1] <= x)
+        k++;
+    int64_t y = tf.posy[k];
+    if (k + 1 < tf.posx.size() && x > tf.posx[k])
+        y += (static_cast<int64_t>(tf.posy[k + 1]) - tf.posy[k]) * (x - tf.posx[k]) /
+                (static_cast<int64_t>(tf.posx[k + 1]) - tf.posx[k]);
+    return std::clamp<int64_t>(y, 0, y_max);
+}
+
+// @values evenly spaced over the @bits-bit inputs, at @x
+template <typename Values>
+int64_t interpolate(const Values &values, int bits, int64_t x, int64_t y_max) {
+    const int64_t last = values.size() - 1;
+    const int64_t range = int64_t{1} << bits;
+    const int64_t k = x * last / range;
+    int64_t y = values[k];
+    if (k < last)
+        y += (static_cast<int64_t>(values[k + 1]) - values[k]) * (x * last % range) / range;
+    return std::clamp<int64_t>(y, 0, y_max);
+}
+
+void multiply(const std::array<int64_t, 9> &coeffs, const std::array<int64_t, 3> &offsets,
+              int fraction_bits, int64_t max, int64_t (&rgb)[3]) {
+    int64_t out[3];
+    for (int row = 0; row < 3; row++) {
+        int64_t sum = 0;
+        for (int ch = 0; ch < 3; ch++)
+            sum += coeffs[row * 3 + ch] * rgb[ch];
+        out[row] = std::clamp<int64_t>((sum >> fraction_bits) + offsets[row], 0, max);
+    }
+    std::copy(out, out + 3, rgb);
+}
+
+int64_t signExtend(uint32_t value, int bits) {
+    return static_cast<int32_t>(value << (32 - bits)) >> (32 - bits);
+}
+
+void convertPixel(const TestDpp &dpp, int64_t (&rgb)[3]) {
+    for (auto &v : rgb)
+        v = dpp.eotf.enable ? interpolate(dpp.eotf.config->tf_data, v, 65535) : v << 6;
+
+    if (dpp.gm.enable) {
+        const auto &matrix = dpp.gm.config->matrix_data;
+        std::array<int64_t, 9> coeffs;
+        std::array<int64_t, 3> offsets;
+        for (size_t i = 0; i < 9; i++)
+            coeffs[i] = signExtend(matrix.coeffs[i], 19);
+        for (size_t i = 0; i < 3; i++)
+            offsets[i] = signExtend(matrix.offsets[i], 17);
+        multiply(coeffs, offsets, 16, 65535, rgb);
+    }
+
+    if (dpp.dtm.enable) {
+        const auto &dtm = *dpp.dtm.config;
+        int64_t y = (dtm.coeff_r * rgb[0] + dtm.coeff_g * rgb[1] + dtm.coeff_b * rgb[2]) >> 10;
+        y = std::min<int64_t>(y, 65535);
+        int64_t gain = 0;
+        if (y > 0)
+            gain = std::min<int64_t>((interpolate(dtm.tf_data, y, UINT32_MAX) << 5) / y,
+                                     UINT32_MAX);
+        for (auto &v : rgb)
+            v = std::min<int64_t>((v * gain) >> 16, 65535);
+    }
+
+    for (auto &v : rgb)
+        v = dpp.oetf.enable ? interpolate(dpp.oetf.config->tf_data, v, 1023) : v >> 6;
+}
+
+void convertPixel(const TestDqe &dqe, int code_bits, int64_t (&rgb)[3]) {
+    const int linear_bits = code_bits + 3;
+    const int64_t code_max = (1 << code_bits) - 1;
+    const int64_t linear_max = (1 << linear_bits) - 1;
+
+    auto load = [](const TestDqe::DqeMatrixData &stage, std::array<int64_t, 9> &coeffs,
+                   std::array<int64_t, 3> &offsets) {
+        for (size_t i = 0; i < 9; i++)
+            coeffs[i] = static_cast<int16_t>(stage.config->matrix_data.coeffs[i]);
+        for (size_t i = 0; i < 3; i++)
+            offsets[i] = static_cast<int16_t>(stage.config->matrix_data.offsets[i]);
+    };
+    std::array<int64_t, 9> coeffs;
+    std::array<int64_t, 3> offsets;
+
+    if (dqe.gamma.enable) {
+        load(dqe.gamma, coeffs, offsets);
+        multiply(coeffs, offsets, 10, code_max, rgb);
+    }
+    for (auto &v : rgb) {
+        v = dqe.degamma.enable ? interpolate(dqe.degamma.config->values, code_bits, v, linear_max)
+                               : v << (linear_bits - code_bits);
+    }
+    if (dqe.linear.enable) {
+        load(dqe.linear, coeffs, offsets);
+        multiply(coeffs, offsets, 10, linear_max, rgb);
+    }
+    const auto &regamma = *dqe.regamma.config;
+    const decltype(regamma.r_values) *values[3] = {&regamma.r_values, &regamma.g_values,
+                                                   &regamma.b_values};
+    for (int ch = 0; ch < 3; ch++) {
+        if (dqe.regamma.enable) {
+            int64_t v = interpolate(*values[ch], linear_bits, rgb[ch], (code_max + 1) << 2);
+            rgb[ch] = std::min((v + 2) >> 2, code_max);
+        } else {
+            rgb[ch] >>= linear_bits - code_bits;
+        }
+    }
+}
+
+// Every code of a channel, over a few blocks and a partial one
+struct Planes {
+    std::vector<uint16_t> r, g, b;
+
+    Planes(int code_bits, uint32_t seed) {
+        const uint32_t codes = 1u << code_bits;
+        std::mt19937 rng(seed);
+        for (uint32_t i = 0; i < codes * 3 + 77; i++) {
+            r.push_back(i % codes);
+            g.push_back(rng() % codes);
+            b.push_back(rng() % codes);
+        }
+    }
+};
+
+TEST(ReferencePipelineTest, DppMatchesPixelConversion) {
+    for (uint32_t seed = 0; seed < 8; seed++) {
+        TestDpp dpp(seed);
+        // every combination of stages
+        dpp.eotf.enable = seed & 1;
+        dpp.gm.enable = seed & 2;
+        dpp.dtm.enable = seed & 4;
+        dpp.oetf.enable = true;
+        DppPipeline pipeline(dpp);
+
+        Planes planes(10, seed);
+        Planes expected = planes;
+        pipeline.Process(planes.r.data(), planes.g.data(), planes.b.data(), planes.r.size());
+        for (size_t i = 0; i < planes.r.size(); i++) {
+            int64_t rgb[3] = {expected.r[i], expected.g[i], expected.b[i]};
+            convertPixel(dpp, rgb);
+            ASSERT_EQ(planes.r[i], rgb[0]) << "seed " << seed << " pixel " << i;
+            ASSERT_EQ(planes.g[i], rgb[1]) << "seed " << seed << " pixel " << i;
+            ASSERT_EQ(planes.b[i], rgb[2]) << "seed " << seed << " pixel " << i;
+        }
+    }
+}
+
+// The coefficients at the end of their ranges, where 32-bit products would overflow
+TEST(ReferencePipelineTest, DppMatchesPixelConversionAtCoefficientLimits) {
+    TestDpp dpp(1);
+    for (size_t i = 0; i < 9; i++)
+        dpp.gmConfig.matrix_data.coeffs[i] = (i % 2) ? 0x3FFFF : 0x40000;
+    dpp.gmConfig.matrix_data.offsets = {0xFFFF, 0x10000, 0x1FFFF};
+    dpp.dtmConfig.coeff_r = dpp.dtmConfig.coeff_g = dpp.dtmConfig.coeff_b = UINT16_MAX;
+    for (auto &y : dpp.dtmConfig.tf_data.posy)
+        y = UINT32_MAX;
+
+    for (uint32_t gm = 0; gm < 2; gm++) {
+        dpp.gm.enable = gm;
+        DppPipeline pipeline(dpp);
+        Planes planes(10, gm);
+        Planes expected = planes;
+        pipeline.Process(planes.r.data(), planes.g.data(), planes.b.data(), planes.r.size());
+        for (size_t i = 0; i < planes.r.size(); i++) {
+            int64_t rgb[3] = {expected.r[i], expected.g[i], expected.b[i]};
+            convertPixel(dpp, rgb);
+            ASSERT_EQ(planes.r[i], rgb[0]) << "gm " << gm << " pixel " << i;
+            ASSERT_EQ(planes.g[i], rgb[1]) << "gm " << gm << " pixel " << i;
+            ASSERT_EQ(planes.b[i], rgb[2]) << "gm " << gm << " pixel " << i;
+        }
+    }
+}
+
+TEST(ReferencePipelineTest, DppWithoutStagesKeepsTheCodes) {
+    TestDpp dpp(0);
+    dpp.eotf.enable = dpp.gm.enable = dpp.dtm.enable = dpp.oetf.enable = false;
+    DppPipeline pipeline(dpp);
+
+    Planes planes(10, 0);
+    Planes expected = planes;
+    pipeline.Process(planes.r.data(), planes.g.data(), planes.b.data(), planes.r.size());
+    EXPECT_EQ(planes.r, expected.r);
+    EXPECT_EQ(planes.g, expected.g);
+    EXPECT_EQ(planes.b, expected.b);
+}
+
+TEST(ReferencePipelineTest, DqeMatchesPixelConversion) {
+    for (BitDepth depth : {BitDepth::kEight, BitDepth::kTen}) {
+        const int code_bits = (depth == BitDepth::kEight) ? 8 : 10;
+        for (uint32_t seed = 0; seed < 16; seed++) {
+            TestDqe dqe(code_bits, seed);
+            dqe.gamma.enable = seed & 1;
+            dqe.degamma.enable = seed & 2;
+            dqe.linear.enable = seed & 4;
+            dqe.regamma.enable = seed & 8;
+            DqePipeline pipeline(dqe, depth);
+            ASSERT_TRUE(pipeline.Supported());
+
+            Planes planes(code_bits, seed);
+            Planes expected = planes;
+            ASSERT_TRUE(pipeline.Process(planes.r.data(), planes.g.data(), planes.b.data(),
+                                         planes.r.size()));
+            for (size_t i = 0; i < planes.r.size(); i++) {
+                int64_t rgb[3] = {expected.r[i], expected.g[i], expected.b[i]};
+                convertPixel(dqe, code_bits, rgb);
+                ASSERT_EQ(planes.r[i], rgb[0]) << code_bits << " bpc seed " << seed << " pixel " << i;
+                ASSERT_EQ(planes.g[i], rgb[1]) << code_bits << " bpc seed " << seed << " pixel " << i;
+                ASSERT_EQ(planes.b[i], rgb[2]) << code_bits << " bpc seed " << seed << " pixel " << i;
+            }
+        }
+    }
+}
+
+TEST(ReferencePipelineTest, DqeWithCgcIsNotSupported) {
+    TestDqe dqe(10, 0);
+    dqe.cgc.enable = true;
+    DqePipeline pipeline(dqe, BitDepth::kTen);
+    EXPECT_FALSE(pipeline.Supported());
+
+    Planes planes(10, 0);
+    Planes expected = planes;
+    EXPECT_FALSE(pipeline.Process(planes.r.data(), planes.g.data(), planes.b.data(),
+                                  planes.r.size()));
+    EXPECT_EQ(planes.r, expected.r);
+    EXPECT_EQ(planes.g, expected.g);
+    EXPECT_EQ(planes.b, expected.b);
+}
+
+}  // namespace
+}  // namespace displaycolor
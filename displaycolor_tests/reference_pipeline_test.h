@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef REFERENCE_PIPELINE_TEST_H_
+#define REFERENCE_PIPELINE_TEST_H_
+
+#include <cstdint>
+#include <random>
+
+#include <gs101/displaycolor/displaycolor_gs101.h>
+
+namespace displaycolor {
+namespace test {
+
+// increasing points from about 0 to @x_max, of values up to past @y_max
+template <typename Rng, typename Tf>
+void fillTf(Rng &rng, Tf &tf, uint32_t x_max, uint32_t y_max) {
+    const uint32_t step = x_max / tf.posx.size();
+    uint32_t x = rng() % step;
+    for (size_t i = 0; i < tf.posx.size(); i++, x += 1 + rng() % step) {
+        tf.posx[i] = x;
+        tf.posy[i] = static_cast<uint32_t>(rng() % (y_max + y_max / 16));
+    }
+}
+
+/*
+ * IDpp and IDqe of random register data for reference_pipeline_gs101.h,
+ * the same for the same @seed. The points of the LUTs are increasing and
+ * end short of the input range, and their values go past the output range,
+ * so the conversions are clamped on both sides. All of the stages but CGC
+ * are enabled; the tests turn them off through the public members.
+ */
+struct TestDpp : IDisplayColorGS101::IDpp {
+    EotfData::ConfigType eotfConfig{};
+    GmData::ConfigType gmConfig{};
+    DtmData::ConfigType dtmConfig{};
+    OetfData::ConfigType oetfConfig{};
+    EotfData eotf;
+    GmData gm;
+    DtmData dtm;
+    OetfData oetf;
+
+    explicit TestDpp(uint32_t seed) {
+        std::mt19937 rng(seed);
+        fillTf(rng, eotfConfig.tf_data, 1023, 65535);
+        // around the identity in 16 fractional bits
+        for (size_t i = 0; i < gmConfig.matrix_data.coeffs.size(); i++) {
+            int32_t coeff = static_cast<int32_t>(rng() % 0x8000) - 0x4000 + ((i % 4) ? 0 : 0x10000);
+            gmConfig.matrix_data.coeffs[i] = static_cast<uint32_t>(coeff) & 0x7FFFF;
+        }
+        for (auto &offset : gmConfig.matrix_data.offsets)
+            offset = (static_cast<int32_t>(rng() % 0x800) - 0x400) & 0x1FFFF;
+        fillTf(rng, dtmConfig.tf_data, 65535, 65535u << 11);
+        dtmConfig.coeff_r = rng() % 512;
+        dtmConfig.coeff_g = rng() % 1024;
+        dtmConfig.coeff_b = rng() % 256;
+        fillTf(rng, oetfConfig.tf_data, 65535, 1023);
+
+        for (auto *stage : {&eotf.enable, &gm.enable, &dtm.enable, &oetf.enable})
+            *stage = true;
+        eotf.config = &eotfConfig;
+        gm.config = &gmConfig;
+        dtm.config = &dtmConfig;
+        oetf.config = &oetfConfig;
+    }
+    // the stages point to the configs of this object
+    TestDpp(const TestDpp &) = delete;
+    TestDpp &operator=(const TestDpp &) = delete;
+
+    const EotfData &EotfLut() const override { return eotf; }
+    const GmData &Gm() const override { return gm; }
+    const DtmData &Dtm() const override { return dtm; }
+    const OetfData &OetfLut() const override { return oetf; }
+};
+
+struct TestDqe : IDisplayColorGS101::IDqe {
+    DqeControlData::ConfigType controlConfig{};
+    DqeMatrixData::ConfigType gammaConfig{};
+    DegammaLutData::ConfigType degammaConfig{};
+    DqeMatrixData::ConfigType linearConfig{};
+    CgcData::ConfigType cgcConfig{};
+    RegammaLutData::ConfigType regammaConfig{};
+    DqeControlData control;
+    DqeMatrixData gamma;
+    DegammaLutData degamma;
+    DqeMatrixData linear;
+    CgcData cgc;
+    RegammaLutData regamma;
+
+    // @code_bits: 8 or 10, the bit depth of the codes of the data
+    TestDqe(int code_bits, uint32_t seed) {
+        std::mt19937 rng(seed);
+        const uint32_t code_max = (1u << code_bits) - 1;
+        const uint32_t linear_max = (1u << (code_bits + 3)) - 1;
+        // around the identity in 10 fractional bits, offsets a few codes
+        auto fillMatrix = [&rng](DqeMatrixData::ConfigType &config, uint32_t offset_range) {
+            for (size_t i = 0; i < config.matrix_data.coeffs.size(); i++)
+                config.matrix_data.coeffs[i] =
+                        static_cast<uint16_t>(rng() % 512 - 256 + ((i % 4) ? 0 : 1024));
+            for (auto &offset : config.matrix_data.offsets)
+                offset = static_cast<uint16_t>(rng() % (2 * offset_range) - offset_range);
+        };
+        fillMatrix(gammaConfig, 8);
+        for (auto &value : degammaConfig.values)
+            value = static_cast<uint16_t>(rng() % (linear_max + linear_max / 16));
+        fillMatrix(linearConfig, 64);
+        for (auto *values :
+             {&regammaConfig.r_values, &regammaConfig.g_values, &regammaConfig.b_values}) {
+            for (auto &value : *values)
+                value = static_cast<uint16_t>(rng() % (((code_max + 1) << 2) + 64));
+        }
+
+        for (auto *stage : {&control.enable, &gamma.enable, &degamma.enable, &linear.enable,
+                            &regamma.enable})
+            *stage = true;
+        control.config = &controlConfig;
+        gamma.config = &gammaConfig;
+        degamma.config = &degammaConfig;
+        linear.config = &linearConfig;
+        cgc.config = &cgcConfig;
+        regamma.config = &regammaConfig;
+    }
+    TestDqe(const TestDqe &) = delete;
+    TestDqe &operator=(const TestDqe &) = delete;
+
+    const DqeControlData &DqeControl() const override { return control; }
+    const DqeMatrixData &GammaMatrix() const override { return gamma; }
+    const DegammaLutData &DegammaLut() const override { return degamma; }
+    const DqeMatrixData &LinearMatrix() const override { return linear; }
+    const CgcData &Cgc() const override { return cgc; }
+    const RegammaLutData &RegammaLut() const override { return regamma; }
+};
+
+}  // namespace test
+}  // namespace displaycolor
+
+#endif  // REFERENCE_PIPELINE_TEST_H_
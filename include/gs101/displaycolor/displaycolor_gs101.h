@@ -202,6 +202,12 @@ class IDisplayColorGS101 : public IDisplayColorGeneric {
             std::array<Container, kLutLen> values;
         };
 
+        /**
+         * @brief CGC LUT in the layout of struct cgc_lut of the Samsung DRM
+         * uapi: three channels of kChannelLutLen 32-bit entries, back to back.
+         * Users may pass the config to the kernel as is, so the layout must
+         * not change without changing the uapi.
+         */
         struct CgcConfigType {
             using Container = uint32_t;
             static constexpr size_t kChannelLutLen = 2457;
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HDR10PLUS_DTM_GS101_H_
+#define HDR10PLUS_DTM_GS101_H_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+#include <gs101/displaycolor/displaycolor_gs101.h>
+
+namespace displaycolor {
+namespace hdr10plus {
+
+using HdrDynamicMetadata = decltype(LayerColorData::dynamic_metadata);
+using DtmConfig = IDisplayColorGS101::IDpp::DtmData::ConfigType;
+
+/// Largest number of Bezier curve anchors in SMPTE ST 2094-40
+static constexpr size_t kMaxBezierAnchors = 15;
+
+/**
+ * @brief Generate the DTM register data for the HDR10+ tone mapping curve.
+ *
+ * The curve of SMPTE ST 2094-40 is linear from 0 to the knee point
+ * (tm_knee_x, tm_knee_y) and a Bezier curve of bezier_curve_anchors from
+ * the knee point to (1, 1). Its input is normalized to the largest maxscl
+ * of the scene, and its output to display_maximum_luminance, the luminance
+ * of the targeted system display.
+ *
+ * The register data is laid out as follows:
+ * - posx: 16-bit linear input where 65535 is input_max_luminance. The
+ *   points are packed quadratically below the scene maximum and the last
+ *   point is 65535.
+ * - posy: 27-bit output in 16.11 fixed point of the same scale,
+ *   where 65535 << 11 is output_max_luminance.
+ * - coeff_r/g/b: the BT.2020 luma weights in 10-bit, where 1024 is 1.0.
+ * - rng_x: TM_RNGX, two 16-bit fields (min:max) in the scale of posx.
+ * - rng_y: TM_RNGY, two 9-bit fields (min:max) in the scale of posy
+ *   reduced to its 9 MSBs, i.e. posy >> 18.
+ * Both ranges are the full range of the curve, from the posx and posy of
+ * 0 to their largest values, so the tone mapping is never clamped.
+ *
+ * The curve is evaluated for all points at once in structure-of-arrays
+ * form, so the compiler can vectorize the loops.
+ *
+ * @param metadata HDR10+ dynamic metadata of the layer.
+ * @param input_max_luminance luminance of the DTM input 65535 in cd/m2.
+ * @param output_max_luminance luminance of the DTM output 65535 in cd/m2.
+ * @param config DTM register data to fill.
+ * @return false if @metadata has no tone mapping curve, and @config is not
+ *         changed.
+ */
+inline bool GenerateDtm(const HdrDynamicMetadata &metadata, float input_max_luminance,
+                        float output_max_luminance, DtmConfig &config) {
+    static constexpr size_t kLutLen = DtmConfig::kLutLen;
+    static constexpr float kPosMax = 65535.0f;
+    static constexpr float kPosYScale = 1 << 11;
+    static constexpr uint32_t kPosYMax = (1u << 27) - 1;
+    static constexpr uint32_t kRngYShift = 27 - 9; // TM_RNGY holds the 9 MSBs of posy
+    static constexpr float kKneeMax = 4095.0f;   // 12-bit knee point
+    static constexpr float kAnchorMax = 1023.0f; // 10-bit anchors
+
+    if (!metadata.is_valid || !metadata.tm_flag || metadata.display_maximum_luminance == 0 ||
+        metadata.bezier_curve_anchors.size() > kMaxBezierAnchors || input_max_luminance <= 0 ||
+        output_max_luminance <= 0)
+        return false;
+
+    // maxscl is in 0.1 cd/m2
+    uint32_t maxscl = *std::max_element(metadata.maxscl.begin(), metadata.maxscl.end());
+    float scene_max = maxscl ? maxscl / 10.0f : input_max_luminance;
+    float target_max = metadata.display_maximum_luminance;
+    float knee_x = std::min(metadata.tm_knee_x / kKneeMax, 1.0f);
+    float knee_y = std::min(metadata.tm_knee_y / kKneeMax, 1.0f);
+
+    std::array<float, kLutLen> x, t, y;
+    std::array<uint16_t, kLutLen> posx;
+
+    // the last point covers the input above the scene maximum, if any
+    float scene_pos = std::min(scene_max / input_max_luminance, 1.0f) * kPosMax;
+    size_t last = (scene_pos < kPosMax) ? kLutLen - 2 : kLutLen - 1;
+    posx[kLutLen - 1] = static_cast<uint16_t>(kPosMax);
+    for (size_t i = 0; i <= last; i++) {
+        float s = static_cast<float>(i) / last;
+        posx[i] = static_cast<uint16_t>(std::lround(scene_pos * s * s));
+    }
+    for (size_t i = 1; i < kLutLen; i++)
+        posx[i] = std::max(posx[i], static_cast<uint16_t>(std::min(posx[i - 1] + 1, 65535)));
+
+    float x_scale = input_max_luminance / kPosMax / scene_max;
+    for (size_t i = 0; i < kLutLen; i++) {
+        x[i] = std::min(posx[i] * x_scale, 1.0f);
+        t[i] = (knee_x < 1.0f) ? std::max((x[i] - knee_x) / (1.0f - knee_x), 0.0f) : 0.0f;
+    }
+
+    // de Casteljau over the control points 0, anchors..., 1
+    const size_t order = metadata.bezier_curve_anchors.size() + 1;
+    std::array<std::array<float, kLutLen>, kMaxBezierAnchors + 2> b;
+    for (size_t j = 0; j <= order; j++) {
+        float p = (j == 0) ? 0.0f
+                : (j == order) ? 1.0f
+                : std::min(metadata.bezier_curve_anchors[j - 1] / kAnchorMax, 1.0f);
+        b[j].fill(p);
+    }
+    for (size_t r = 1; r <= order; r++)
+        for (size_t j = 0; j <= order - r; j++)
+            for (size_t i = 0; i < kLutLen; i++)
+                b[j][i] += t[i] * (b[j + 1][i] - b[j][i]);
+
+    float knee_slope = (knee_x > 0.0f) ? knee_y / knee_x : 0.0f;
+    for (size_t i = 0; i < kLutLen; i++)
+        y[i] = (x[i] <= knee_x) ? x[i] * knee_slope : knee_y + (1.0f - knee_y) * b[0][i];
+
+    float y_scale = target_max / output_max_luminance * kPosMax * kPosYScale;
+    for (size_t i = 0; i < kLutLen; i++) {
+        config.tf_data.posx[i] = posx[i];
+        config.tf_data.posy[i] =
+                std::min(static_cast<uint32_t>(std::lround(y[i] * y_scale)), kPosYMax);
+    }
+
+    config.coeff_r = 269;
+    config.coeff_g = 694;
+    config.coeff_b = 61;
+    config.rng_x_min = 0;
+    config.rng_x_max = static_cast<uint16_t>(kPosMax);
+    config.rng_y_min = 0;
+    config.rng_y_max = static_cast<uint16_t>(kPosYMax >> kRngYShift);
+
+    return true;
+}
+
+}  // namespace hdr10plus
+}  // namespace displaycolor
+
+#endif  // HDR10PLUS_DTM_GS101_H_
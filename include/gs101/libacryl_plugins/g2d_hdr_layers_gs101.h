@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef G2D_HDR_LAYERS_GS101_H_
+#define G2D_HDR_LAYERS_GS101_H_
+
+/*
+ * HDR capable layers of the gs101 G2D. The SFR layout has one block of HDR
+ * SFRs per layer from 0x3000, 0x800 apart, and one LAYER_HDRMODE SFR per
+ * layer from 0x290, 0x100 apart. Past this count both run into other SFRs,
+ * so neither the HDR command writer nor a G2D job can use more HDR layers.
+ */
+#define G2D_HDR_MAX_LAYER_COUNT 4U
+
+#endif  // G2D_HDR_LAYERS_GS101_H_
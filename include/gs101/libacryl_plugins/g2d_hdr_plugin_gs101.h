@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef G2D_HDR_PLUGIN_GS101_H_
+#define G2D_HDR_PLUGIN_GS101_H_
+
+#include <string>
+
+#include <hardware/exynos/g2d_hdr_plugin.h>
+
+#include "g2d_hdr_layers_gs101.h"
+
+/**
+ * Formats of the command lists of getCommands(), as a mask of the formats a
+ * consumer of the command lists accepts.
+ *
+ * FLAT: one g2d_reg {offset, value} per SFR.
+ *
+ * BURST: the flat format, plus runs of consecutive SFRs encoded as a header
+ * g2d_reg {offset | G2D_HDR_BURST_FLAG, count} followed by the count values
+ * of the SFRs from offset, two per g2d_reg: the first of a pair in
+ * g2d_reg::offset, the second in g2d_reg::value, and 0 after an odd last
+ * value. command_count counts the g2d_reg of the headers and of the values.
+ */
+#define G2D_HDR_COMMAND_FORMAT_FLAT (1U << 0)
+#define G2D_HDR_COMMAND_FORMAT_BURST (1U << 1)
+#define G2D_HDR_BURST_FLAG (1U << 31)
+
+/**
+ * @brief GS101 extensions to the G2D HDR command writer.
+ *
+ * Every writer returned by IG2DHdr10CommandWriter::createInstance() of
+ * libacryl_hdr_plugin implements this interface.
+ */
+class IG2DHdr10CommandWriterGS101 : public IG2DHdr10CommandWriter {
+   public:
+    /**
+     * @brief Create a writer for a G2D with @layer_count HDR capable layers.
+     *
+     * The command lists for @layer_count layers are all allocated here, so
+     * getCommands() does not allocate memory. The layer indices given to the
+     * setLayer*() functions should be less than @layer_count.
+     * IG2DHdr10CommandWriter::createInstance() creates a writer for all
+     * G2D_HDR_MAX_LAYER_COUNT HDR layers of the gs101 G2D.
+     *
+     * @return NULL if @layer_count is 0 or more than G2D_HDR_MAX_LAYER_COUNT.
+     */
+    static IG2DHdr10CommandWriterGS101 *createInstance(unsigned int layer_count);
+
+    /**
+     * @brief Expand a command list in the burst format to the flat format.
+     *
+     * For the consumers that only accept the flat format. Writes one
+     * g2d_reg per SFR of the @count commands to @flat.
+     *
+     * @return the number of g2d_reg written to @flat, or -1 if they do not
+     * fit in @capacity or a burst runs past @count.
+     */
+    static int expandBurstCommands(const g2d_reg *commands, unsigned int count, g2d_reg *flat,
+                                   unsigned int capacity);
+
+    /**
+     * @brief Set the command formats the consumer of the command lists accepts.
+     *
+     * @formats is a mask of G2D_HDR_COMMAND_FORMAT_*, as the G2D driver
+     * reports it. getCommands() encodes the runs of SFRs in the burst format
+     * only if @formats has G2D_HDR_COMMAND_FORMAT_BURST, and in the flat
+     * format otherwise. The shadow register mode always emits the flat
+     * format. By default only the flat format is accepted.
+     *
+     * @return false, without a change, if @formats has no format the writer
+     * can encode.
+     */
+    virtual bool setCommandFormats(unsigned int formats) = 0;
+
+    /**
+     * @brief Enable or disable the shadow register mode.
+     *
+     * In shadow register mode getCommands() remembers the last value written
+     * to each HDR SFR of each layer and only emits the SFRs that changed,
+     * plus HDR_MOD_CTRL and HDR_COM_CTRL. This is only valid while the G2D
+     * HDR SFRs retain their values between jobs, so the caller must call
+     * invalidateShadowRegisters() whenever that is not guaranteed. The mode
+     * is disabled by default.
+     */
+    virtual void setShadowRegisterMode(bool enable) = 0;
+
+    /**
+     * @brief Forget the SFR values remembered by the shadow register mode.
+     *
+     * Call this when the G2D context is reset or when a job built by
+     * getCommands() was not executed, so that the next job programs all
+     * HDR SFRs again.
+     */
+    virtual void invalidateShadowRegisters() = 0;
+
+    /**
+     * @brief Append the statistics of the HDR command generation to @result.
+     *
+     * The statistics cover every job built by getCommands() of this writer:
+     * the number of jobs and commands, the number of layers with each HDR
+     * stage enabled, the stage segments found in the cache and the average
+     * time spent in getCommands(). The per-job values are also reported as
+     * atrace counters while graphics tracing is enabled.
+     */
+    virtual void dump(std::string &result) = 0;
+
+    virtual ~IG2DHdr10CommandWriterGS101() {}
+};
+
+#endif  // G2D_HDR_PLUGIN_GS101_H_
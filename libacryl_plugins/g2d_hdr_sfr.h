@@ -0,0 +1,88 @@
+/*
+ *  libacryl_plugins/g2d_hdr_sfr.h
+ *
+ *   Copyright 2020 Samsung Electronics Co., Ltd.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#ifndef LIBACRYL_G2D_HDR_SFR_H_
+#define LIBACRYL_G2D_HDR_SFR_H_
+
+#include <cstdint>
+
+#include <gs101/libacryl_plugins/g2d_hdr_layers_gs101.h>
+
+// Layout of the HDR SFRs of G2D
+#define HDR_BASE 0x3000
+#define HDR_SFR_LEN 0x800
+
+#define HDR_COM_CTRL 0x3004 // [0] HDR enable
+static const uint32_t VAL_HDR_CTRL_ENABLE = 1;
+
+#define HDR_MOD_CTRL_NUM  1   // [0] oetf enable, [1] eotf enable [2] gm enable [5] tm enable
+#define HDR_OETF_POSX_NUM 17  // two 16-bit from LSB
+#define HDR_OETF_POSY_NUM 17  // two 10-bit from LSB
+#define HDR_EOTF_POSX_NUM 65  // two 10-bit from LSB
+#define HDR_EOTF_POSY_NUM 129 // one 16-bit
+#define HDR_GM_COEF_NUM   9   // one 19-bit
+#define HDR_GM_OFF_NUM    3   // one 17-bit
+#define HDR_TM_COEF_NUM   1   // three 10-bit from LSB (R, G, B)
+#define HDR_TM_RNGX_NUM   1   // two 16-bit from LSB (min:max)
+#define HDR_TM_RNGY_NUM   1   // two 9-bit from LSB (min:max)
+#define HDR_TM_POSX_NUM   17  // two 16-bit from LSB
+#define HDR_TM_POSY_NUM   33  // one 27-bit from LSB
+
+#define HDR_MOD_CTRL_OFFSET  (0x8)
+static const uint32_t HDR_ENABLE_OETF = 1 << 0;
+static const uint32_t HDR_ENABLE_EOTF = 1 << 1;
+static const uint32_t HDR_ENABLE_GM   = 1 << 2;
+static const uint32_t HDR_ENABLE_DTM  = 1 << 5;
+
+#define HDR_OETF_POSX_OFFSET (HDR_MOD_CTRL_OFFSET  + 4 * HDR_MOD_CTRL_NUM )
+#define HDR_OETF_POSY_OFFSET (HDR_OETF_POSX_OFFSET + 4 * HDR_OETF_POSX_NUM)
+#define HDR_EOTF_POSX_OFFSET (HDR_OETF_POSY_OFFSET + 4 * HDR_OETF_POSY_NUM)
+#define HDR_EOTF_POSY_OFFSET (HDR_EOTF_POSX_OFFSET + 4 * HDR_EOTF_POSX_NUM)
+#define HDR_GM_COEF_OFFSET   (HDR_EOTF_POSY_OFFSET + 4 * HDR_EOTF_POSY_NUM)
+#define HDR_GM_OFF_OFFSET    (HDR_GM_COEF_OFFSET   + 4 * HDR_GM_COEF_NUM  )
+#define HDR_TM_COEF_OFFSET   (HDR_GM_OFF_OFFSET    + 4 * HDR_GM_OFF_NUM   )
+#define HDR_TM_RNGX_OFFSET   (HDR_TM_COEF_OFFSET   + 4 * HDR_TM_COEF_NUM  )
+#define HDR_TM_RNGY_OFFSET   (HDR_TM_RNGX_OFFSET   + 4 * HDR_TM_RNGX_NUM  )
+#define HDR_TM_POSX_OFFSET   (HDR_TM_RNGY_OFFSET   + 4 * HDR_TM_RNGY_NUM  )
+#define HDR_TM_POSY_OFFSET   (HDR_TM_POSX_OFFSET   + 4 * HDR_TM_POSX_NUM  )
+
+#define HDR_LAYER_BASE(layer) (HDR_BASE + HDR_SFR_LEN * (layer))
+
+#define HDR_MOD_CTRL(layer)  (HDR_LAYER_BASE(layer) + HDR_MOD_CTRL_OFFSET )
+#define HDR_OETF_POSX(layer) (HDR_LAYER_BASE(layer) + HDR_OETF_POSX_OFFSET)
+#define HDR_OETF_POSY(layer) (HDR_LAYER_BASE(layer) + HDR_OETF_POSY_OFFSET)
+#define HDR_EOTF_POSX(layer) (HDR_LAYER_BASE(layer) + HDR_EOTF_POSX_OFFSET)
+#define HDR_EOTF_POSY(layer) (HDR_LAYER_BASE(layer) + HDR_EOTF_POSY_OFFSET)
+#define HDR_GM_COEF(layer)   (HDR_LAYER_BASE(layer) + HDR_GM_COEF_OFFSET  )
+#define HDR_GM_OFF(layer)    (HDR_LAYER_BASE(layer) + HDR_GM_OFF_OFFSET   )
+#define HDR_TM_COEF(layer)   (HDR_LAYER_BASE(layer) + HDR_TM_COEF_OFFSET  )
+#define HDR_TM_RNGX(layer)   (HDR_LAYER_BASE(layer) + HDR_TM_RNGX_OFFSET  )
+#define HDR_TM_RNGY(layer)   (HDR_LAYER_BASE(layer) + HDR_TM_RNGY_OFFSET  )
+#define HDR_TM_POSX(layer)   (HDR_LAYER_BASE(layer) + HDR_TM_POSX_OFFSET  )
+#define HDR_TM_POSY(layer)   (HDR_LAYER_BASE(layer) + HDR_TM_POSY_OFFSET  )
+
+#define G2D_LAYER_HDRMODE(i) (0x290 + (i) * 0x100)
+
+#define DEFAULT_LAYER_COUNT G2D_HDR_MAX_LAYER_COUNT
+#define HDR_LAYER_SFR_COUNT (\
+      HDR_MOD_CTRL_NUM + HDR_OETF_POSX_NUM + HDR_OETF_POSY_NUM + \
+      HDR_EOTF_POSX_NUM + HDR_EOTF_POSY_NUM + HDR_GM_COEF_NUM + \
+      HDR_GM_OFF_NUM + HDR_TM_COEF_NUM + HDR_TM_RNGX_NUM + \
+      HDR_TM_RNGY_NUM + HDR_TM_POSX_NUM + HDR_TM_POSY_NUM\
+      )
+
+#endif // LIBACRYL_G2D_HDR_SFR_H_
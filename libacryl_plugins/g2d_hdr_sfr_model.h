@@ -0,0 +1,237 @@
+/*
+ *  libacryl_plugins/g2d_hdr_sfr_model.h
+ *
+ *   Copyright 2020 Samsung Electronics Co., Ltd.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#ifndef LIBACRYL_G2D_HDR_SFR_MODEL_H_
+#define LIBACRYL_G2D_HDR_SFR_MODEL_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <gs101/libacryl_plugins/g2d_hdr_plugin_gs101.h>
+
+#include "g2d_hdr_sfr.h"
+
+/*
+ * Software model of the HDR SFRs of G2D and of the conversion they program.
+ *
+ * apply() writes a g2d_commandlist in the flat or the burst format to the
+ * modeled SFRs, which keep their values across command lists like the
+ * hardware does. convert() runs a
+ * pixel of a G2D layer through EOTF, GM, DTM and OETF as enabled in
+ * HDR_MOD_CTRL of the HDR layer the layer is mapped to. Two sequences of
+ * command lists that leave the same SFR values convert the same pixels,
+ * whatever the encoding of the command lists.
+ *
+ * The conversion follows the register layout of the stage configs:
+ * - EOTF: 10-bit code to 16-bit linear.
+ * - GM: coefficients are 19-bit two's complement with 16 fractional bits,
+ *   assumed as by the generator: the SFR spec only gives their width.
+ * - DTM: scales RGB by the curve of the weighted luminance; the curve
+ *   output is 16.11 fixed point.
+ * - OETF: 16-bit linear to 10-bit code.
+ * All LUTs are interpolated linearly between the points. The model does
+ * not reproduce the exact rounding of the hardware.
+ */
+class G2DHdrSfrModel {
+public:
+    struct Pixel {
+        uint32_t r, g, b;
+
+        bool operator==(const Pixel &other) const {
+            return (r == other.r) && (g == other.g) && (b == other.b);
+        }
+    };
+
+    explicit G2DHdrSfrModel(std::size_t layer_count)
+          : mSfrs(layer_count), mLayerHdrModes(layer_count, 0), mLayerMapped(layer_count, false) { }
+
+    // returns false if a command of @cmdlist is outside the HDR SFRs of the model
+    bool apply(const g2d_commandlist &cmdlist) {
+        bool valid = true;
+
+        for (uint32_t i = 0; i < cmdlist.command_count; i++) {
+            const g2d_reg &reg = cmdlist.commands[i];
+            if (!(reg.offset & G2D_HDR_BURST_FLAG)) {
+                valid &= write(reg.offset, reg.value);
+                continue;
+            }
+
+            uint32_t value_regs = (reg.value + 1) / 2;
+            if (value_regs > cmdlist.command_count - i - 1)
+                return false;
+            const uint32_t *values = reinterpret_cast<const uint32_t *>(&cmdlist.commands[i + 1]);
+            for (uint32_t k = 0; k < reg.value; k++)
+                valid &= write((reg.offset & ~G2D_HDR_BURST_FLAG) + k * sizeof(uint32_t), values[k]);
+            i += value_regs;
+        }
+
+        for (uint32_t i = 0; i < cmdlist.layer_count; i++) {
+            const g2d_reg &reg = cmdlist.layer_hdr_mode[i];
+            const uint32_t stride = G2D_LAYER_HDRMODE(1) - G2D_LAYER_HDRMODE(0);
+            if ((reg.offset < G2D_LAYER_HDRMODE(0)) || ((reg.offset - G2D_LAYER_HDRMODE(0)) % stride))
+                valid = false;
+            else
+                valid &= setLayerHdrMode((reg.offset - G2D_LAYER_HDRMODE(0)) / stride, reg.value);
+        }
+
+        return valid;
+    }
+
+    bool setLayerHdrMode(std::size_t layer, uint32_t value) {
+        if (layer >= mLayerHdrModes.size())
+            return false;
+
+        mLayerHdrModes[layer] = value;
+        mLayerMapped[layer] = true;
+        return true;
+    }
+
+    bool hasLayer(std::size_t layer) const {
+        return (layer < mLayerMapped.size()) && mLayerMapped[layer];
+    }
+
+    bool write(uint32_t offset, uint32_t value) {
+        if (offset == HDR_COM_CTRL) {
+            mComCtrl = value;
+            return true;
+        }
+
+        std::size_t layer = (offset - HDR_BASE) / HDR_SFR_LEN;
+        if ((offset < HDR_MOD_CTRL(0)) || (layer >= mSfrs.size()) ||
+            (offset < HDR_MOD_CTRL(layer)) || (offset % sizeof(value)))
+            return false;
+
+        std::size_t index = (offset - HDR_MOD_CTRL(layer)) / sizeof(value);
+        if (index >= HDR_LAYER_SFR_COUNT)
+            return false;
+
+        mSfrs[layer][index] = value;
+        return true;
+    }
+
+    uint32_t read(uint32_t offset) const {
+        if (offset == HDR_COM_CTRL)
+            return mComCtrl;
+
+        std::size_t layer = (offset - HDR_BASE) / HDR_SFR_LEN;
+        return mSfrs[layer][(offset - HDR_MOD_CTRL(layer)) / sizeof(uint32_t)];
+    }
+
+    bool operator==(const G2DHdrSfrModel &other) const {
+        return (mComCtrl == other.mComCtrl) && (mSfrs == other.mSfrs) &&
+               (mLayerHdrModes == other.mLayerHdrModes) && (mLayerMapped == other.mLayerMapped);
+    }
+
+    // converts a 10-bit RGB pixel of G2D layer @layer
+    Pixel convert(std::size_t layer, Pixel in) const {
+        if (!(mComCtrl & VAL_HDR_CTRL_ENABLE) || (layer >= mLayerMapped.size()) ||
+            !mLayerMapped[layer])
+            return in;
+
+        std::size_t hdr_layer = mLayerHdrModes[layer] & ~G2D_LAYER_HDRMODE_DEMULT_ALPHA;
+        if (hdr_layer >= mSfrs.size())
+            return in;
+
+        uint32_t base = HDR_LAYER_BASE(hdr_layer);
+        uint32_t modectl = read(HDR_MOD_CTRL(hdr_layer));
+        int64_t rgb[3] = {in.r, in.g, in.b};
+
+        if (modectl & HDR_ENABLE_EOTF) {
+            for (auto &c : rgb)
+                c = lookup(base + HDR_EOTF_POSX_OFFSET, true, base + HDR_EOTF_POSY_OFFSET, false,
+                           HDR_EOTF_POSY_NUM, c);
+        } else {
+            for (auto &c : rgb)
+                c <<= 6;
+        }
+
+        if (modectl & HDR_ENABLE_GM) {
+            int64_t out[3];
+            for (int r = 0; r < 3; r++) {
+                out[r] = signExtend(read(base + HDR_GM_OFF_OFFSET + r * 4), 17);
+                for (int c = 0; c < 3; c++)
+                    out[r] += (signExtend(read(base + HDR_GM_COEF_OFFSET + (r * 3 + c) * 4), 19) *
+                               rgb[c]) >> 16;
+            }
+            for (int c = 0; c < 3; c++)
+                rgb[c] = std::clamp<int64_t>(out[c], 0, 65535);
+        }
+
+        if (modectl & HDR_ENABLE_DTM) {
+            uint32_t coef = read(base + HDR_TM_COEF_OFFSET);
+            int64_t y = ((coef & 0x3FF) * rgb[0] + ((coef >> 10) & 0x3FF) * rgb[1] +
+                         ((coef >> 20) & 0x3FF) * rgb[2]) >> 10;
+            int64_t mapped = lookup(base + HDR_TM_POSX_OFFSET, true, base + HDR_TM_POSY_OFFSET,
+                                    false, HDR_TM_POSY_NUM, std::min<int64_t>(y, 65535));
+            for (auto &c : rgb)
+                c = (y > 0) ? std::clamp<int64_t>(c * mapped / (y << 11), 0, 65535) : 0;
+        }
+
+        if (modectl & HDR_ENABLE_OETF) {
+            for (auto &c : rgb)
+                c = lookup(base + HDR_OETF_POSX_OFFSET, true, base + HDR_OETF_POSY_OFFSET, true,
+                           HDR_OETF_POSX_NUM * 2 - 1, c);
+        } else {
+            for (auto &c : rgb)
+                c >>= 6;
+        }
+
+        return {static_cast<uint32_t>(rgb[0]), static_cast<uint32_t>(rgb[1]),
+                static_cast<uint32_t>(rgb[2])};
+    }
+
+private:
+    static int64_t signExtend(uint32_t value, int bits) {
+        return static_cast<int32_t>(value << (32 - bits)) >> (32 - bits);
+    }
+
+    // @index-th entry of a table at @offset with two 16-bit entries per SFR if @paired
+    uint32_t entry(uint32_t offset, bool paired, std::size_t index) const {
+        if (!paired)
+            return read(offset + index * 4);
+        uint32_t value = read(offset + (index / 2) * 4);
+        return (index % 2) ? (value >> 16) : (value & 0xFFFF);
+    }
+
+    int64_t lookup(uint32_t xoffset, bool xpaired, uint32_t yoffset, bool ypaired,
+                   std::size_t count, int64_t x) const {
+        std::size_t k = 0;
+        while ((k + 1 < count) && (entry(xoffset, xpaired, k + 1) <= x))
+            k++;
+
+        int64_t y0 = entry(yoffset, ypaired, k);
+        if (k + 1 == count)
+            return y0;
+
+        int64_t x0 = entry(xoffset, xpaired, k);
+        int64_t x1 = entry(xoffset, xpaired, k + 1);
+        int64_t y1 = entry(yoffset, ypaired, k + 1);
+        if (x1 <= x0)
+            return y0;
+
+        return y0 + (y1 - y0) * (x - x0) / (x1 - x0);
+    }
+
+    uint32_t mComCtrl = 0;
+    std::vector<std::array<uint32_t, HDR_LAYER_SFR_COUNT>> mSfrs;
+    std::vector<uint32_t> mLayerHdrModes;
+    std::vector<bool> mLayerMapped;
+};
+
+#endif // LIBACRYL_G2D_HDR_SFR_MODEL_H_
@@ -0,0 +1,431 @@
+/*
+ *  libacryl_plugins/hdr_lut_generator.cpp
+ *
+ *   Copyright 2020 Samsung Electronics Co., Ltd.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <list>
+#include <mutex>
+
+#include <system/graphics.h>
+
+#include "hdr_lut_generator.h"
+
+/*
+ * The tables are computed in fixed point, Q28 in int64_t, so that they are
+ * the same bit for bit on every device and on the host. Luminance is
+ * normalized to the 10000 cd/m2 of PQ. Every operand of mul() and div()
+ * and every dividend stays below 128.
+ */
+using Fixed = int64_t;
+static const int FRACTION_BITS = 28;
+static const Fixed ONE = static_cast<Fixed>(1) << FRACTION_BITS;
+
+// the constants are converted at compile time
+static constexpr Fixed fixed(double value) {
+    return static_cast<Fixed>(value * (1 << FRACTION_BITS) + (value < 0 ? -0.5 : 0.5));
+}
+
+static constexpr Fixed nits(double luminance) { return fixed(luminance / 10000); }
+
+// a * b where |b| < 128
+static Fixed mul(Fixed a, Fixed b) {
+    Fixed hi = a >> FRACTION_BITS;
+    Fixed lo = a & (ONE - 1);
+    return hi * b + ((lo * b) >> FRACTION_BITS);
+}
+
+// a / b where |a| < 128
+static Fixed div(Fixed a, Fixed b) {
+    return a * ONE / b;
+}
+
+// @value >> @shift, rounded to the nearest
+static Fixed roundShift(Fixed value, int shift) {
+    return (value + (static_cast<Fixed>(1) << (shift - 1))) >> shift;
+}
+
+// floor(sqrt(@n))
+static uint64_t isqrt(uint64_t n) {
+    uint64_t root = 0;
+
+    for (uint64_t bit = static_cast<uint64_t>(1) << 62; bit; bit >>= 2) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+    return root;
+}
+
+static Fixed sqrtFixed(Fixed x) {
+    return static_cast<Fixed>(isqrt(static_cast<uint64_t>(x) << FRACTION_BITS));
+}
+
+/*
+ * log2() and exp2() work on mantissas of 1.0 to 2.0 with 30 fractional
+ * bits, as many as the product of two fits in 64 bits with, and round
+ * every product: they are exact to about one unit of Q28.
+ */
+static const int MANTISSA_BITS = 30;
+static const uint64_t MANTISSA_ONE = static_cast<uint64_t>(1) << MANTISSA_BITS;
+
+static uint64_t mulMantissa(uint64_t a, uint64_t b) {
+    return (a * b + (MANTISSA_ONE >> 1)) >> MANTISSA_BITS;
+}
+
+// log2(x) for x > 0, a bit of the fraction per squaring
+static Fixed log2Fixed(Fixed x) {
+    Fixed result = 0;
+    uint64_t m = static_cast<uint64_t>(x) << (MANTISSA_BITS - FRACTION_BITS);
+
+    for (; m >= 2 * MANTISSA_ONE; m >>= 1)
+        result += ONE;
+    for (; m < MANTISSA_ONE; m <<= 1)
+        result -= ONE;
+    for (Fixed bit = ONE >> 1; bit; bit >>= 1) {
+        m = mulMantissa(m, m);
+        if (m >= 2 * MANTISSA_ONE) {
+            m >>= 1;
+            result += bit;
+        }
+    }
+    return result;
+}
+
+// 2^y for y < 6, a factor of 2^(2^-i) per bit i of the fraction
+static Fixed exp2Fixed(Fixed y) {
+    static const auto factors = [] {
+        std::array<uint64_t, FRACTION_BITS + 1> f{};
+        f[0] = 2 * MANTISSA_ONE;
+        for (int i = 1; i <= FRACTION_BITS; i++) {
+            // rounded to the nearest
+            uint64_t n = f[i - 1] << MANTISSA_BITS;
+            uint64_t root = isqrt(n);
+            f[i] = root + (n - root * root > root);
+        }
+        return f;
+    }();
+
+    Fixed n = y >> FRACTION_BITS;
+    Fixed fraction = y - n * ONE;
+    uint64_t m = MANTISSA_ONE;
+    for (int i = 1; i <= FRACTION_BITS; i++)
+        if (fraction & (ONE >> i))
+            m = mulMantissa(m, factors[i]);
+
+    // from the mantissa to Q28, times 2^n
+    int shift = MANTISSA_BITS - FRACTION_BITS - static_cast<int>(std::clamp<Fixed>(n, -40, 6));
+    if (shift <= 0)
+        return static_cast<Fixed>(m << -shift);
+    return (shift < 62) ? roundShift(static_cast<Fixed>(m), shift) : 0;
+}
+
+static Fixed powFixed(Fixed x, Fixed exponent) {
+    return (x > 0) ? exp2Fixed(mul(log2Fixed(x), exponent)) : 0;
+}
+
+static const Fixed LOG2_E = fixed(1.4426950408889634);
+static const Fixed LN_2 = fixed(0.6931471805599453);
+
+static Fixed expFixed(Fixed x) { return exp2Fixed(mul(x, LOG2_E)); }
+static Fixed logFixed(Fixed x) { return mul(log2Fixed(x), LN_2); }
+
+// luminance assumed when the mastering display luminance is not given
+static const Fixed DEFAULT_MAX_LUMINANCE = nits(1000.0);
+// peak luminance and system gamma of the HLG reference display (BT.2100)
+static const Fixed HLG_PEAK_LUMINANCE = nits(1000.0);
+static const Fixed HLG_SYSTEM_GAMMA = fixed(1.2);
+static const Fixed HLG_INVERSE_SYSTEM_GAMMA = fixed(1 / 1.2);
+// luminance of the SDR reference white (BT.2408)
+static const Fixed SDR_WHITE_LUMINANCE = nits(203.0);
+
+// ranges of the LUT entries
+static const uint32_t EOTF_X_MAX = 1023;  // 10-bit code
+static const uint32_t EOTF_Y_MAX = 65535; // 16-bit linear
+static const uint32_t OETF_X_MAX = 65535; // 16-bit linear
+static const uint32_t OETF_Y_MAX = 1023;  // 10-bit code
+
+// GM coefficients are 19-bit two's complement. The SFR spec only gives the
+// width: the fractional bits are assumed, see G2D_HDR_GENERATE_STAGES.
+static const int GM_COEF_FRACTION_BITS = 16;
+static const uint32_t GM_COEF_MASK = (1 << 19) - 1;
+
+static const Fixed PQ_M1 = fixed(2610.0 / 16384), PQ_M2 = fixed(2523.0 / 4096 * 128);
+static const Fixed PQ_INVERSE_M1 = fixed(16384.0 / 2610), PQ_INVERSE_M2 = fixed(4096.0 / 2523 / 128);
+static const Fixed PQ_C1 = fixed(3424.0 / 4096), PQ_C2 = fixed(2413.0 / 4096 * 32),
+                   PQ_C3 = fixed(2392.0 / 4096 * 32);
+
+static Fixed pqToLuminance(Fixed code) {
+    Fixed e = powFixed(code, PQ_INVERSE_M2);
+
+    return powFixed(div(std::max<Fixed>(e - PQ_C1, 0), PQ_C2 - mul(e, PQ_C3)), PQ_INVERSE_M1);
+}
+
+static Fixed luminanceToPq(Fixed luminance) {
+    Fixed y = powFixed(std::clamp<Fixed>(luminance, 0, ONE), PQ_M1);
+
+    return powFixed(div(PQ_C1 + mul(y, PQ_C2), ONE + mul(y, PQ_C3)), PQ_M2);
+}
+
+static const Fixed HLG_A = fixed(0.17883277), HLG_B = fixed(0.28466892), HLG_C = fixed(0.55991073);
+
+static Fixed hlgToLuminance(Fixed code) {
+    Fixed scene = (code <= ONE / 2) ? mul(code, code) / 3
+                                    : (expFixed(div(code - HLG_C, HLG_A)) + HLG_B) / 12;
+
+    return mul(powFixed(scene, HLG_SYSTEM_GAMMA), HLG_PEAK_LUMINANCE);
+}
+
+static Fixed luminanceToHlg(Fixed luminance) {
+    Fixed scene = powFixed(div(std::clamp<Fixed>(luminance, 0, HLG_PEAK_LUMINANCE),
+                               HLG_PEAK_LUMINANCE),
+                           HLG_INVERSE_SYSTEM_GAMMA);
+
+    return (scene <= ONE / 12) ? sqrtFixed(3 * scene) : mul(logFixed(12 * scene - HLG_B), HLG_A) + HLG_C;
+}
+
+// linear * slope below the threshold, scale * linear^exponent - offset above it
+struct SdrTransfer {
+    Fixed threshold, slope, scale, exponent, offset;
+};
+
+static Fixed encodeSdr(int transfer, Fixed linear) {
+    static const SdrTransfer SMPTE_170M = {fixed(0.018), fixed(4.5), fixed(1.099), fixed(0.45),
+                                           fixed(0.099)};
+    static const SdrTransfer GAMMA2_2 = {0, 0, ONE, fixed(1 / 2.2), 0};
+    static const SdrTransfer GAMMA2_6 = {0, 0, ONE, fixed(1 / 2.6), 0};
+    static const SdrTransfer GAMMA2_8 = {0, 0, ONE, fixed(1 / 2.8), 0};
+    static const SdrTransfer SRGB = {fixed(0.0031308), fixed(12.92), fixed(1.055), fixed(1 / 2.4),
+                                     fixed(0.055)};
+    const SdrTransfer *sdr;
+
+    switch (transfer) {
+        case HAL_DATASPACE_TRANSFER_LINEAR:
+            return linear;
+        case HAL_DATASPACE_TRANSFER_SMPTE_170M:
+            sdr = &SMPTE_170M;
+            break;
+        case HAL_DATASPACE_TRANSFER_GAMMA2_2:
+            sdr = &GAMMA2_2;
+            break;
+        case HAL_DATASPACE_TRANSFER_GAMMA2_6:
+            sdr = &GAMMA2_6;
+            break;
+        case HAL_DATASPACE_TRANSFER_GAMMA2_8:
+            sdr = &GAMMA2_8;
+            break;
+        default:
+            sdr = &SRGB;
+            break;
+    }
+
+    if (linear < sdr->threshold)
+        return mul(linear, sdr->slope);
+    return mul(powFixed(linear, sdr->exponent), sdr->scale) - sdr->offset;
+}
+
+using Matrix = std::array<Fixed, 9>;
+
+static Matrix multiply(const Matrix &a, const Matrix &b) {
+    Matrix m{};
+    for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 3; c++)
+            for (int k = 0; k < 3; k++)
+                m[r * 3 + c] += mul(a[r * 3 + k], b[k * 3 + c]);
+    return m;
+}
+
+static Matrix invert(const Matrix &m) {
+    auto minor = [&m](int a, int b, int c, int d) { return mul(m[a], m[b]) - mul(m[c], m[d]); };
+    Fixed det = mul(m[0], minor(4, 8, 5, 7)) - mul(m[1], minor(3, 8, 5, 6)) +
+                mul(m[2], minor(3, 7, 4, 6));
+
+    return {div(minor(4, 8, 5, 7), det), div(minor(2, 7, 1, 8), det),
+            div(minor(1, 5, 2, 4), det), div(minor(5, 6, 3, 8), det),
+            div(minor(0, 8, 2, 6), det), div(minor(2, 3, 0, 5), det),
+            div(minor(3, 7, 4, 6), det), div(minor(1, 6, 0, 7), det),
+            div(minor(0, 4, 1, 3), det)};
+}
+
+// returns false if @standard is not supported
+static bool rgbToXyz(int standard, Matrix &m) {
+    // x and y of the red, green and blue primaries
+    static const std::array<Fixed, 6> BT709 = {fixed(0.640), fixed(0.330), fixed(0.300),
+                                               fixed(0.600), fixed(0.150), fixed(0.060)};
+    static const std::array<Fixed, 6> BT2020 = {fixed(0.708), fixed(0.292), fixed(0.170),
+                                                fixed(0.797), fixed(0.131), fixed(0.046)};
+    static const std::array<Fixed, 6> DCI_P3 = {fixed(0.680), fixed(0.320), fixed(0.265),
+                                                fixed(0.690), fixed(0.150), fixed(0.060)};
+    static const Fixed WHITE_X = fixed(0.3127), WHITE_Y = fixed(0.3290); // D65
+    const std::array<Fixed, 6> *primaries;
+
+    switch (standard) {
+        case HAL_DATASPACE_STANDARD_UNSPECIFIED:
+        case HAL_DATASPACE_STANDARD_BT709:
+            primaries = &BT709;
+            break;
+        case HAL_DATASPACE_STANDARD_BT2020:
+        case HAL_DATASPACE_STANDARD_BT2020_CONSTANT_LUMINANCE:
+            primaries = &BT2020;
+            break;
+        case HAL_DATASPACE_STANDARD_DCI_P3:
+            primaries = &DCI_P3;
+            break;
+        default:
+            return false;
+    }
+
+    Matrix p;
+    for (int c = 0; c < 3; c++) {
+        Fixed x = (*primaries)[c * 2], y = (*primaries)[c * 2 + 1];
+        p[c] = div(x, y);
+        p[3 + c] = ONE;
+        p[6 + c] = div(ONE - x - y, y);
+    }
+
+    // scale the primaries to make R = G = B = 1 the white point
+    Matrix inv = invert(p);
+    const Fixed white[3] = {div(WHITE_X, WHITE_Y), ONE, div(ONE - WHITE_X - WHITE_Y, WHITE_Y)};
+    for (int c = 0; c < 3; c++) {
+        Fixed scale = mul(inv[c * 3], white[0]) + mul(inv[c * 3 + 1], white[1]) +
+                      mul(inv[c * 3 + 2], white[2]);
+        for (int r = 0; r < 3; r++)
+            m[r * 3 + c] = mul(p[r * 3 + c], scale);
+    }
+
+    return true;
+}
+
+// @value of 0.0 to 1.0 to the integers 0 to @max
+template <typename T>
+static T quantize(Fixed value, uint32_t max) {
+    return static_cast<T>(roundShift(std::clamp<Fixed>(value, 0, ONE) * max, FRACTION_BITS));
+}
+
+GeneratedDpp::GeneratedDpp(const Key &key) : mEotfConfig{}, mGmConfig{}, mOetfConfig{} {
+    const int transfer = key.dataspace & HAL_DATASPACE_TRANSFER_MASK;
+    const int target_transfer = key.target_dataspace & HAL_DATASPACE_TRANSFER_MASK;
+    // up to the 10000 cd/m2 of PQ
+    const Fixed black = static_cast<Fixed>(std::min(key.min_luminance, 100000000U)) * ONE / 100000000;
+    Fixed peak = key.max_luminance
+            ? static_cast<Fixed>(std::min(key.max_luminance, 10000U)) * ONE / 10000
+            : DEFAULT_MAX_LUMINANCE;
+    if (transfer == HAL_DATASPACE_TRANSFER_HLG)
+        peak = HLG_PEAK_LUMINANCE;
+    peak = std::max(peak, black + nits(1.0));
+
+    // linear light between the black and the peak luminance of the mastering display
+    auto &eotf = mEotfConfig.tf_data;
+    const std::size_t eotf_last = eotf.posx.size() - 1;
+    for (std::size_t k = 0; k <= eotf_last; k++) {
+        uint32_t code = std::min<uint32_t>(EOTF_X_MAX, (EOTF_X_MAX + 1) * k / eotf_last);
+        Fixed x = static_cast<Fixed>(code) * ONE / EOTF_X_MAX;
+        Fixed luminance = (transfer == HAL_DATASPACE_TRANSFER_HLG) ? hlgToLuminance(x)
+                                                                   : pqToLuminance(x);
+
+        eotf.posx[k] = static_cast<uint16_t>(code);
+        eotf.posy[k] = quantize<uint32_t>(div(luminance - black, peak - black), EOTF_Y_MAX);
+    }
+
+    // denser near black where the encodings are steeper
+    auto &oetf = mOetfConfig.tf_data;
+    const std::size_t oetf_last = oetf.posx.size() - 1;
+    for (std::size_t k = 0; k <= oetf_last; k++) {
+        Fixed x = static_cast<Fixed>(k) * ONE / oetf_last;
+        Fixed x2 = mul(x, x);
+        Fixed luminance = black + mul(x2, peak - black);
+        Fixed code;
+
+        if (target_transfer == HAL_DATASPACE_TRANSFER_ST2084) {
+            code = luminanceToPq(luminance);
+        } else if (target_transfer == HAL_DATASPACE_TRANSFER_HLG) {
+            code = luminanceToHlg(luminance);
+        } else {
+            // extended Reinhard tone curve mapping the peak to the SDR white
+            Fixed s = div(luminance, SDR_WHITE_LUMINANCE);
+            Fixed m = div(peak, SDR_WHITE_LUMINANCE);
+            if (m > ONE)
+                s = div(mul(s, ONE + div(div(s, m), m)), ONE + s);
+            code = encodeSdr(target_transfer, std::min(s, ONE));
+        }
+
+        oetf.posx[k] = quantize<uint32_t>(x2, OETF_X_MAX);
+        oetf.posy[k] = quantize<uint16_t>(code, OETF_Y_MAX);
+    }
+
+    mEotf.config = &mEotfConfig;
+    mEotf.enable = true;
+    mOetf.config = &mOetfConfig;
+    mOetf.enable = true;
+
+    const int standard = key.dataspace & HAL_DATASPACE_STANDARD_MASK;
+    const int target_standard = key.target_dataspace & HAL_DATASPACE_STANDARD_MASK;
+    Matrix src, dst;
+    if ((standard != target_standard) && rgbToXyz(standard, src) &&
+        rgbToXyz(target_standard, dst)) {
+        Matrix gm = multiply(invert(dst), src);
+        for (std::size_t i = 0; i < gm.size(); i++) {
+            Fixed coef = roundShift(gm[i], FRACTION_BITS - GM_COEF_FRACTION_BITS);
+            mGmConfig.matrix_data.coeffs[i] = static_cast<uint32_t>(coef) & GM_COEF_MASK;
+        }
+
+        mGm.config = &mGmConfig;
+        mGm.enable = true;
+    }
+}
+
+bool GeneratedDpp::isValidTarget(int dataspace) {
+    return ((dataspace & HAL_DATASPACE_STANDARD_MASK) != HAL_DATASPACE_STANDARD_UNSPECIFIED) &&
+           ((dataspace & HAL_DATASPACE_TRANSFER_MASK) != HAL_DATASPACE_TRANSFER_UNSPECIFIED);
+}
+
+std::shared_ptr<const GeneratedDpp> GeneratedDpp::get(const Key &key) {
+    struct Entry {
+        Key key;
+        std::shared_ptr<const GeneratedDpp> dpp;
+    };
+    static const std::size_t MAX_ENTRIES = 8;
+    static std::mutex lock;
+    static std::list<Entry> entries; // most recently used first
+
+    const int transfer = key.dataspace & HAL_DATASPACE_TRANSFER_MASK;
+    if ((transfer != HAL_DATASPACE_TRANSFER_ST2084) && (transfer != HAL_DATASPACE_TRANSFER_HLG))
+        return nullptr;
+    if (key.dataspace == key.target_dataspace)
+        return nullptr;
+    // the gamut and the transfer to convert to are not guessed
+    if (!isValidTarget(key.target_dataspace))
+        return nullptr;
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    for (auto it = entries.begin(); it != entries.end(); it++) {
+        if (it->key == key) {
+            entries.splice(entries.begin(), entries, it);
+            return it->dpp;
+        }
+    }
+
+    entries.push_front({key, std::make_shared<GeneratedDpp>(key)});
+    if (entries.size() > MAX_ENTRIES)
+        entries.pop_back();
+
+    return entries.front().dpp;
+}
@@ -0,0 +1,77 @@
+/*
+ *  libacryl_plugins/hdr_lut_generator.h
+ *
+ *   Copyright 2020 Samsung Electronics Co., Ltd.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#ifndef LIBACRYL_HDR_LUT_GENERATOR_H_
+#define LIBACRYL_HDR_LUT_GENERATOR_H_
+
+#include <memory>
+
+#include <gs101/displaycolor/displaycolor_gs101.h>
+
+/*
+ * HDR stages generated from the dataspaces and the mastering luminance of a
+ * layer for the layers that displaycolor did not provide an IDpp for.
+ *
+ * EOTF decodes PQ or HLG to linear light normalized to the mastering peak
+ * luminance. GM converts the gamut of the layer to the gamut of the target.
+ * OETF encodes to the transfer of the target, tone mapping to the SDR
+ * reference white if the target is not HDR. DTM is never enabled.
+ *
+ * The writer only uses them if built with G2D_HDR_GENERATE_STAGES: the
+ * fractional bits of the GM coefficients are assumed, the SFR spec does not
+ * give them.
+ */
+class GeneratedDpp : public displaycolor::IDisplayColorGS101::IDpp {
+public:
+    struct Key {
+        int dataspace;
+        unsigned int min_luminance; // 0.0001 cd/m2
+        unsigned int max_luminance; // cd/m2
+        int target_dataspace;
+
+        bool operator==(const Key &other) const {
+            return (dataspace == other.dataspace) && (min_luminance == other.min_luminance) &&
+                   (max_luminance == other.max_luminance) &&
+                   (target_dataspace == other.target_dataspace);
+        }
+    };
+
+    // returns NULL if @key.dataspace is not PQ or HLG or @key.target_dataspace is not valid
+    static std::shared_ptr<const GeneratedDpp> get(const Key &key);
+
+    // true if @dataspace specifies both a standard and a transfer
+    static bool isValidTarget(int dataspace);
+
+    explicit GeneratedDpp(const Key &key);
+
+    virtual const EotfData &EotfLut() const override { return mEotf; }
+    virtual const GmData &Gm() const override { return mGm; }
+    virtual const DtmData &Dtm() const override { return mDtm; }
+    virtual const OetfData &OetfLut() const override { return mOetf; }
+
+private:
+    EotfData::ConfigType mEotfConfig;
+    GmData::ConfigType mGmConfig;
+    OetfData::ConfigType mOetfConfig;
+
+    EotfData mEotf;
+    GmData mGm;
+    DtmData mDtm;
+    OetfData mOetf;
+};
+
+#endif // LIBACRYL_HDR_LUT_GENERATOR_H_
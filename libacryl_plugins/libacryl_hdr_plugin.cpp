@@ -15,105 +15,554 @@
  *  See the License for the specific language governing permissions and
  *  limitations under the License.
  */
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cinttypes>
 #include <array>
+#include <bitset>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define LOG_TAG "libacryl_hdr_plugin"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+#include <cutils/trace.h>
+#include <log/log.h>
+#include <system/graphics.h>
 
 #include <gs101/displaycolor/displaycolor_gs101.h>
-#include <hardware/exynos/g2d_hdr_plugin.h>
-
-#define HDR_BASE 0x3000
-#define HDR_SFR_LEN 0x800
-
-#define HDR_COM_CTRL 0x3004 // [0] HDR enable
-static const uint32_t VAL_HDR_CTRL_ENABLE = 1;
-
-#define HDR_MOD_CTRL_NUM  1   // [0] oetf enable, [1] eotf enable [2] gm enable [5] tm enable
-#define HDR_OETF_POSX_NUM 17  // two 16-bit from LSB
-#define HDR_OETF_POSY_NUM 17  // two 10-bit from LSB
-#define HDR_EOTF_POSX_NUM 65  // two 10-bit from LSB
-#define HDR_EOTF_POSY_NUM 129 // one 16-bit
-#define HDR_GM_COEF_NUM   9   // one 19-bit
-#define HDR_GM_OFF_NUM    3   // one 17-bit
-#define HDR_TM_COEF_NUM   1   // three 10-bit from LSB (R, G, B)
-#define HDR_TM_RNGX_NUM   1   // two 16-bit from LSB (min:max)
-#define HDR_TM_RNGY_NUM   1   // two 9-bit from LSB (min:max)
-#define HDR_TM_POSX_NUM   17  // two 16-bit from LSB
-#define HDR_TM_POSY_NUM   33  // one 27-bit from LSB
-
-#define HDR_MOD_CTRL_OFFSET  (0x8)
-static const uint32_t HDR_ENABLE_OETF = 1 << 0;
-static const uint32_t HDR_ENABLE_EOTF = 1 << 1;
-static const uint32_t HDR_ENABLE_GM   = 1 << 2;
-static const uint32_t HDR_ENABLE_DTM  = 1 << 5;
-
-#define HDR_OETF_POSX_OFFSET (HDR_MOD_CTRL_OFFSET  + 4 * HDR_MOD_CTRL_NUM )
-#define HDR_OETF_POSY_OFFSET (HDR_OETF_POSX_OFFSET + 4 * HDR_OETF_POSX_NUM)
-#define HDR_EOTF_POSX_OFFSET (HDR_OETF_POSY_OFFSET + 4 * HDR_OETF_POSY_NUM)
-#define HDR_EOTF_POSY_OFFSET (HDR_EOTF_POSX_OFFSET + 4 * HDR_EOTF_POSX_NUM)
-#define HDR_GM_COEF_OFFSET   (HDR_EOTF_POSY_OFFSET + 4 * HDR_EOTF_POSY_NUM)
-#define HDR_GM_OFF_OFFSET    (HDR_GM_COEF_OFFSET   + 4 * HDR_GM_COEF_NUM  )
-#define HDR_TM_COEF_OFFSET   (HDR_GM_OFF_OFFSET    + 4 * HDR_GM_OFF_NUM   )
-#define HDR_TM_RNGX_OFFSET   (HDR_TM_COEF_OFFSET   + 4 * HDR_TM_COEF_NUM  )
-#define HDR_TM_RNGY_OFFSET   (HDR_TM_RNGX_OFFSET   + 4 * HDR_TM_RNGX_NUM  )
-#define HDR_TM_POSX_OFFSET   (HDR_TM_RNGY_OFFSET   + 4 * HDR_TM_RNGY_NUM  )
-#define HDR_TM_POSY_OFFSET   (HDR_TM_POSX_OFFSET   + 4 * HDR_TM_POSX_NUM  )
-
-#define HDR_LAYER_BASE(layer) (HDR_BASE + HDR_SFR_LEN * (layer))
-
-#define HDR_MOD_CTRL(layer)  (HDR_LAYER_BASE(layer) + HDR_MOD_CTRL_OFFSET )
-#define HDR_OETF_POSX(layer) (HDR_LAYER_BASE(layer) + HDR_OETF_POSX_OFFSET)
-#define HDR_OETF_POSY(layer) (HDR_LAYER_BASE(layer) + HDR_OETF_POSY_OFFSET)
-#define HDR_EOTF_POSX(layer) (HDR_LAYER_BASE(layer) + HDR_EOTF_POSX_OFFSET)
-#define HDR_EOTF_POSY(layer) (HDR_LAYER_BASE(layer) + HDR_EOTF_POSY_OFFSET)
-#define HDR_GM_COEF(layer)   (HDR_LAYER_BASE(layer) + HDR_GM_COEF_OFFSET  )
-#define HDR_GM_OFF(layer)    (HDR_LAYER_BASE(layer) + HDR_GM_OFF_OFFSET   )
-#define HDR_TM_COEF(layer)   (HDR_LAYER_BASE(layer) + HDR_TM_COEF_OFFSET  )
-#define HDR_TM_RNGX(layer)   (HDR_LAYER_BASE(layer) + HDR_TM_RNGX_OFFSET  )
-#define HDR_TM_RNGY(layer)   (HDR_LAYER_BASE(layer) + HDR_TM_RNGY_OFFSET  )
-#define HDR_TM_POSX(layer)   (HDR_LAYER_BASE(layer) + HDR_TM_POSX_OFFSET  )
-#define HDR_TM_POSY(layer)   (HDR_LAYER_BASE(layer) + HDR_TM_POSY_OFFSET  )
-
-#define G2D_LAYER_HDRMODE(i) (0x290 + (i) * 0x100)
-
-#define MAX_LAYER_COUNT 4
-#define HDR_LAYER_SFR_COUNT (\
-      HDR_MOD_CTRL_NUM + HDR_OETF_POSX_NUM + HDR_OETF_POSY_NUM + \
-      HDR_EOTF_POSX_NUM + HDR_EOTF_POSY_NUM + HDR_GM_COEF_NUM + \
-      HDR_GM_OFF_NUM + HDR_TM_COEF_NUM + HDR_TM_RNGX_NUM + \
-      HDR_TM_RNGY_NUM + HDR_TM_POSX_NUM + HDR_TM_POSY_NUM\
-      )
-
-static const size_t NUM_HDR_COEFFICIENTS = HDR_LAYER_SFR_COUNT * MAX_LAYER_COUNT + 1; // HDR SFR COUNT x LAYER COUNT + COM_CTRL
-static const size_t NUM_HDR_MODE_REGS = MAX_LAYER_COUNT;
-
-class G2DHdrCommandWriter: public IG2DHdr10CommandWriter {
-    std::bitset<MAX_LAYER_COUNT> mLayerAlphaMap;
-    std::array<displaycolor::IDisplayColorGS101::IDpp *, MAX_LAYER_COUNT> mLayerData{};
+#include <gs101/libacryl_plugins/g2d_hdr_plugin_gs101.h>
+
+#include "g2d_hdr_sfr.h"
+#ifdef G2D_HDR_VERIFY_COMMANDS
+#include "g2d_hdr_sfr_model.h"
+#endif
+#include "hdr_lut_generator.h"
+
+// HDR SFR COUNT x LAYER COUNT + COM_CTRL
+static inline size_t numHdrCoefficients(size_t layer_count) {
+    return HDR_LAYER_SFR_COUNT * layer_count + 1;
+}
+static inline size_t numHdrModeRegs(size_t layer_count) { return layer_count; }
+// Number of command lists that can be in flight between getCommands() and putCommands()
+static const size_t NUM_CMDLIST_BUFFERS = 3;
+// Shorter runs take no less space in the burst format than in the flat one
+static const uint32_t MIN_BURST_COUNT = 3;
+
+// Last value written to each HDR SFR of each layer for the shadow register mode
+class ShadowRegisters {
+    std::vector<std::array<uint32_t, HDR_LAYER_SFR_COUNT>> mValues;
+    std::vector<std::bitset<HDR_LAYER_SFR_COUNT>> mValid;
 
 public:
-    struct CommandList {
-        std::array<g2d_reg, NUM_HDR_COEFFICIENTS> commands;     // (294 * 4 + 1) * 8 bytes
-        std::array<g2d_reg, NUM_HDR_MODE_REGS> layer_hdr_modes; // 4 * 8 bytes
-        g2d_commandlist cmdlist{};
+    explicit ShadowRegisters(std::size_t layer_count) : mValues(layer_count), mValid(layer_count) { }
+
+    // returns false if the SFR at @offset already holds @value
+    bool update(uint32_t offset, uint32_t value) {
+        std::size_t layer = (offset - HDR_BASE) / HDR_SFR_LEN;
+        std::size_t sfr = (offset - HDR_LAYER_BASE(layer) - HDR_MOD_CTRL_OFFSET) / sizeof(value);
+
+        if (mValid[layer][sfr] && (mValues[layer][sfr] == value))
+            return false;
+
+        mValid[layer].set(sfr);
+        mValues[layer][sfr] = value;
+        return true;
+    }
+
+    void invalidate() {
+        for (auto &valid : mValid)
+            valid.reset();
+    }
+};
+
+using IDpp = displaycolor::IDisplayColorGS101::IDpp;
+
+/*
+ * Bulk encoders of SFR values and g2d_reg streams. The vector versions
+ * handle several registers per iteration and leave the remainder to the
+ * scalar loops.
+ */
+#if defined(__ARM_NEON)
+using VecU32 = uint32x4_t;
+static const std::size_t VEC_LANES = 4;
+
+static inline VecU32 vecLoad(const uint32_t *src) { return vld1q_u32(src); }
+static inline VecU32 vecLoadPairs(const uint32_t *src) {
+    uint32x4x2_t pairs = vld2q_u32(src);
+    return vorrq_u32(pairs.val[0], vshlq_n_u32(pairs.val[1], 16));
+}
+static inline void vecStore(uint32_t *out, VecU32 values) { vst1q_u32(out, values); }
+static inline VecU32 vecOffsets(uint32_t offset) {
+    const uint32_t offsets[VEC_LANES] = {offset, offset + 4, offset + 8, offset + 12};
+    return vld1q_u32(offsets);
+}
+static inline VecU32 vecSplat(uint32_t value) { return vdupq_n_u32(value); }
+static inline VecU32 vecAdd(VecU32 a, VecU32 b) { return vaddq_u32(a, b); }
+static inline void vecStoreRegs(g2d_reg *out, VecU32 offsets, VecU32 values) {
+    uint32x4x2_t regs = {{offsets, values}};
+    vst2q_u32(reinterpret_cast<uint32_t *>(out), regs);
+}
+#define G2D_HDR_VECTOR_ENCODER
+#elif defined(__AVX2__)
+using VecU32 = __m256i;
+static const std::size_t VEC_LANES = 8;
+
+static inline VecU32 vecLoad(const uint32_t *src) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+}
+static inline VecU32 vecLoadPairs(const uint32_t *src) {
+    const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    __m256i lo = _mm256_permutevar8x32_epi32(vecLoad(src), even);
+    __m256i hi = _mm256_permutevar8x32_epi32(vecLoad(src + VEC_LANES), even);
+    __m256i x = _mm256_permute2x128_si256(lo, hi, 0x20);
+    __m256i y = _mm256_permute2x128_si256(lo, hi, 0x31);
+    return _mm256_or_si256(x, _mm256_slli_epi32(y, 16));
+}
+static inline void vecStore(uint32_t *out, VecU32 values) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), values);
+}
+static inline VecU32 vecOffsets(uint32_t offset) {
+    return _mm256_add_epi32(_mm256_set1_epi32(offset),
+                            _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28));
+}
+static inline VecU32 vecSplat(uint32_t value) { return _mm256_set1_epi32(value); }
+static inline VecU32 vecAdd(VecU32 a, VecU32 b) { return _mm256_add_epi32(a, b); }
+static inline void vecStoreRegs(g2d_reg *out, VecU32 offsets, VecU32 values) {
+    __m256i lo = _mm256_unpacklo_epi32(offsets, values);
+    __m256i hi = _mm256_unpackhi_epi32(offsets, values);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + VEC_LANES / 2),
+                        _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+#define G2D_HDR_VECTOR_ENCODER
+#elif defined(__SSE2__)
+using VecU32 = __m128i;
+static const std::size_t VEC_LANES = 4;
+
+static inline VecU32 vecLoad(const uint32_t *src) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+}
+static inline VecU32 vecLoadPairs(const uint32_t *src) {
+    __m128i lo = _mm_shuffle_epi32(vecLoad(src), _MM_SHUFFLE(3, 1, 2, 0));
+    __m128i hi = _mm_shuffle_epi32(vecLoad(src + VEC_LANES), _MM_SHUFFLE(3, 1, 2, 0));
+    __m128i x = _mm_unpacklo_epi64(lo, hi);
+    __m128i y = _mm_unpackhi_epi64(lo, hi);
+    return _mm_or_si128(x, _mm_slli_epi32(y, 16));
+}
+static inline void vecStore(uint32_t *out, VecU32 values) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), values);
+}
+static inline VecU32 vecOffsets(uint32_t offset) {
+    return _mm_setr_epi32(offset, offset + 4, offset + 8, offset + 12);
+}
+static inline VecU32 vecSplat(uint32_t value) { return _mm_set1_epi32(value); }
+static inline VecU32 vecAdd(VecU32 a, VecU32 b) { return _mm_add_epi32(a, b); }
+static inline void vecStoreRegs(g2d_reg *out, VecU32 offsets, VecU32 values) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi32(offsets, values));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + VEC_LANES / 2),
+                     _mm_unpackhi_epi32(offsets, values));
+}
+#define G2D_HDR_VECTOR_ENCODER
+#endif
+
+// Expands a burst of @count consecutive SFRs: out[k] = {offset + 4k, values[k]}
+static void expandBurst(g2d_reg *out, uint32_t offset, const uint32_t *values, std::size_t count) {
+    std::size_t k = 0;
+#ifdef G2D_HDR_VECTOR_ENCODER
+    VecU32 offsets = vecOffsets(offset);
+    const VecU32 step = vecSplat(VEC_LANES * sizeof(uint32_t));
+    for (; k + VEC_LANES <= count; k += VEC_LANES) {
+        vecStoreRegs(out + k, offsets, vecLoad(values + k));
+        offsets = vecAdd(offsets, step);
+    }
+#endif
+    for (; k < count; k++)
+        out[k] = {offset + static_cast<uint32_t>(k * sizeof(uint32_t)), values[k]};
+}
+
+// out[k] = src[2k] | src[2k + 1] << 16
+static void packPairs(uint32_t *out, const uint16_t *src, std::size_t count) {
+    // two 16-bit entries from LSB are the little-endian layout of the source
+    for (std::size_t k = 0; k < count; k++)
+        out[k] = src[2 * k] | static_cast<uint32_t>(src[2 * k + 1]) << 16;
+}
+
+static void packPairs(uint32_t *out, const uint32_t *src, std::size_t count) {
+    std::size_t k = 0;
+#ifdef G2D_HDR_VECTOR_ENCODER
+    for (; k + VEC_LANES <= count; k += VEC_LANES)
+        vecStore(out + k, vecLoadPairs(src + 2 * k));
+#endif
+    for (; k < count; k++)
+        out[k] = src[2 * k] | src[2 * k + 1] << 16;
+}
+
+// Two entries per SFR from LSB. The last SFR holds a single entry if the length is odd.
+template <typename sinkT, typename containerT>
+void updateDouble(sinkT &sink, const containerT &container, uint32_t offset) {
+    std::size_t pairs = container.size() / 2;
+    uint32_t *out = sink.append(offset, pairs + container.size() % 2);
+
+    packPairs(out, container.data(), pairs);
+    if ((container.size() % 2) == 1)
+        out[pairs] = container.back();
+}
+
+template <typename sinkT, typename containerT>
+void updateSingle(sinkT &sink, const containerT &container, uint32_t offset) {
+    std::copy(container.begin(), container.end(), sink.append(offset, container.size()));
+}
+
+// The fields are 16-bit, shifted as uint32_t not to overflow int
+template <typename sinkT>
+void updateTmCoef(sinkT &sink, const IDpp::DtmData::ConfigType &config, uint32_t offset) {
+    offset = sink.set_and_get_next_offset(offset, config.coeff_r | (config.coeff_g << 10) |
+                                                  (static_cast<uint32_t>(config.coeff_b) << 20));
+    offset = sink.set_and_get_next_offset(offset, config.rng_x_min |
+                                                  (static_cast<uint32_t>(config.rng_x_max) << 16));
+    sink.set_and_get_next_offset(offset, config.rng_y_min |
+                                         (static_cast<uint32_t>(config.rng_y_max) << 16));
+}
+
+// FNV-1a over the bytes of @data
+static uint64_t hashBytes(uint64_t hash, const void *data, std::size_t len) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (std::size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static const uint64_t HASH_SEED = 0xcbf29ce484222325ULL;
+
+template <typename containerT>
+uint64_t hashContainer(uint64_t hash, const containerT &container) {
+    return hashBytes(hash, container.data(), container.size() * sizeof(container[0]));
+}
+
+template <typename T>
+uint64_t hashValue(uint64_t hash, T value) {
+    return hashBytes(hash, &value, sizeof(value));
+}
+
+/*
+ * Packed SFR values of one stage in the burst format: runs of consecutive
+ * SFRs, each with the offset of its first SFR relative to HDR_LAYER_BASE(0)
+ * and the number of SFRs, followed by their values. This is about half the
+ * size of the equivalent g2d_reg stream. Stage tables are laid out back to
+ * back, so a stage is usually a single run.
+ */
+struct HdrSegment {
+    struct Burst {
+        uint32_t offset;
+        uint32_t count;
+    };
+    std::vector<Burst> bursts;
+    std::vector<uint32_t> values;
+
+    // returns the place for @count SFR values starting at @offset
+    uint32_t *append(uint32_t offset, std::size_t count) {
+        if (bursts.empty() ||
+            (bursts.back().offset + bursts.back().count * sizeof(uint32_t) != offset))
+            bursts.push_back({offset, 0});
+        bursts.back().count += count;
+        values.resize(values.size() + count);
+        return &values[values.size() - count];
+    }
+
+    uint32_t set_and_get_next_offset(uint32_t offset, uint32_t value) {
+        *append(offset, 1) = value;
+        return offset + sizeof(value);
+    }
+};
+
+/*
+ * LRU of packed stage segments keyed by the content of the stage config.
+ * The same instance is shared by all writers in the process.
+ */
+template <typename stageT>
+class HdrSegmentCache {
+    using ConfigType = typename stageT::ConfigType;
+    static const std::size_t MAX_ENTRIES = 8;
 
-        CommandList() {
-            cmdlist.commands = commands.data();
-            cmdlist.layer_hdr_mode = layer_hdr_modes.data();
+    struct Entry {
+        uint64_t hash;
+        ConfigType config;
+        std::shared_ptr<const HdrSegment> segment;
+    };
+
+    std::mutex mLock;
+    std::list<Entry> mEntries; // most recently used first
+
+public:
+    // @hit is set if the segment of @config was already cached
+    std::shared_ptr<const HdrSegment> get(const ConfigType &config, bool &hit) {
+        uint64_t hash = stageT::hash(config);
+
+        std::lock_guard<std::mutex> lock(mLock);
+
+        hit = true;
+        for (auto it = mEntries.begin(); it != mEntries.end(); it++) {
+            if ((it->hash == hash) && stageT::equal(it->config, config)) {
+                mEntries.splice(mEntries.begin(), mEntries, it);
+                return it->segment;
+            }
         }
 
-        ~CommandList() { }
+        hit = false;
+
+        auto segment = std::make_shared<HdrSegment>();
+        stageT::update(*segment, config, 0);
+
+        mEntries.push_front({hash, config, segment});
+        if (mEntries.size() > MAX_ENTRIES)
+            mEntries.pop_back();
+
+        return segment;
+    }
+
+    static HdrSegmentCache &getInstance() {
+        static HdrSegmentCache cache;
+        return cache;
+    }
+};
+
+struct EotfStage {
+    using ConfigType = IDpp::EotfData::ConfigType;
+    static const uint32_t MODE_CTRL = HDR_ENABLE_EOTF;
+
+    static uint64_t hash(const ConfigType &config) {
+        uint64_t hash = hashContainer(HASH_SEED, config.tf_data.posx);
+        return hashContainer(hash, config.tf_data.posy);
+    }
 
-        void reset() {
+    static bool equal(const ConfigType &a, const ConfigType &b) {
+        return (a.tf_data.posx == b.tf_data.posx) && (a.tf_data.posy == b.tf_data.posy);
+    }
+
+    template <typename sinkT>
+    static void update(sinkT &sink, const ConfigType &config, std::size_t layer) {
+        updateDouble(sink, config.tf_data.posx, HDR_EOTF_POSX(layer));
+        updateSingle(sink, config.tf_data.posy, HDR_EOTF_POSY(layer));
+    }
+};
+
+struct GmStage {
+    using ConfigType = IDpp::GmData::ConfigType;
+    static const uint32_t MODE_CTRL = HDR_ENABLE_GM;
+
+    static uint64_t hash(const ConfigType &config) {
+        uint64_t hash = hashContainer(HASH_SEED, config.matrix_data.coeffs);
+        return hashContainer(hash, config.matrix_data.offsets);
+    }
+
+    static bool equal(const ConfigType &a, const ConfigType &b) {
+        return (a.matrix_data.coeffs == b.matrix_data.coeffs) &&
+               (a.matrix_data.offsets == b.matrix_data.offsets);
+    }
+
+    template <typename sinkT>
+    static void update(sinkT &sink, const ConfigType &config, std::size_t layer) {
+        updateSingle(sink, config.matrix_data.coeffs, HDR_GM_COEF(layer));
+        updateSingle(sink, config.matrix_data.offsets, HDR_GM_OFF(layer));
+    }
+};
+
+struct DtmStage {
+    using ConfigType = IDpp::DtmData::ConfigType;
+    static const uint32_t MODE_CTRL = HDR_ENABLE_DTM;
+
+    static uint64_t hash(const ConfigType &config) {
+        uint64_t hash = hashContainer(HASH_SEED, config.tf_data.posx);
+        hash = hashContainer(hash, config.tf_data.posy);
+        hash = hashValue(hash, config.coeff_r);
+        hash = hashValue(hash, config.coeff_g);
+        hash = hashValue(hash, config.coeff_b);
+        hash = hashValue(hash, config.rng_x_min);
+        hash = hashValue(hash, config.rng_x_max);
+        hash = hashValue(hash, config.rng_y_min);
+        return hashValue(hash, config.rng_y_max);
+    }
+
+    static bool equal(const ConfigType &a, const ConfigType &b) {
+        return (a.tf_data.posx == b.tf_data.posx) && (a.tf_data.posy == b.tf_data.posy) &&
+               (a.coeff_r == b.coeff_r) && (a.coeff_g == b.coeff_g) && (a.coeff_b == b.coeff_b) &&
+               (a.rng_x_min == b.rng_x_min) && (a.rng_x_max == b.rng_x_max) &&
+               (a.rng_y_min == b.rng_y_min) && (a.rng_y_max == b.rng_y_max);
+    }
+
+    template <typename sinkT>
+    static void update(sinkT &sink, const ConfigType &config, std::size_t layer) {
+        updateTmCoef(sink, config, HDR_TM_COEF(layer));
+        updateDouble(sink, config.tf_data.posx, HDR_TM_POSX(layer));
+        updateSingle(sink, config.tf_data.posy, HDR_TM_POSY(layer));
+    }
+};
+
+struct OetfStage {
+    using ConfigType = IDpp::OetfData::ConfigType;
+    static const uint32_t MODE_CTRL = HDR_ENABLE_OETF;
+
+    static uint64_t hash(const ConfigType &config) {
+        uint64_t hash = hashContainer(HASH_SEED, config.tf_data.posx);
+        return hashContainer(hash, config.tf_data.posy);
+    }
+
+    static bool equal(const ConfigType &a, const ConfigType &b) {
+        return (a.tf_data.posx == b.tf_data.posx) && (a.tf_data.posy == b.tf_data.posy);
+    }
+
+    template <typename sinkT>
+    static void update(sinkT &sink, const ConfigType &config, std::size_t layer) {
+        updateDouble(sink, config.tf_data.posx, HDR_OETF_POSX(layer));
+        updateDouble(sink, config.tf_data.posy, HDR_OETF_POSY(layer));
+    }
+};
+
+// Counters of the HDR command generation. The totals are updated without
+// locking so that dump() can read them from any thread. The per-job values
+// are reported as atrace counters while graphics tracing is enabled.
+class HdrStats {
+    std::atomic<uint64_t> mJobs{0};
+    std::atomic<uint64_t> mEotfLayers{0};
+    std::atomic<uint64_t> mGmLayers{0};
+    std::atomic<uint64_t> mDtmLayers{0};
+    std::atomic<uint64_t> mOetfLayers{0};
+    std::atomic<uint64_t> mCommands{0};
+    std::atomic<uint64_t> mCacheHits{0};
+    std::atomic<uint64_t> mTimeNs{0};
+    // layers of the current job with each stage enabled: eotf, gm, dtm, oetf
+    std::array<int64_t, 4> mJobLayers{};
+
+    static void add(std::atomic<uint64_t> &counter, uint64_t value) {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    static uint64_t get(const std::atomic<uint64_t> &counter) {
+        return counter.load(std::memory_order_relaxed);
+    }
+
+public:
+    void addLayer(uint32_t modectl) {
+        if (modectl & HDR_ENABLE_EOTF) {
+            add(mEotfLayers, 1);
+            mJobLayers[0]++;
+        }
+        if (modectl & HDR_ENABLE_GM) {
+            add(mGmLayers, 1);
+            mJobLayers[1]++;
+        }
+        if (modectl & HDR_ENABLE_DTM) {
+            add(mDtmLayers, 1);
+            mJobLayers[2]++;
+        }
+        if (modectl & HDR_ENABLE_OETF) {
+            add(mOetfLayers, 1);
+            mJobLayers[3]++;
+        }
+    }
+
+    void addJob(const g2d_commandlist &cmdlist, uint32_t cache_hits, uint64_t time_ns) {
+        add(mJobs, 1);
+        add(mCommands, cmdlist.command_count);
+        add(mCacheHits, cache_hits);
+        add(mTimeNs, time_ns);
+
+        if (ATRACE_ENABLED()) {
+            ATRACE_INT64("HDR layers", cmdlist.layer_count);
+            ATRACE_INT64("HDR eotf layers", mJobLayers[0]);
+            ATRACE_INT64("HDR gm layers", mJobLayers[1]);
+            ATRACE_INT64("HDR dtm layers", mJobLayers[2]);
+            ATRACE_INT64("HDR oetf layers", mJobLayers[3]);
+            ATRACE_INT64("HDR commands", cmdlist.command_count);
+            ATRACE_INT64("HDR cache hits", cache_hits);
+            ATRACE_INT64("HDR getCommands ns", time_ns);
+        }
+        mJobLayers.fill(0);
+    }
+
+    void dump(std::string &result) const {
+        char buf[256];
+        uint64_t jobs = get(mJobs);
+
+        snprintf(buf, sizeof(buf),
+                 "G2D HDR jobs: %" PRIu64 ", commands: %" PRIu64 ", cache hits: %" PRIu64
+                 ", getCommands: %" PRIu64 " ns/job\n",
+                 jobs, get(mCommands), get(mCacheHits), jobs ? get(mTimeNs) / jobs : 0);
+        result.append(buf);
+        snprintf(buf, sizeof(buf),
+                 "G2D HDR layers with eotf: %" PRIu64 ", gm: %" PRIu64 ", dtm: %" PRIu64
+                 ", oetf: %" PRIu64 "\n",
+                 get(mEotfLayers), get(mGmLayers), get(mDtmLayers), get(mOetfLayers));
+        result.append(buf);
+    }
+};
+
+class G2DHdrCommandWriter: public IG2DHdr10CommandWriterGS101 {
+    const std::size_t mLayerCount;
+    std::vector<bool> mLayerAlphaMap;
+    std::vector<IDpp *> mLayerData;
+    // static metadata of the layers to generate the stages for if mLayerData is NULL
+    std::vector<GeneratedDpp::Key> mLayerMetadata;
+    int mTargetDataspace = HAL_DATASPACE_UNKNOWN;
+    ShadowRegisters mShadowRegs;
+    bool mShadowMode = false;
+    bool mBurstFormat = false;
+    HdrStats mStats;
+#ifdef G2D_HDR_VERIFY_COMMANDS
+    // SFRs programmed by all the command lists built so far
+    std::unique_ptr<G2DHdrSfrModel> mModel;
+#endif
+
+public:
+    struct CommandList {
+        g2d_reg *commands = nullptr;        // numHdrCoefficients() entries
+        g2d_reg *layer_hdr_modes = nullptr; // numHdrModeRegs() entries
+        g2d_commandlist cmdlist{};
+        ShadowRegisters *shadow = nullptr;
+        bool burst_format = false;
+        bool in_use = false;
+        uint32_t cache_hits = 0;
+
+        void init(g2d_reg *command_regs, g2d_reg *hdr_mode_regs) {
+            commands = command_regs;
+            layer_hdr_modes = hdr_mode_regs;
+            cmdlist.commands = commands;
+            cmdlist.layer_hdr_mode = layer_hdr_modes;
+        }
+
+        void reset(ShadowRegisters *shadowRegs, bool burstFormat) {
             cmdlist.command_count = 0;
             cmdlist.layer_count = 0;
+            shadow = shadowRegs;
+            burst_format = burstFormat;
+            cache_hits = 0;
         }
 
         g2d_commandlist *get() { return &cmdlist; }
 
-        uint32_t set_and_get_next_offset(uint32_t offset, uint32_t value) {
+        void set(uint32_t offset, uint32_t value) {
             commands[cmdlist.command_count].offset = offset;
             commands[cmdlist.command_count].value = value;
             cmdlist.command_count++;
+        }
+
+        // skips the SFRs that are not changed in the shadow register mode
+        uint32_t set_and_get_next_offset(uint32_t offset, uint32_t value) {
+            if (!shadow || shadow->update(offset, value))
+                set(offset, value);
             return offset + sizeof(value);
         }
 
@@ -126,112 +575,354 @@ public:
             if (alpha_premultiplied)
                 hdr_mode.value |= G2D_LAYER_HDRMODE_DEMULT_ALPHA;
 
-            set_and_get_next_offset(HDR_MOD_CTRL(layer), modectl);
+            set(HDR_MOD_CTRL(layer), modectl);
         }
 
-        template <typename containerT>
-        void updateDouble(const containerT &container, uint32_t offset) {
-            for (std::size_t n = 0; n < container.size(); n += 2)
-                offset = set_and_get_next_offset(offset, container[n] | container[n + 1] << 16);
-            if ((container.size() % 2) == 1)
-                set_and_get_next_offset(offset, container.back());
+        // a run of @count SFRs in the burst format, never larger than in the flat one
+        void setBurst(uint32_t offset, const uint32_t *values, uint32_t count) {
+            g2d_reg *header = &commands[cmdlist.command_count];
+            header->offset = offset | G2D_HDR_BURST_FLAG;
+            header->value = count;
+
+            uint32_t *out = reinterpret_cast<uint32_t *>(header + 1);
+            std::copy(values, values + count, out);
+            if (count % 2)
+                out[count] = 0;
+            cmdlist.command_count += 1 + (count + 1) / 2;
         }
 
-        template <typename containerT>
-        void updateSingle(const containerT &container, uint32_t offset) {
-            for (auto item : container)
-                offset = set_and_get_next_offset(offset, item);
+        // writes the cached segment of a stage as commands for @layer
+        void updateSegment(const HdrSegment &segment, std::size_t layer) {
+            const uint32_t base = HDR_LAYER_BASE(layer) - HDR_LAYER_BASE(0);
+            const uint32_t *values = segment.values.data();
+
+            for (auto &burst : segment.bursts) {
+                if (shadow) {
+                    uint32_t offset = burst.offset + base;
+                    for (uint32_t k = 0; k < burst.count; k++)
+                        offset = set_and_get_next_offset(offset, values[k]);
+                } else if (burst_format && (burst.count >= MIN_BURST_COUNT)) {
+                    setBurst(burst.offset + base, values, burst.count);
+                } else {
+                    expandBurst(&commands[cmdlist.command_count], burst.offset + base, values,
+                                burst.count);
+                    cmdlist.command_count += burst.count;
+                }
+                values += burst.count;
+            }
         }
 
-        void updateTmCoef(const displaycolor::IDisplayColorGS101::IDpp::DtmData::ConfigType &config, uint32_t offset) {
-            offset = set_and_get_next_offset(offset, config.coeff_r | (config.coeff_g << 10) | (config.coeff_b << 20));
-            offset = set_and_get_next_offset(offset, config.rng_x_min | (config.rng_x_max << 16));
-            set_and_get_next_offset(offset, config.rng_y_min | (config.rng_y_max << 16));
+        template <typename stageT, typename stageDataT>
+        uint32_t updateStage(const stageDataT &stage, std::size_t layer) {
+            if (!stage.enable || stage.config == nullptr)
+                return 0;
+
+            bool hit;
+            auto segment = HdrSegmentCache<stageT>::getInstance().get(*stage.config, hit);
+            updateSegment(*segment, layer);
+            cache_hits += hit;
+            return stageT::MODE_CTRL;
         }
 
         void updateHdr() {
             if (cmdlist.command_count > 0)
-                set_and_get_next_offset(HDR_COM_CTRL, VAL_HDR_CTRL_ENABLE);
+                set(HDR_COM_CTRL, VAL_HDR_CTRL_ENABLE);
+        }
+    };
+
+private:
+    // backing store of all command lists, allocated once for mLayerCount layers
+    std::unique_ptr<g2d_reg[]> mArena;
+    std::array<CommandList, NUM_CMDLIST_BUFFERS> mCmdLists;
+    std::mutex mCmdListLock;
+
+    CommandList *acquireCommandList() {
+        std::lock_guard<std::mutex> lock(mCmdListLock);
+
+        for (auto &cmdlist : mCmdLists) {
+            if (!cmdlist.in_use) {
+                cmdlist.in_use = true;
+                return &cmdlist;
+            }
+        }
+
+        return nullptr;
+    }
+
+#ifdef G2D_HDR_VERIFY_COMMANDS
+    template <typename stageT, typename stageDataT>
+    static void writeReferenceStage(G2DHdrSfrModel &reference, const stageDataT &stage,
+                                    std::size_t layer) {
+        if (!stage.enable || stage.config == nullptr)
+            return;
+
+        HdrSegment segment;
+        stageT::update(segment, *stage.config, layer);
+
+        const uint32_t *values = segment.values.data();
+        for (auto &burst : segment.bursts)
+            for (uint32_t k = 0; k < burst.count; k++)
+                reference.write(burst.offset + k * sizeof(uint32_t), *values++);
+    }
+
+    // programs the SFRs for @layer straight from its stage data, with no caching or filtering
+    static void writeReference(G2DHdrSfrModel &reference, const IDpp &layer, std::size_t index,
+                               bool alpha_premultiplied, uint32_t modectl) {
+        writeReferenceStage<EotfStage>(reference, layer.EotfLut(), index);
+        writeReferenceStage<GmStage>(reference, layer.Gm(), index);
+        writeReferenceStage<DtmStage>(reference, layer.Dtm(), index);
+        writeReferenceStage<OetfStage>(reference, layer.OetfLut(), index);
+
+        reference.write(HDR_MOD_CTRL(index), modectl);
+        reference.write(HDR_COM_CTRL, VAL_HDR_CTRL_ENABLE);
+        reference.setLayerHdrMode(index, index | (alpha_premultiplied ? G2D_LAYER_HDRMODE_DEMULT_ALPHA : 0));
+    }
+
+    // checks that the SFRs programmed by @cmdlist convert pixels the same as @reference
+    bool verifyCommands(const G2DHdrSfrModel &reference, const g2d_commandlist &cmdlist) {
+        if (!mModel->apply(cmdlist)) {
+            ALOGE("HDR command list writes outside of the HDR SFRs");
+            return false;
         }
-    } mCmdList;
 
-    G2DHdrCommandWriter() { }
+        for (std::size_t layer = 0; layer < mLayerCount; layer++) {
+            if (!reference.hasLayer(layer))
+                continue;
+
+            for (uint32_t v = 0; v < 1024; v += 31) {
+                G2DHdrSfrModel::Pixel in = {v, 1023 - v, v / 2};
+                G2DHdrSfrModel::Pixel out = mModel->convert(layer, in);
+                G2DHdrSfrModel::Pixel expected = reference.convert(layer, in);
+                if (!(out == expected)) {
+                    ALOGE("HDR layer %zu converts (%u, %u, %u) to (%u, %u, %u) instead of (%u, %u, %u)",
+                          layer, in.r, in.g, in.b, out.r, out.g, out.b,
+                          expected.r, expected.g, expected.b);
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+#endif
+
+    bool isValidLayer(int index) {
+        if ((index >= 0) && (static_cast<std::size_t>(index) < mLayerCount))
+            return true;
+        ALOGE("HDR layer %d is out of %zu layers", index, mLayerCount);
+        return false;
+    }
+
+    bool releaseCommandList(struct g2d_commandlist *commands) {
+        std::lock_guard<std::mutex> lock(mCmdListLock);
+
+        for (auto &cmdlist : mCmdLists) {
+            if (cmdlist.get() == commands) {
+                if (!cmdlist.in_use)
+                    return false;
+                cmdlist.in_use = false;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+public:
+    explicit G2DHdrCommandWriter(std::size_t layer_count)
+          : mLayerCount(layer_count),
+            mLayerAlphaMap(layer_count),
+            mLayerData(layer_count, nullptr),
+            mLayerMetadata(layer_count, {HAL_DATASPACE_UNKNOWN, 0, 0, HAL_DATASPACE_UNKNOWN}),
+            mShadowRegs(layer_count) {
+        const std::size_t num_commands = numHdrCoefficients(layer_count);
+        const std::size_t num_regs = num_commands + numHdrModeRegs(layer_count);
+
+        mArena.reset(new g2d_reg[num_regs * NUM_CMDLIST_BUFFERS]);
+#ifdef G2D_HDR_VERIFY_COMMANDS
+        mModel.reset(new G2DHdrSfrModel(layer_count));
+#endif
+
+        g2d_reg *regs = mArena.get();
+        for (auto &cmdlist : mCmdLists) {
+            cmdlist.init(regs, regs + num_commands);
+            regs += num_regs;
+        }
+    }
+
     virtual ~G2DHdrCommandWriter() { }
 
-    virtual bool setLayerStaticMetadata(int __unused index, int __unused dataspace,
-                                unsigned int __unused min_luminance, unsigned int __unused max_luminance) override {
+    virtual bool setLayerStaticMetadata(int index, int dataspace,
+                                unsigned int min_luminance, unsigned int max_luminance) override {
+        if (!isValidLayer(index))
+            return false;
+        mLayerMetadata[index] = {dataspace, min_luminance, max_luminance, HAL_DATASPACE_UNKNOWN};
         return true;
     }
 
     virtual bool setLayerImageInfo(int index, unsigned int __unused pixfmt, bool alpha_premult) override {
+        if (!isValidLayer(index))
+            return false;
         if (alpha_premult)
-            mLayerAlphaMap.set(index);
+            mLayerAlphaMap[index] = true;
         return true;
     }
 
-    virtual bool setTargetInfo(int __unused dataspace, void * __unused data) override {
+    virtual bool setTargetInfo(int dataspace, void * __unused data) override {
+        if (!GeneratedDpp::isValidTarget(dataspace)) {
+            ALOGE("HDR target dataspace %#x has no standard or transfer", dataspace);
+            mTargetDataspace = HAL_DATASPACE_UNKNOWN;
+            return false;
+        }
+        mTargetDataspace = dataspace;
         return true;
     }
 
     virtual bool setLayerOpaqueData(int index, void *data, size_t __unused len) override {
-        mLayerData[index] = reinterpret_cast<displaycolor::IDisplayColorGS101::IDpp *>(data);
+        if (!isValidLayer(index))
+            return false;
+        mLayerData[index] = reinterpret_cast<IDpp *>(data);
         return true;
     }
 
-    virtual struct g2d_commandlist *getCommands() override {
-        mCmdList.reset();
+    virtual void setShadowRegisterMode(bool enable) override {
+        if (enable && !mShadowMode)
+            mShadowRegs.invalidate();
+        mShadowMode = enable;
+    }
 
-        unsigned int i = 0;
-        for (auto layer : mLayerData) {
-            if (layer) {
-                uint32_t modectl = 0;
+    virtual void invalidateShadowRegisters() override {
+        mShadowRegs.invalidate();
+    }
 
-                if (layer->EotfLut().enable && layer->EotfLut().config != nullptr) {
-                    mCmdList.updateDouble(layer->EotfLut().config->tf_data.posx, HDR_EOTF_POSX(i));
-                    mCmdList.updateSingle(layer->EotfLut().config->tf_data.posy, HDR_EOTF_POSY(i));
-                    modectl |= HDR_ENABLE_EOTF;
-                }
+    virtual bool setCommandFormats(unsigned int formats) override {
+        if (!(formats & (G2D_HDR_COMMAND_FORMAT_FLAT | G2D_HDR_COMMAND_FORMAT_BURST))) {
+            ALOGE("No HDR command format in %#x", formats);
+            return false;
+        }
+        mBurstFormat = !!(formats & G2D_HDR_COMMAND_FORMAT_BURST);
+        return true;
+    }
 
-                if (layer->Gm().enable && layer->Gm().config != nullptr) {
-                    mCmdList.updateSingle(layer->Gm().config->matrix_data.coeffs, HDR_GM_COEF(i));
-                    mCmdList.updateSingle(layer->Gm().config->matrix_data.offsets, HDR_GM_OFF(i));
-                    modectl |= HDR_ENABLE_GM;
-                }
+    virtual struct g2d_commandlist *getCommands() override {
+        CommandList *cmdlist = acquireCommandList();
+        if (!cmdlist) {
+            ALOGE("All %zu HDR command lists are in use", NUM_CMDLIST_BUFFERS);
+            return nullptr;
+        }
 
-                if (layer->Dtm().enable && layer->Dtm().config != nullptr) {
-                    mCmdList.updateTmCoef(*layer->Dtm().config, HDR_TM_COEF(i));
-                    mCmdList.updateDouble(layer->Dtm().config->tf_data.posx, HDR_TM_POSX(i));
-                    mCmdList.updateSingle(layer->Dtm().config->tf_data.posy, HDR_TM_POSY(i));
-                    modectl |= HDR_ENABLE_DTM;
-                }
+        auto start = std::chrono::steady_clock::now();
+
+        cmdlist->reset(mShadowMode ? &mShadowRegs : nullptr, mBurstFormat);
+#ifdef G2D_HDR_VERIFY_COMMANDS
+        G2DHdrSfrModel reference(mLayerCount);
+#endif
+
+        for (std::size_t i = 0; i < mLayerCount; i++) {
+            const IDpp *layer = mLayerData[i];
+#ifdef G2D_HDR_GENERATE_STAGES
+            // displaycolor did not configure this layer; generate the stages from its dataspace
+            std::shared_ptr<const GeneratedDpp> generated;
+            if (!layer && (mLayerMetadata[i].dataspace != HAL_DATASPACE_UNKNOWN)) {
+                mLayerMetadata[i].target_dataspace = mTargetDataspace;
+                if (mTargetDataspace == HAL_DATASPACE_UNKNOWN)
+                    ALOGE("No target dataspace to generate the HDR stages of layer %zu for", i);
+                generated = GeneratedDpp::get(mLayerMetadata[i]);
+                layer = generated.get();
+            }
+#endif
 
-                if (layer->OetfLut().enable && layer->OetfLut().config != nullptr) {
-                    mCmdList.updateDouble(layer->OetfLut().config->tf_data.posx, HDR_OETF_POSX(i));
-                    mCmdList.updateDouble(layer->OetfLut().config->tf_data.posy, HDR_OETF_POSY(i));
-                    modectl |= HDR_ENABLE_OETF;
-                }
+            if (layer) {
+                uint32_t modectl = 0;
 
-                mCmdList.updateLayer(i, mLayerAlphaMap[0], modectl);
-            }
+                modectl |= cmdlist->updateStage<EotfStage>(layer->EotfLut(), i);
+                modectl |= cmdlist->updateStage<GmStage>(layer->Gm(), i);
+                modectl |= cmdlist->updateStage<DtmStage>(layer->Dtm(), i);
+                modectl |= cmdlist->updateStage<OetfStage>(layer->OetfLut(), i);
 
-            mLayerAlphaMap >>= 1;
-            i++;
+                cmdlist->updateLayer(i, mLayerAlphaMap[i], modectl);
+                mStats.addLayer(modectl);
+#ifdef G2D_HDR_VERIFY_COMMANDS
+                writeReference(reference, *layer, i, mLayerAlphaMap[i], modectl);
+#endif
+            }
         }
 
-        mCmdList.updateHdr();
+        cmdlist->updateHdr();
+#ifdef G2D_HDR_VERIFY_COMMANDS
+        LOG_ALWAYS_FATAL_IF(!verifyCommands(reference, cmdlist->cmdlist),
+                            "HDR command list does not program the SFRs of its layers");
+#endif
 
         // initialize for the next layer metadata configuration
-        mLayerAlphaMap.reset();
-        mLayerData.fill(nullptr);
+        std::fill(mLayerAlphaMap.begin(), mLayerAlphaMap.end(), false);
+        std::fill(mLayerData.begin(), mLayerData.end(), nullptr);
+        for (auto &metadata : mLayerMetadata)
+            metadata.dataspace = HAL_DATASPACE_UNKNOWN;
 
-        return mCmdList.get();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        mStats.addJob(cmdlist->cmdlist, cmdlist->cache_hits,
+                      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+
+        return cmdlist->get();
+    }
+
+    virtual void dump(std::string &result) override {
+        mStats.dump(result);
     }
 
-    virtual void putCommands(struct g2d_commandlist __unused *commands) override {
-        assert(commands == &mCommandList);
+    // The command lists can be released in any order
+    virtual void putCommands(struct g2d_commandlist *commands) override {
+        if (!releaseCommandList(commands))
+            ALOGE("Unknown or already released HDR command list %p", commands);
     }
 };
 
+IG2DHdr10CommandWriterGS101 *IG2DHdr10CommandWriterGS101::createInstance(unsigned int layer_count) {
+    if (layer_count == 0) {
+        ALOGE("No HDR layer to write commands for");
+        return nullptr;
+    }
+
+    // the SFRs of more layers are not HDR SFRs
+    if (layer_count > G2D_HDR_MAX_LAYER_COUNT) {
+        ALOGE("%u HDR layers requested, the G2D has %u", layer_count, G2D_HDR_MAX_LAYER_COUNT);
+        return nullptr;
+    }
+
+    return new G2DHdrCommandWriter(layer_count);
+}
+
+int IG2DHdr10CommandWriterGS101::expandBurstCommands(const g2d_reg *commands, unsigned int count,
+                                                     g2d_reg *flat, unsigned int capacity) {
+    unsigned int flat_count = 0;
+
+    for (unsigned int i = 0; i < count; i++) {
+        if (!(commands[i].offset & G2D_HDR_BURST_FLAG)) {
+            if (flat_count == capacity) {
+                ALOGE("HDR commands do not fit in %u", capacity);
+                return -1;
+            }
+            flat[flat_count++] = commands[i];
+            continue;
+        }
+
+        uint32_t burst_count = commands[i].value;
+        uint32_t value_regs = (burst_count + 1) / 2;
+        if ((value_regs > count - i - 1) || (burst_count > capacity - flat_count)) {
+            ALOGE("HDR burst of %u SFRs at command %u does not fit", burst_count, i);
+            return -1;
+        }
+
+        expandBurst(&flat[flat_count], commands[i].offset & ~G2D_HDR_BURST_FLAG,
+                    reinterpret_cast<const uint32_t *>(&commands[i + 1]), burst_count);
+        flat_count += burst_count;
+        i += value_regs;
+    }
+
+    return static_cast<int>(flat_count);
+}
+
 IG2DHdr10CommandWriter *IG2DHdr10CommandWriter::createInstance() {
-    return new G2DHdrCommandWriter();
+    return IG2DHdr10CommandWriterGS101::createInstance(DEFAULT_LAYER_COUNT);
 }
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBACRYL_FAKE_DPP_H_
+#define LIBACRYL_FAKE_DPP_H_
+
+#include <cstdint>
+
+#include <gs101/displaycolor/displaycolor_gs101.h>
+
+/*
+ * IDpp with the stages of Stages enabled. The tables are filled in the
+ * register formats of g2d_hdr_sfr.h: monotonic curves whose shape depends
+ * on @seed, so fakes of different seeds have different tables.
+ */
+class FakeDpp : public displaycolor::IDisplayColorGS101::IDpp {
+public:
+    struct Stages {
+        bool eotf = true;
+        bool gm = true;
+        bool dtm = false;
+        bool oetf = true;
+    };
+
+    FakeDpp() : FakeDpp(Stages(), 0) {}
+    FakeDpp(const Stages &stages, uint32_t seed) {
+        for (std::size_t i = 0; i < EotfData::ConfigType::kLutLen; i++) {
+            mEotfConfig.tf_data.posx[i] = curve(i, EotfData::ConfigType::kLutLen, 1023, 0);
+            mEotfConfig.tf_data.posy[i] = curve(i, EotfData::ConfigType::kLutLen, 65535, seed);
+        }
+        for (std::size_t i = 0; i < mGmConfig.matrix_data.coeffs.size(); i++) {
+            // 19-bit two's complement with 16 fractional bits, around the identity
+            int32_t coeff = ((i % 4) == 0) ? 0x10000 : static_cast<int32_t>(seed % 64) - 32;
+            mGmConfig.matrix_data.coeffs[i] = static_cast<uint32_t>(coeff) & 0x7FFFF;
+        }
+        for (std::size_t i = 0; i < mGmConfig.matrix_data.offsets.size(); i++)
+            mGmConfig.matrix_data.offsets[i] = (seed + i) & 0xFF;
+        for (std::size_t i = 0; i < DtmData::ConfigType::kLutLen; i++) {
+            mDtmConfig.tf_data.posx[i] = curve(i, DtmData::ConfigType::kLutLen, 65535, 0);
+            mDtmConfig.tf_data.posy[i] = curve(i, DtmData::ConfigType::kLutLen, 65535 << 11, seed);
+        }
+        mDtmConfig.coeff_r = 269;
+        mDtmConfig.coeff_g = 694;
+        mDtmConfig.coeff_b = 61;
+        mDtmConfig.rng_x_min = 0;
+        mDtmConfig.rng_x_max = 65535;
+        mDtmConfig.rng_y_min = 0;
+        mDtmConfig.rng_y_max = 511;
+        for (std::size_t i = 0; i < OetfData::ConfigType::kLutLen; i++) {
+            mOetfConfig.tf_data.posx[i] = curve(i, OetfData::ConfigType::kLutLen, 65535, 0);
+            mOetfConfig.tf_data.posy[i] = curve(i, OetfData::ConfigType::kLutLen, 1023, seed);
+        }
+
+        set(mEotf, mEotfConfig, stages.eotf);
+        set(mGm, mGmConfig, stages.gm);
+        set(mDtm, mDtmConfig, stages.dtm);
+        set(mOetf, mOetfConfig, stages.oetf);
+    }
+    // the stages point to the configs of this object
+    FakeDpp(const FakeDpp &) = delete;
+    FakeDpp &operator=(const FakeDpp &) = delete;
+
+    const EotfData &EotfLut() const override { return mEotf; }
+    const GmData &Gm() const override { return mGm; }
+    const DtmData &Dtm() const override { return mDtm; }
+    const OetfData &OetfLut() const override { return mOetf; }
+
+    // for the tests to fill the tables with other data
+    EotfData::ConfigType &eotfConfig() { return mEotfConfig; }
+    GmData::ConfigType &gmConfig() { return mGmConfig; }
+    DtmData::ConfigType &dtmConfig() { return mDtmConfig; }
+    OetfData::ConfigType &oetfConfig() { return mOetfConfig; }
+
+private:
+    /* @i-th of @n points from 0 to @max, bent by @seed */
+    static uint32_t curve(std::size_t i, std::size_t n, uint32_t max, uint32_t seed) {
+        uint64_t x = static_cast<uint64_t>(i) * max / (n - 1);
+        uint64_t bend = seed % 64;
+        return static_cast<uint32_t>((x * (64 + bend) - x * x / (max ? max : 1) * bend) / 64);
+    }
+
+    template <typename stageT>
+    static void set(stageT &stage, const typename stageT::ConfigType &config, bool enable) {
+        stage.enable = enable;
+        stage.dirty = enable;
+        stage.config = &config;
+    }
+
+    EotfData::ConfigType mEotfConfig{};
+    GmData::ConfigType mGmConfig{};
+    DtmData::ConfigType mDtmConfig{};
+    OetfData::ConfigType mOetfConfig{};
+
+    EotfData mEotf;
+    GmData mGm;
+    DtmData mDtm;
+    OetfData mOetf;
+};
+
+#endif  // LIBACRYL_FAKE_DPP_H_
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include <gs101/libacryl_plugins/g2d_hdr_plugin_gs101.h>
+
+#include "FakeDpp.h"
+#include "g2d_hdr_sfr.h"
+#include "g2d_hdr_sfr_model.h"
+
+/*
+ * The burst format against the flat one. G2DHdrSfrModel stands in for the
+ * consumer of the command lists: it takes both formats, and the SFR values
+ * it ends up with are the register state a job programs.
+ */
+namespace {
+
+using Writer = std::unique_ptr<IG2DHdr10CommandWriterGS101>;
+
+Writer createWriter(unsigned int formats) {
+    Writer writer(IG2DHdr10CommandWriterGS101::createInstance(DEFAULT_LAYER_COUNT));
+    EXPECT_TRUE(writer->setCommandFormats(formats));
+    return writer;
+}
+
+/* The layers of a job: every combination of stages over the jobs */
+class Jobs {
+public:
+    explicit Jobs(std::size_t count) {
+        for (uint32_t job = 0; job < count; job++) {
+            for (uint32_t layer = 0; layer < DEFAULT_LAYER_COUNT; layer++) {
+                uint32_t bits = job * DEFAULT_LAYER_COUNT + layer;
+                FakeDpp::Stages stages;
+                stages.eotf = bits & 1;
+                stages.gm = bits & 2;
+                stages.dtm = bits & 4;
+                stages.oetf = bits & 8;
+                mDpps.push_back(std::make_unique<FakeDpp>(stages, job));
+            }
+        }
+    }
+
+    void set(IG2DHdr10CommandWriterGS101 &writer, std::size_t job) {
+        for (uint32_t layer = 0; layer < DEFAULT_LAYER_COUNT; layer++) {
+            // a layer without HDR every few jobs
+            if ((job + layer) % 5 == 4)
+                continue;
+            writer.setLayerOpaqueData(layer, dpp(job, layer), sizeof(FakeDpp));
+            writer.setLayerImageInfo(layer, 0, layer == job % DEFAULT_LAYER_COUNT);
+        }
+    }
+
+private:
+    FakeDpp *dpp(std::size_t job, uint32_t layer) {
+        return mDpps[(job % (mDpps.size() / DEFAULT_LAYER_COUNT)) * DEFAULT_LAYER_COUNT + layer]
+                .get();
+    }
+
+    std::vector<std::unique_ptr<FakeDpp>> mDpps;
+};
+
+bool hasBurst(const g2d_commandlist &cmdlist) {
+    for (uint32_t i = 0; i < cmdlist.command_count; i++) {
+        if (cmdlist.commands[i].offset & G2D_HDR_BURST_FLAG)
+            return true;
+    }
+    return false;
+}
+
+TEST(HdrCommandFormatTest, BurstsOnlyIfTheConsumerAcceptsThem) {
+    FakeDpp dpp;
+    Writer writer(IG2DHdr10CommandWriterGS101::createInstance(DEFAULT_LAYER_COUNT));
+    auto commands = [&]() {
+        writer->setLayerOpaqueData(0, &dpp, sizeof(dpp));
+        g2d_commandlist *cmdlist = writer->getCommands();
+        EXPECT_NE(cmdlist, nullptr);
+        std::vector<g2d_reg> regs(cmdlist->commands, cmdlist->commands + cmdlist->command_count);
+        writer->putCommands(cmdlist);
+        return regs;
+    };
+
+    // flat by default
+    std::vector<g2d_reg> flat = commands();
+    g2d_commandlist flatList{static_cast<uint32_t>(flat.size()), 0, flat.data(), nullptr};
+    EXPECT_FALSE(hasBurst(flatList));
+
+    EXPECT_FALSE(writer->setCommandFormats(0));
+    EXPECT_EQ(commands().size(), flat.size());
+
+    ASSERT_TRUE(writer->setCommandFormats(G2D_HDR_COMMAND_FORMAT_FLAT |
+                                          G2D_HDR_COMMAND_FORMAT_BURST));
+    std::vector<g2d_reg> burst = commands();
+    g2d_commandlist burstList{static_cast<uint32_t>(burst.size()), 0, burst.data(), nullptr};
+    EXPECT_TRUE(hasBurst(burstList));
+    // about half the size
+    EXPECT_LT(burst.size(), flat.size() * 6 / 10);
+
+    ASSERT_TRUE(writer->setCommandFormats(G2D_HDR_COMMAND_FORMAT_FLAT));
+    EXPECT_EQ(commands().size(), flat.size());
+}
+
+// With and without the shadow register mode
+TEST(HdrCommandFormatTest, BothFormatsProgramTheSameSfrs) {
+    for (bool shadow : {false, true}) {
+        Jobs jobs(8);
+        Writer flat = createWriter(G2D_HDR_COMMAND_FORMAT_FLAT);
+        Writer burst = createWriter(G2D_HDR_COMMAND_FORMAT_BURST);
+        flat->setShadowRegisterMode(shadow);
+        burst->setShadowRegisterMode(shadow);
+        G2DHdrSfrModel flatSfrs(DEFAULT_LAYER_COUNT);
+        G2DHdrSfrModel burstSfrs(DEFAULT_LAYER_COUNT);
+
+        for (std::size_t job = 0; job < 40; job++) {
+            jobs.set(*flat, job);
+            jobs.set(*burst, job);
+            g2d_commandlist *flatList = flat->getCommands();
+            g2d_commandlist *burstList = burst->getCommands();
+            ASSERT_NE(flatList, nullptr);
+            ASSERT_NE(burstList, nullptr);
+            EXPECT_FALSE(hasBurst(*flatList));
+            EXPECT_LE(burstList->command_count, flatList->command_count);
+
+            ASSERT_TRUE(flatSfrs.apply(*flatList));
+            ASSERT_TRUE(burstSfrs.apply(*burstList));
+            ASSERT_TRUE(flatSfrs == burstSfrs) << "job " << job << " shadow " << shadow;
+
+            flat->putCommands(flatList);
+            burst->putCommands(burstList);
+        }
+    }
+}
+
+TEST(HdrCommandFormatTest, ExpandedBurstsAreTheFlatCommands) {
+    Jobs jobs(8);
+    Writer flat = createWriter(G2D_HDR_COMMAND_FORMAT_FLAT);
+    Writer burst = createWriter(G2D_HDR_COMMAND_FORMAT_FLAT | G2D_HDR_COMMAND_FORMAT_BURST);
+
+    for (std::size_t job = 0; job < 16; job++) {
+        jobs.set(*flat, job);
+        jobs.set(*burst, job);
+        g2d_commandlist *flatList = flat->getCommands();
+        g2d_commandlist *burstList = burst->getCommands();
+        ASSERT_NE(flatList, nullptr);
+        ASSERT_NE(burstList, nullptr);
+
+        std::vector<g2d_reg> expanded(flatList->command_count);
+        ASSERT_EQ(IG2DHdr10CommandWriterGS101::expandBurstCommands(
+                          burstList->commands, burstList->command_count, expanded.data(),
+                          expanded.size()),
+                  static_cast<int>(flatList->command_count));
+        for (uint32_t i = 0; i < flatList->command_count; i++) {
+            ASSERT_EQ(expanded[i].offset, flatList->commands[i].offset) << "command " << i;
+            ASSERT_EQ(expanded[i].value, flatList->commands[i].value) << "command " << i;
+        }
+
+        flat->putCommands(flatList);
+        burst->putCommands(burstList);
+    }
+}
+
+TEST(HdrCommandFormatTest, ExpandRejectsWhatDoesNotFit) {
+    FakeDpp dpp;
+    Writer writer = createWriter(G2D_HDR_COMMAND_FORMAT_BURST);
+    writer->setLayerOpaqueData(0, &dpp, sizeof(dpp));
+    g2d_commandlist *cmdlist = writer->getCommands();
+    ASSERT_NE(cmdlist, nullptr);
+
+    std::vector<g2d_reg> flat(HDR_LAYER_SFR_COUNT + 1);
+    int count = IG2DHdr10CommandWriterGS101::expandBurstCommands(
+            cmdlist->commands, cmdlist->command_count, flat.data(), flat.size());
+    ASSERT_GT(count, 0);
+
+    // one g2d_reg short
+    EXPECT_EQ(IG2DHdr10CommandWriterGS101::expandBurstCommands(
+                      cmdlist->commands, cmdlist->command_count, flat.data(), count - 1),
+              -1);
+    // the values of the first burst cut
+    ASSERT_TRUE(cmdlist->commands[0].offset & G2D_HDR_BURST_FLAG);
+    EXPECT_EQ(IG2DHdr10CommandWriterGS101::expandBurstCommands(cmdlist->commands, 2,
+                                                               flat.data(), flat.size()),
+              -1);
+    writer->putCommands(cmdlist);
+}
+
+}  // namespace
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include <gs101/libacryl_plugins/g2d_hdr_plugin_gs101.h>
+
+#include "FakeDpp.h"
+#include "g2d_hdr_sfr.h"
+
+/*
+ * The command lists of getCommands() stay valid until putCommands(), while
+ * the next jobs are built into the other lists of the writer.
+ */
+namespace {
+
+using Writer = std::unique_ptr<IG2DHdr10CommandWriterGS101>;
+
+class HdrCommandListRingTest : public ::testing::Test {
+protected:
+    HdrCommandListRingTest()
+          : mWriter(IG2DHdr10CommandWriterGS101::createInstance(DEFAULT_LAYER_COUNT)) {
+        FakeDpp::Stages stages;
+        for (uint32_t seed = 0; seed < 8; seed++) {
+            stages.dtm = seed % 2;
+            mDpps.push_back(std::make_unique<FakeDpp>(stages, seed));
+        }
+    }
+
+    // a job of the layers of @seed
+    g2d_commandlist *getCommands(uint32_t seed) {
+        for (uint32_t layer = 0; layer < 1 + seed % DEFAULT_LAYER_COUNT; layer++)
+            mWriter->setLayerOpaqueData(layer, mDpps[(seed + layer) % mDpps.size()].get(),
+                                        sizeof(FakeDpp));
+        return mWriter->getCommands();
+    }
+
+    // takes command lists until there is none left
+    std::vector<g2d_commandlist *> getAll() {
+        std::vector<g2d_commandlist *> cmdlists;
+        while (g2d_commandlist *cmdlist = getCommands(cmdlists.size())) {
+            cmdlists.push_back(cmdlist);
+            if (cmdlists.size() > 64)
+                break;
+        }
+        return cmdlists;
+    }
+
+    static std::vector<g2d_reg> copy(const g2d_commandlist &cmdlist) {
+        return std::vector<g2d_reg>(cmdlist.commands, cmdlist.commands + cmdlist.command_count);
+    }
+
+    static bool equal(const g2d_commandlist &cmdlist, const std::vector<g2d_reg> &regs) {
+        return (cmdlist.command_count == regs.size()) &&
+               std::equal(regs.begin(), regs.end(), cmdlist.commands,
+                          [](const g2d_reg &a, const g2d_reg &b) {
+                              return (a.offset == b.offset) && (a.value == b.value);
+                          });
+    }
+
+    Writer mWriter;
+    std::vector<std::unique_ptr<FakeDpp>> mDpps;
+};
+
+TEST_F(HdrCommandListRingTest, ReleasedListsAreReused) {
+    g2d_commandlist *first = getCommands(0);
+    ASSERT_NE(first, nullptr);
+    mWriter->putCommands(first);
+
+    std::set<g2d_commandlist *> seen;
+    for (uint32_t job = 0; job < 100; job++) {
+        g2d_commandlist *cmdlist = getCommands(job);
+        ASSERT_NE(cmdlist, nullptr) << "job " << job;
+        seen.insert(cmdlist);
+        mWriter->putCommands(cmdlist);
+    }
+    // one list at a time is enough
+    EXPECT_EQ(seen.size(), 1u);
+    EXPECT_EQ(*seen.begin(), first);
+}
+
+TEST_F(HdrCommandListRingTest, ListsInFlightAreNotOverwritten) {
+    std::vector<g2d_commandlist *> cmdlists = getAll();
+    ASSERT_GE(cmdlists.size(), 2u);
+
+    // every list is distinct, with its own buffers
+    std::set<g2d_commandlist *> lists(cmdlists.begin(), cmdlists.end());
+    std::set<g2d_reg *> buffers;
+    for (auto cmdlist : cmdlists)
+        buffers.insert(cmdlist->commands);
+    EXPECT_EQ(lists.size(), cmdlists.size());
+    EXPECT_EQ(buffers.size(), cmdlists.size());
+
+    // the jobs built after the first do not touch it
+    mWriter->putCommands(cmdlists.back());
+    std::vector<g2d_reg> held = copy(*cmdlists.front());
+    for (uint32_t job = 0; job < 10; job++) {
+        g2d_commandlist *cmdlist = getCommands(job + 3);
+        ASSERT_NE(cmdlist, nullptr);
+        ASSERT_NE(cmdlist, cmdlists.front());
+        mWriter->putCommands(cmdlist);
+        EXPECT_TRUE(equal(*cmdlists.front(), held)) << "job " << job;
+    }
+
+    for (std::size_t i = 0; i + 1 < cmdlists.size(); i++)
+        mWriter->putCommands(cmdlists[i]);
+}
+
+TEST_F(HdrCommandListRingTest, ExhaustionRecoversOnRelease) {
+    std::vector<g2d_commandlist *> cmdlists = getAll();
+    ASSERT_GE(cmdlists.size(), 2u);
+    ASSERT_LE(cmdlists.size(), 64u);
+
+    // no list is left, again and again
+    for (int i = 0; i < 3; i++)
+        EXPECT_EQ(getCommands(i), nullptr);
+
+    mWriter->putCommands(cmdlists[0]);
+    g2d_commandlist *cmdlist = getCommands(0);
+    EXPECT_EQ(cmdlist, cmdlists[0]);
+    EXPECT_EQ(getCommands(1), nullptr);
+
+    for (auto list : cmdlists)
+        mWriter->putCommands(list);
+    EXPECT_EQ(getAll().size(), cmdlists.size());
+}
+
+TEST_F(HdrCommandListRingTest, ReleaseInAnyOrder) {
+    std::vector<g2d_commandlist *> cmdlists = getAll();
+    ASSERT_GE(cmdlists.size(), 2u);
+
+    std::vector<std::vector<g2d_reg>> held;
+    for (auto cmdlist : cmdlists)
+        held.push_back(copy(*cmdlist));
+
+    // the last taken first: the others keep their commands
+    mWriter->putCommands(cmdlists.back());
+    for (std::size_t i = 0; i + 1 < cmdlists.size(); i++)
+        EXPECT_TRUE(equal(*cmdlists[i], held[i])) << "list " << i;
+
+    // and the list released is the one handed out next
+    g2d_commandlist *cmdlist = getCommands(0);
+    EXPECT_EQ(cmdlist, cmdlists.back());
+
+    // the first taken, then the one in the middle
+    mWriter->putCommands(cmdlists.front());
+    if (cmdlists.size() > 2)
+        mWriter->putCommands(cmdlists[1]);
+    std::set<g2d_commandlist *> next;
+    while (g2d_commandlist *list = getCommands(1))
+        next.insert(list);
+    std::set<g2d_commandlist *> released = {cmdlists.front()};
+    if (cmdlists.size() > 2)
+        released.insert(cmdlists[1]);
+    EXPECT_EQ(next, released);
+}
+
+TEST_F(HdrCommandListRingTest, UnknownAndDoubleReleasesAreIgnored) {
+    g2d_commandlist *cmdlist = getCommands(0);
+    ASSERT_NE(cmdlist, nullptr);
+    mWriter->putCommands(cmdlist);
+    // already released
+    mWriter->putCommands(cmdlist);
+    // not from this writer
+    g2d_commandlist other{};
+    mWriter->putCommands(&other);
+    mWriter->putCommands(nullptr);
+
+    // every list is handed out once
+    std::vector<g2d_commandlist *> cmdlists = getAll();
+    std::set<g2d_commandlist *> lists(cmdlists.begin(), cmdlists.end());
+    EXPECT_EQ(lists.size(), cmdlists.size());
+    EXPECT_GE(cmdlists.size(), 2u);
+}
+
+}  // namespace
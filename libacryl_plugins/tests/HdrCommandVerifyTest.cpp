@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include <gs101/libacryl_plugins/g2d_hdr_plugin_gs101.h>
+#include <system/graphics.h>
+
+#include "FakeDpp.h"
+#include "g2d_hdr_sfr.h"
+#include "g2d_hdr_sfr_model.h"
+
+/*
+ * Built with G2D_HDR_VERIFY_COMMANDS: getCommands() applies every command
+ * list to its G2DHdrSfrModel and aborts if the SFRs do not convert pixels
+ * the same as the stage data of the layers programmed directly.
+ *
+ * On top of that, the pixels of the command lists of an optimized writer
+ * (cache, shadow register mode, burst format) are compared with those of
+ * a writer that programs every SFR of every job in the flat format.
+ */
+#ifndef G2D_HDR_VERIFY_COMMANDS
+#error "libacryl_hdr_plugin_verify_test needs the command verification of the writer"
+#endif
+
+namespace {
+
+using Writer = std::unique_ptr<IG2DHdr10CommandWriterGS101>;
+
+Writer createWriter(bool shadow, unsigned int formats) {
+    Writer writer(IG2DHdr10CommandWriterGS101::createInstance(DEFAULT_LAYER_COUNT));
+    writer->setShadowRegisterMode(shadow);
+    writer->setCommandFormats(formats);
+    return writer;
+}
+
+/* A writer and the SFRs its command lists leave, as if G2D ran every job */
+struct Device {
+    Writer writer;
+    G2DHdrSfrModel sfrs{DEFAULT_LAYER_COUNT};
+
+    Device(bool shadow, unsigned int formats) : writer(createWriter(shadow, formats)) {}
+
+    void run() {
+        g2d_commandlist *cmdlist = writer->getCommands();
+        ASSERT_NE(cmdlist, nullptr);
+        EXPECT_TRUE(sfrs.apply(*cmdlist));
+        writer->putCommands(cmdlist);
+    }
+};
+
+class HdrCommandVerifyTest : public ::testing::Test {
+protected:
+    HdrCommandVerifyTest() {
+        // every combination of stages, in two shapes of tables
+        for (uint32_t bits = 0; bits < 32; bits++) {
+            FakeDpp::Stages stages;
+            stages.eotf = bits & 1;
+            stages.gm = bits & 2;
+            stages.dtm = bits & 4;
+            stages.oetf = bits & 8;
+            mDpps.push_back(std::make_unique<FakeDpp>(stages, bits * 7));
+        }
+    }
+
+    // sets the layers of @job to @writer: displaycolor layers, generated ones and none
+    void setJob(IG2DHdr10CommandWriterGS101 &writer, uint32_t job) {
+        writer.setTargetInfo(HAL_DATASPACE_STANDARD_DCI_P3 | HAL_DATASPACE_TRANSFER_SRGB, nullptr);
+        for (uint32_t layer = 0; layer < DEFAULT_LAYER_COUNT; layer++) {
+            uint32_t kind = (job * 5 + layer * 3) % 8;
+            if (kind == 0)
+                continue;
+            if (kind == 1) {
+                int transfer = (job % 2) ? HAL_DATASPACE_TRANSFER_ST2084 : HAL_DATASPACE_TRANSFER_HLG;
+                writer.setLayerStaticMetadata(layer, HAL_DATASPACE_STANDARD_BT2020 | transfer, 50,
+                                              1000 + job % 3 * 1000);
+            } else {
+                FakeDpp *dpp = mDpps[(job * 3 + layer * 11) % mDpps.size()].get();
+                writer.setLayerOpaqueData(layer, dpp, sizeof(*dpp));
+            }
+            writer.setLayerImageInfo(layer, 0, (job + layer) % 3 == 0);
+        }
+    }
+
+    // the HDR layers of the last job of @device convert as in @reference
+    static void expectSamePixels(const Device &device, const Device &reference, uint32_t job) {
+        for (std::size_t layer = 0; layer < DEFAULT_LAYER_COUNT; layer++) {
+            if (!reference.sfrs.hasLayer(layer))
+                continue;
+            for (uint32_t v = 0; v < 1024; v += 61) {
+                G2DHdrSfrModel::Pixel in = {v, (v * 7) % 1024, 1023 - v};
+                G2DHdrSfrModel::Pixel out = device.sfrs.convert(layer, in);
+                G2DHdrSfrModel::Pixel expected = reference.sfrs.convert(layer, in);
+                ASSERT_TRUE(out == expected) << "job " << job << " layer " << layer << " in "
+                                             << in.r << "," << in.g << "," << in.b;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<FakeDpp>> mDpps;
+};
+
+TEST_F(HdrCommandVerifyTest, OptimizedListsConvertAsFullLists) {
+    const struct {
+        bool shadow;
+        unsigned int formats;
+    } configs[] = {
+            {false, G2D_HDR_COMMAND_FORMAT_FLAT},
+            {false, G2D_HDR_COMMAND_FORMAT_BURST},
+            {true, G2D_HDR_COMMAND_FORMAT_FLAT},
+            {true, G2D_HDR_COMMAND_FORMAT_FLAT | G2D_HDR_COMMAND_FORMAT_BURST},
+    };
+
+    for (const auto &config : configs) {
+        SCOPED_TRACE(testing::Message() << "shadow " << config.shadow << " formats "
+                                        << config.formats);
+        Device device(config.shadow, config.formats);
+        for (uint32_t job = 0; job < 200; job++) {
+            // the reference starts from reset SFRs and programs the whole job
+            Device reference(false, G2D_HDR_COMMAND_FORMAT_FLAT);
+            setJob(*device.writer, job);
+            setJob(*reference.writer, job);
+            ASSERT_NO_FATAL_FAILURE(device.run());
+            ASSERT_NO_FATAL_FAILURE(reference.run());
+            ASSERT_NO_FATAL_FAILURE(expectSamePixels(device, reference, job));
+        }
+    }
+}
+
+// The shadow registers are forgotten, e.g. on a G2D reset: the SFRs start over
+TEST_F(HdrCommandVerifyTest, InvalidatedShadowRegistersAreProgrammedAgain) {
+    Device device(true, G2D_HDR_COMMAND_FORMAT_BURST);
+    for (uint32_t job = 0; job < 60; job++) {
+        if (job % 7 == 6) {
+            device.writer->invalidateShadowRegisters();
+            device.sfrs = G2DHdrSfrModel(DEFAULT_LAYER_COUNT);
+        }
+        Device reference(false, G2D_HDR_COMMAND_FORMAT_FLAT);
+        setJob(*device.writer, job);
+        setJob(*reference.writer, job);
+        ASSERT_NO_FATAL_FAILURE(device.run());
+        ASSERT_NO_FATAL_FAILURE(reference.run());
+        ASSERT_NO_FATAL_FAILURE(expectSamePixels(device, reference, job));
+    }
+}
+
+}  // namespace
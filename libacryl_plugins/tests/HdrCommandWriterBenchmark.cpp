@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+#include <gs101/libacryl_plugins/g2d_hdr_plugin_gs101.h>
+
+#include "FakeDpp.h"
+#include "g2d_hdr_sfr.h"
+
+/*
+ * Cost of a G2D job in G2DHdrCommandWriter: the layers are set and the
+ * command list is built by getCommands() and released by putCommands().
+ *
+ * The time is per job. Reported per job: commands (HDR SFR writes) and
+ * bytes (the g2d_reg of the commands and of the layer HDR modes).
+ */
+
+namespace {
+
+/*
+ * Runs jobs of @layers layers in a loop. The jobs take turns over
+ * @tables_per_layer sets of tables per layer; with more sets than the
+ * writer caches, the tables are never found in its cache.
+ */
+void run(benchmark::State &state, std::size_t layers, const FakeDpp::Stages &stages,
+         bool premultiplied, bool shadow, uint32_t tables_per_layer,
+         unsigned int formats = G2D_HDR_COMMAND_FORMAT_FLAT) {
+    std::unique_ptr<IG2DHdr10CommandWriterGS101> writer(
+            IG2DHdr10CommandWriterGS101::createInstance(DEFAULT_LAYER_COUNT));
+    writer->setShadowRegisterMode(shadow);
+    writer->setCommandFormats(formats);
+
+    std::vector<std::unique_ptr<FakeDpp>> dpps;
+    for (uint32_t i = 0; i < layers * tables_per_layer; i++)
+        dpps.push_back(std::make_unique<FakeDpp>(stages, i));
+
+    uint64_t job = 0;
+    uint64_t commands = 0;
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < layers; i++) {
+            FakeDpp &dpp = *dpps[(job % tables_per_layer) * layers + i];
+            writer->setLayerOpaqueData(i, &dpp, sizeof(dpp));
+            writer->setLayerImageInfo(i, 0, premultiplied);
+        }
+
+        g2d_commandlist *cmdlist = writer->getCommands();
+        if (!cmdlist) {
+            state.SkipWithError("no command list");
+            break;
+        }
+        commands += cmdlist->command_count;
+        bytes += (cmdlist->command_count + cmdlist->layer_count) * sizeof(g2d_reg);
+        writer->putCommands(cmdlist);
+        job++;
+    }
+
+    state.counters["commands"] =
+            benchmark::Counter(static_cast<double>(commands), benchmark::Counter::kAvgIterations);
+    state.counters["bytes"] =
+            benchmark::Counter(static_cast<double>(bytes), benchmark::Counter::kAvgIterations);
+}
+
+FakeDpp::Stages stagesOf(const benchmark::State &state) {
+    FakeDpp::Stages stages;
+    stages.dtm = state.range(1);
+    return stages;
+}
+
+// Args: layers, DTM, premultiplied alpha
+void BM_GetCommands(benchmark::State &state) {
+    run(state, state.range(0), stagesOf(state), state.range(2), false, 1);
+}
+BENCHMARK(BM_GetCommands)->ArgsProduct({{1, 2, 3, 4}, {0, 1}, {0, 1}});
+
+// The consumer accepts the burst format
+void BM_GetCommandsBurst(benchmark::State &state) {
+    run(state, state.range(0), stagesOf(state), false, false, 1,
+        G2D_HDR_COMMAND_FORMAT_FLAT | G2D_HDR_COMMAND_FORMAT_BURST);
+}
+BENCHMARK(BM_GetCommandsBurst)->ArgsProduct({{1, 2, 3, 4}, {0, 1}});
+
+// Tables changing every job, as in HDR10+ video: every stage misses the cache
+void BM_GetCommandsUncached(benchmark::State &state) {
+    run(state, state.range(0), stagesOf(state), false, false, 16);
+}
+BENCHMARK(BM_GetCommandsUncached)->ArgsProduct({{1, 2, 3, 4}, {0, 1}});
+
+// Same tables every job in the shadow register mode: only the controls are written
+void BM_GetCommandsShadow(benchmark::State &state) {
+    run(state, state.range(0), stagesOf(state), false, true, 1);
+}
+BENCHMARK(BM_GetCommandsShadow)->ArgsProduct({{1, 2, 3, 4}, {0, 1}});
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <gs101/libacryl_plugins/g2d_hdr_plugin_gs101.h>
+#include <system/graphics.h>
+
+#include "FakeDpp.h"
+#include "g2d_hdr_sfr.h"
+
+namespace {
+
+using Writer = std::unique_ptr<IG2DHdr10CommandWriterGS101>;
+
+Writer createWriter() {
+    return Writer(IG2DHdr10CommandWriterGS101::createInstance(DEFAULT_LAYER_COUNT));
+}
+
+/*
+ * The scalar encoder of the writer before the vector kernels: one g2d_reg
+ * per SFR, in the order of the stages.
+ */
+class ScalarEncoder {
+public:
+    std::vector<g2d_reg> commands;
+
+    // two entries per SFR from LSB, the last SFR holds one if the length is odd
+    template <typename containerT>
+    void addDouble(const containerT &container, uint32_t offset) {
+        for (std::size_t n = 0; n < container.size(); n += 2) {
+            uint32_t value = container[n];
+            if (n + 1 < container.size())
+                value |= static_cast<uint32_t>(container[n + 1]) << 16;
+            add(offset, value);
+            offset += sizeof(uint32_t);
+        }
+    }
+
+    template <typename containerT>
+    void addSingle(const containerT &container, uint32_t offset) {
+        for (auto value : container) {
+            add(offset, value);
+            offset += sizeof(uint32_t);
+        }
+    }
+
+    void addLayer(const FakeDpp &dpp, std::size_t layer) {
+        uint32_t modectl = 0;
+        if (dpp.EotfLut().enable) {
+            addDouble(dpp.EotfLut().config->tf_data.posx, HDR_EOTF_POSX(layer));
+            addSingle(dpp.EotfLut().config->tf_data.posy, HDR_EOTF_POSY(layer));
+            modectl |= HDR_ENABLE_EOTF;
+        }
+        if (dpp.Gm().enable) {
+            addSingle(dpp.Gm().config->matrix_data.coeffs, HDR_GM_COEF(layer));
+            addSingle(dpp.Gm().config->matrix_data.offsets, HDR_GM_OFF(layer));
+            modectl |= HDR_ENABLE_GM;
+        }
+        if (dpp.Dtm().enable) {
+            const auto &config = *dpp.Dtm().config;
+            add(HDR_TM_COEF(layer), config.coeff_r | (config.coeff_g << 10) |
+                                            (static_cast<uint32_t>(config.coeff_b) << 20));
+            add(HDR_TM_RNGX(layer),
+                config.rng_x_min | (static_cast<uint32_t>(config.rng_x_max) << 16));
+            add(HDR_TM_RNGY(layer),
+                config.rng_y_min | (static_cast<uint32_t>(config.rng_y_max) << 16));
+            addDouble(config.tf_data.posx, HDR_TM_POSX(layer));
+            addSingle(config.tf_data.posy, HDR_TM_POSY(layer));
+            modectl |= HDR_ENABLE_DTM;
+        }
+        if (dpp.OetfLut().enable) {
+            addDouble(dpp.OetfLut().config->tf_data.posx, HDR_OETF_POSX(layer));
+            addDouble(dpp.OetfLut().config->tf_data.posy, HDR_OETF_POSY(layer));
+            modectl |= HDR_ENABLE_OETF;
+        }
+        add(HDR_MOD_CTRL(layer), modectl);
+    }
+
+    void addHdr() { add(HDR_COM_CTRL, VAL_HDR_CTRL_ENABLE); }
+
+private:
+    void add(uint32_t offset, uint32_t value) { commands.push_back({offset, value}); }
+};
+
+/* Fills the tables of @dpp with random values of the full width of their types */
+void randomize(FakeDpp &dpp, std::mt19937 &random) {
+    auto fill = [&random](auto &container) {
+        using T = typename std::remove_reference_t<decltype(container)>::value_type;
+        std::uniform_int_distribution<uint32_t> values(0, static_cast<T>(~T(0)));
+        for (auto &value : container)
+            value = static_cast<T>(values(random));
+    };
+    fill(dpp.eotfConfig().tf_data.posx);
+    fill(dpp.eotfConfig().tf_data.posy);
+    fill(dpp.gmConfig().matrix_data.coeffs);
+    fill(dpp.gmConfig().matrix_data.offsets);
+    fill(dpp.dtmConfig().tf_data.posx);
+    fill(dpp.dtmConfig().tf_data.posy);
+    fill(dpp.oetfConfig().tf_data.posx);
+    fill(dpp.oetfConfig().tf_data.posy);
+
+    auto &dtm = dpp.dtmConfig();
+    dtm.coeff_r = random() & 0x3FF;
+    dtm.coeff_g = random() & 0x3FF;
+    dtm.coeff_b = random() & 0x3FF;
+    dtm.rng_x_min = random();
+    dtm.rng_x_max = random();
+    dtm.rng_y_min = random() & 0x1FF;
+    dtm.rng_y_max = random() & 0x1FF;
+}
+
+void expectCommands(const g2d_commandlist &cmdlist, const std::vector<g2d_reg> &expected) {
+    ASSERT_EQ(cmdlist.command_count, expected.size());
+    for (std::size_t i = 0; i < expected.size(); i++) {
+        ASSERT_EQ(cmdlist.commands[i].offset, expected[i].offset) << "command " << i;
+        ASSERT_EQ(cmdlist.commands[i].value, expected[i].value)
+                << "command " << i << " at " << std::hex << expected[i].offset;
+    }
+}
+
+// One stage at a time and all of them, on every layer: built, then from the cache
+TEST(HdrCommandWriterTest, PackingIsBitIdenticalToScalar) {
+    const FakeDpp::Stages stageSets[] = {
+            {true, false, false, false}, {false, true, false, false},
+            {false, false, true, false}, {false, false, false, true},
+            {true, true, true, true},
+    };
+    std::mt19937 random(20210601);
+    Writer writer = createWriter();
+
+    for (const auto &stages : stageSets) {
+        for (std::size_t layer = 0; layer < DEFAULT_LAYER_COUNT; layer++) {
+            FakeDpp dpp(stages, 0);
+            randomize(dpp, random);
+
+            ScalarEncoder expected;
+            expected.addLayer(dpp, layer);
+            expected.addHdr();
+
+            for (int job = 0; job < 2; job++) {
+                writer->setLayerOpaqueData(layer, &dpp, sizeof(dpp));
+                g2d_commandlist *cmdlist = writer->getCommands();
+                ASSERT_NE(cmdlist, nullptr);
+                expectCommands(*cmdlist, expected.commands);
+                writer->putCommands(cmdlist);
+            }
+        }
+    }
+}
+
+TEST(HdrCommandWriterTest, LayersAreEncodedInOrder) {
+    std::mt19937 random(7);
+    std::vector<std::unique_ptr<FakeDpp>> dpps;
+    ScalarEncoder expected;
+    Writer writer = createWriter();
+
+    for (std::size_t layer = 0; layer < DEFAULT_LAYER_COUNT; layer++) {
+        FakeDpp::Stages stages;
+        stages.dtm = (layer % 2) == 1;
+        dpps.push_back(std::make_unique<FakeDpp>(stages, layer));
+        randomize(*dpps.back(), random);
+        expected.addLayer(*dpps.back(), layer);
+        writer->setLayerOpaqueData(layer, dpps.back().get(), sizeof(FakeDpp));
+        writer->setLayerImageInfo(layer, 0, layer == 2);
+    }
+    expected.addHdr();
+
+    g2d_commandlist *cmdlist = writer->getCommands();
+    ASSERT_NE(cmdlist, nullptr);
+    expectCommands(*cmdlist, expected.commands);
+
+    ASSERT_EQ(cmdlist->layer_count, DEFAULT_LAYER_COUNT);
+    for (uint32_t layer = 0; layer < DEFAULT_LAYER_COUNT; layer++) {
+        EXPECT_EQ(cmdlist->layer_hdr_mode[layer].offset,
+                  static_cast<uint32_t>(G2D_LAYER_HDRMODE(layer)));
+        EXPECT_EQ(cmdlist->layer_hdr_mode[layer].value,
+                  layer | (layer == 2 ? G2D_LAYER_HDRMODE_DEMULT_ALPHA : 0));
+    }
+    writer->putCommands(cmdlist);
+}
+
+// The HDR SFRs of the layers past G2D_HDR_MAX_LAYER_COUNT are other SFRs
+TEST(HdrCommandWriterTest, LayerCountIsBoundBySfrLayout) {
+    EXPECT_EQ(IG2DHdr10CommandWriterGS101::createInstance(0), nullptr);
+    EXPECT_EQ(IG2DHdr10CommandWriterGS101::createInstance(G2D_HDR_MAX_LAYER_COUNT + 1), nullptr);
+    EXPECT_EQ(IG2DHdr10CommandWriterGS101::createInstance(~0U), nullptr);
+
+    for (unsigned int layer_count = 1; layer_count <= G2D_HDR_MAX_LAYER_COUNT; layer_count++) {
+        Writer writer(IG2DHdr10CommandWriterGS101::createInstance(layer_count));
+        ASSERT_NE(writer, nullptr);
+
+        // the layers past the count are rejected
+        FakeDpp dpp;
+        for (unsigned int layer = 0; layer < layer_count; layer++)
+            EXPECT_TRUE(writer->setLayerOpaqueData(layer, &dpp, sizeof(dpp)));
+        EXPECT_FALSE(writer->setLayerOpaqueData(layer_count, &dpp, sizeof(dpp)));
+
+        g2d_commandlist *cmdlist = writer->getCommands();
+        ASSERT_NE(cmdlist, nullptr);
+        EXPECT_EQ(cmdlist->layer_count, layer_count);
+        const uint32_t end = HDR_LAYER_BASE(layer_count);
+        for (uint32_t i = 0; i < cmdlist->command_count; i++)
+            EXPECT_LT(cmdlist->commands[i].offset, end) << "command " << i;
+        writer->putCommands(cmdlist);
+    }
+}
+
+// The layers without an IDpp are only converted to a target the caller gave
+TEST(HdrCommandWriterTest, GeneratedLayersNeedTargetDataspace) {
+    const int pq = HAL_DATASPACE_STANDARD_BT2020 | HAL_DATASPACE_TRANSFER_ST2084;
+    Writer writer = createWriter();
+    auto hdrLayers = [&writer, pq]() {
+        writer->setLayerStaticMetadata(0, pq, 50, 1000);
+        g2d_commandlist *cmdlist = writer->getCommands();
+        EXPECT_NE(cmdlist, nullptr);
+        uint32_t layer_count = cmdlist ? cmdlist->layer_count : 0;
+        writer->putCommands(cmdlist);
+        return layer_count;
+    };
+
+    EXPECT_EQ(hdrLayers(), 0u);
+
+    EXPECT_TRUE(writer->setTargetInfo(HAL_DATASPACE_STANDARD_BT709 | HAL_DATASPACE_TRANSFER_SRGB,
+                                      nullptr));
+    EXPECT_EQ(hdrLayers(), 1u);
+
+    // a target without a standard or a transfer replaces the last one
+    EXPECT_FALSE(writer->setTargetInfo(HAL_DATASPACE_UNKNOWN, nullptr));
+    EXPECT_EQ(hdrLayers(), 0u);
+    EXPECT_FALSE(writer->setTargetInfo(HAL_DATASPACE_STANDARD_DCI_P3, nullptr));
+    EXPECT_EQ(hdrLayers(), 0u);
+    EXPECT_FALSE(writer->setTargetInfo(HAL_DATASPACE_TRANSFER_SRGB, nullptr));
+    EXPECT_EQ(hdrLayers(), 0u);
+
+    EXPECT_TRUE(writer->setTargetInfo(HAL_DATASPACE_STANDARD_DCI_P3 | HAL_DATASPACE_TRANSFER_GAMMA2_2,
+                                      nullptr));
+    EXPECT_EQ(hdrLayers(), 1u);
+}
+
+// The totals of dump() cover every job of the writer
+TEST(HdrCommandWriterTest, StatisticsCountEveryJob) {
+    FakeDpp eotfOetf({true, false, false, true}, 1);
+    FakeDpp gmDtm({false, true, true, false}, 2);
+    FakeDpp all({true, true, true, true}, 3);
+    Writer writer = createWriter();
+
+    uint64_t commands = 0;
+    auto run = [&writer, &commands](const std::vector<FakeDpp *> &layers) {
+        for (std::size_t layer = 0; layer < layers.size(); layer++)
+            writer->setLayerOpaqueData(layer, layers[layer], sizeof(FakeDpp));
+        g2d_commandlist *cmdlist = writer->getCommands();
+        ASSERT_NE(cmdlist, nullptr);
+        commands += cmdlist->command_count;
+        writer->putCommands(cmdlist);
+    };
+    run({&eotfOetf, &gmDtm});
+    run({&eotfOetf, &gmDtm});
+    run({&all});
+
+    std::string dump;
+    writer->dump(dump);
+    uint64_t jobs, dumpedCommands, cacheHits, timeNs, eotf, gm, dtm, oetf;
+    ASSERT_EQ(sscanf(dump.c_str(),
+                     "G2D HDR jobs: %" SCNu64 ", commands: %" SCNu64 ", cache hits: %" SCNu64
+                     ", getCommands: %" SCNu64 " ns/job\n"
+                     "G2D HDR layers with eotf: %" SCNu64 ", gm: %" SCNu64 ", dtm: %" SCNu64
+                     ", oetf: %" SCNu64,
+                     &jobs, &dumpedCommands, &cacheHits, &timeNs, &eotf, &gm, &dtm, &oetf),
+              8)
+            << dump;
+    EXPECT_EQ(jobs, 3u);
+    EXPECT_EQ(dumpedCommands, commands);
+    // the four stages of the second job come from the cache
+    EXPECT_EQ(cacheHits, 4u);
+    EXPECT_EQ(eotf, 3u);
+    EXPECT_EQ(gm, 3u);
+    EXPECT_EQ(dtm, 3u);
+    EXPECT_EQ(oetf, 3u);
+}
+
+}  // namespace
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include <system/graphics.h>
+
+#include "hdr_lut_generator.h"
+
+/*
+ * The generated stages against values of the standards: the PQ and sRGB
+ * encodings of ST 2084 and IEC 61966-2-1, the BT.2020 to BT.709 matrix of
+ * ITU-R BT.2087 and the SDR reference white of ITU-R BT.2408.
+ */
+namespace {
+
+const int BT2020_PQ = HAL_DATASPACE_STANDARD_BT2020 | HAL_DATASPACE_TRANSFER_ST2084;
+const int BT709_PQ = HAL_DATASPACE_STANDARD_BT709 | HAL_DATASPACE_TRANSFER_ST2084;
+const int BT709_SRGB = HAL_DATASPACE_STANDARD_BT709 | HAL_DATASPACE_TRANSFER_SRGB;
+const int BT2020_SRGB = HAL_DATASPACE_STANDARD_BT2020 | HAL_DATASPACE_TRANSFER_SRGB;
+const int P3_PQ = HAL_DATASPACE_STANDARD_DCI_P3 | HAL_DATASPACE_TRANSFER_ST2084;
+
+// 16 fractional bits, as assumed by the generator
+const int32_t GM_ONE = 1 << 16;
+
+int32_t gmCoef(const GeneratedDpp &dpp, std::size_t i) {
+    uint32_t coef = dpp.Gm().config->matrix_data.coeffs[i];
+    return static_cast<int32_t>(coef << 13) >> 13; // 19-bit two's complement
+}
+
+TEST(HdrLutGeneratorTest, EotfDecodesPq) {
+    // mastered over the whole range of PQ: the EOTF output is luminance / 10000
+    GeneratedDpp dpp({BT2020_PQ, 0, 10000, BT709_SRGB});
+    ASSERT_TRUE(dpp.EotfLut().enable);
+    const auto &eotf = dpp.EotfLut().config->tf_data;
+
+    EXPECT_EQ(eotf.posx[0], 0);
+    EXPECT_EQ(eotf.posy[0], 0u);
+    // PQ code 1.0 is 10000 cd/m2
+    EXPECT_EQ(eotf.posx[128], 1023);
+    EXPECT_EQ(eotf.posy[128], 65535u);
+    // 512 / 1023 is 92.698 cd/m2, 520 / 1023 is 100.230 cd/m2
+    EXPECT_EQ(eotf.posx[64], 512);
+    EXPECT_EQ(eotf.posy[64], 607u);
+    EXPECT_EQ(eotf.posx[65], 520);
+    EXPECT_EQ(eotf.posy[65], 657u);
+
+    // normalized to the mastering peak, above which it is clamped
+    GeneratedDpp mastered({BT2020_PQ, 0, 1000, BT709_SRGB});
+    EXPECT_EQ(mastered.EotfLut().config->tf_data.posy[65], 6569u);
+    EXPECT_EQ(mastered.EotfLut().config->tf_data.posy[128], 65535u);
+}
+
+TEST(HdrLutGeneratorTest, OetfEncodesPq) {
+    // the OETF input 1.0 is the mastering peak: 1000 cd/m2 is PQ code 769.12
+    GeneratedDpp dpp({BT2020_PQ, 0, 1000, P3_PQ});
+    ASSERT_TRUE(dpp.OetfLut().enable);
+    const auto &oetf = dpp.OetfLut().config->tf_data;
+    EXPECT_EQ(oetf.posx[0], 0u);
+    EXPECT_EQ(oetf.posy[0], 0);
+    EXPECT_EQ(oetf.posx[32], 65535u);
+    EXPECT_EQ(oetf.posy[32], 769);
+
+    GeneratedDpp full({BT2020_PQ, 0, 10000, P3_PQ});
+    EXPECT_EQ(full.OetfLut().config->tf_data.posy[32], 1023);
+}
+
+TEST(HdrLutGeneratorTest, ToneCurvePeakIsSdrWhite) {
+    // the mastering peak is tone mapped to the 203 cd/m2 reference white: sRGB 1.0
+    GeneratedDpp bright({BT2020_PQ, 0, 1000, BT709_SRGB});
+    EXPECT_EQ(bright.OetfLut().config->tf_data.posx[32], 65535u);
+    EXPECT_EQ(bright.OetfLut().config->tf_data.posy[32], 1023);
+
+    // mastered at the reference white, the tone curve is the identity: the
+    // OETF input 0.25 at (16 / 32)^2 is sRGB 0.53710
+    GeneratedDpp white({BT2020_PQ, 0, 203, BT709_SRGB});
+    const auto &oetf = white.OetfLut().config->tf_data;
+    EXPECT_EQ(oetf.posx[16], 16384u);
+    EXPECT_EQ(oetf.posy[16], 549);
+    EXPECT_EQ(oetf.posy[32], 1023);
+}
+
+TEST(HdrLutGeneratorTest, GamutMatrixOfBt2087) {
+    // the same primaries need no GM
+    EXPECT_FALSE(GeneratedDpp({BT2020_PQ, 0, 1000, BT2020_SRGB}).Gm().enable);
+    EXPECT_FALSE(GeneratedDpp({BT709_PQ, 0, 1000, BT709_SRGB}).Gm().enable);
+
+    // BT.2020 to BT.709, rounded to 4 decimals in BT.2087
+    GeneratedDpp dpp({BT2020_PQ, 0, 1000, BT709_SRGB});
+    ASSERT_TRUE(dpp.Gm().enable);
+    const double expected[9] = {
+            1.6605, -0.5876, -0.0728,
+            -0.1246, 1.1329, -0.0083,
+            -0.0182, -0.1006, 1.1187,
+    };
+    for (std::size_t i = 0; i < 9; i++)
+        EXPECT_NEAR(gmCoef(dpp, i), expected[i] * GM_ONE, 0.0001 * GM_ONE) << "coefficient " << i;
+
+    // the white point is kept: each row adds up to 1.0
+    for (std::size_t r = 0; r < 3; r++)
+        EXPECT_NEAR(gmCoef(dpp, r * 3) + gmCoef(dpp, r * 3 + 1) + gmCoef(dpp, r * 3 + 2), GM_ONE,
+                    2)
+                << "row " << r;
+}
+
+}  // namespace
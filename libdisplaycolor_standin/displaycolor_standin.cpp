@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "displaycolor_standin.h"
+
+#include <gs101/displaycolor/hdr10plus_dtm_gs101.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <thread>
+
+namespace displaycolor {
+namespace standin {
+
+namespace {
+
+using Dataspace = hwc::Dataspace;
+
+constexpr uint32_t kMaxDbv = 4095;
+/* luminance of the HDR10 input range and of the panel at kMaxDbv */
+constexpr float kHdrInputNits = 10000.0f;
+constexpr float kPanelPeakNits = 1000.0f;
+
+uint32_t transferOf(Dataspace dataspace) {
+    return static_cast<uint32_t>(dataspace) & static_cast<uint32_t>(Dataspace::TRANSFER_MASK);
+}
+
+uint32_t standardOf(Dataspace dataspace) {
+    return static_cast<uint32_t>(dataspace) & static_cast<uint32_t>(Dataspace::STANDARD_MASK);
+}
+
+bool isHdr(Dataspace dataspace) {
+    uint32_t transfer = transferOf(dataspace);
+    return (transfer == static_cast<uint32_t>(Dataspace::TRANSFER_ST2084)) ||
+           (transfer == static_cast<uint32_t>(Dataspace::TRANSFER_HLG));
+}
+
+/* Not the real curves: a power of the normalized value per transfer */
+float transferGamma(Dataspace dataspace) {
+    switch (transferOf(dataspace)) {
+        case static_cast<uint32_t>(Dataspace::TRANSFER_LINEAR):
+            return 1.0f;
+        case static_cast<uint32_t>(Dataspace::TRANSFER_SMPTE_170M):
+            return 2.0f;
+        case static_cast<uint32_t>(Dataspace::TRANSFER_ST2084):
+            return 2.8f;
+        case static_cast<uint32_t>(Dataspace::TRANSFER_HLG):
+            return 1.7f;
+        default:
+            return 2.2f;
+    }
+}
+
+Dataspace targetDataspace(hwc::ColorMode mode) {
+    switch (mode) {
+        case hwc::ColorMode::DISPLAY_P3:
+            return Dataspace::DISPLAY_P3;
+        case hwc::ColorMode::BT2100_PQ:
+            return Dataspace::BT2020_PQ;
+        default:
+            return Dataspace::SRGB;
+    }
+}
+
+/* DQE matrices are 16-bit two's complement where 1024 is 1.0 */
+uint16_t toDqeCoeff(float value) {
+    return static_cast<uint16_t>(static_cast<int16_t>(
+            std::clamp(std::lround(value * 1024.0f), -32768L, 32767L)));
+}
+
+/* GM coefficients are 19-bit two's complement where 65536 is 1.0 */
+uint32_t toGmCoeff(int32_t value) {
+    return static_cast<uint32_t>(value) & 0x7FFFF;
+}
+
+}  // namespace
+
+DisplayColorStandIn::DisplayColorStandIn(const Options &options) : mOptions(options) {}
+
+int DisplayColorStandIn::Update(DisplayType display, const DisplayScene &scene) {
+    if (display != DisplayType::DISPLAY_PRIMARY)
+        return -EINVAL;
+    if (mOptions.updateLatency.count())
+        std::this_thread::sleep_for(mOptions.updateLatency);
+    mUpdates++;
+
+    auto &dpps = mPipeline.dpps;
+    while (dpps.size() < scene.layer_data.size())
+        dpps.push_back(std::make_unique<Dpp>());
+    dpps.resize(scene.layer_data.size());
+
+    setTargetDbv(scene.dbv);
+    for (size_t i = 0; i < dpps.size(); i++)
+        setDpp(*dpps[i], scene.layer_data[i], scene);
+
+    Dqe &dqe = mPipeline.dqe;
+    dqe.control.scratch().force_10bpc = scene.dpu_bit_depth == BitDepth::kTen;
+    dqe.control.set(true);
+
+    /* the color transform is a column-major 4x4 matrix */
+    bool identity = true;
+    for (size_t i = 0; i < scene.matrix.size(); i++)
+        identity = identity && (scene.matrix[i] == ((i % 5 == 0) ? 1.0f : 0.0f));
+    if (!identity) {
+        auto &matrix = dqe.gammaMatrix.scratch().matrix_data;
+        for (size_t row = 0; row < 3; row++) {
+            for (size_t col = 0; col < 3; col++)
+                matrix.coeffs[row * 3 + col] = toDqeCoeff(scene.matrix[col * 4 + row]);
+            matrix.offsets[row] = toDqeCoeff(scene.matrix[12 + row]);
+        }
+    }
+    dqe.gammaMatrix.set(!identity);
+
+    /* HBM boosts the contrast a little */
+    bool hbm = (scene.bm == BrightnessMode::BM_HBM) || scene.lhbm_on;
+    if (hbm) {
+        auto &matrix = dqe.linearMatrix.scratch().matrix_data;
+        for (size_t i = 0; i < matrix.coeffs.size(); i++)
+            matrix.coeffs[i] = toDqeCoeff((i % 4 == 0) ? 1.08f : -0.04f);
+    }
+    dqe.linearMatrix.set(hbm);
+
+    bool native = scene.color_mode == hwc::ColorMode::NATIVE;
+    if (!native) {
+        float gamma = (scene.render_intent == hwc::RenderIntent::ENHANCE) ? 2.4f : 2.2f;
+        auto &degamma = dqe.degamma.scratch();
+        for (size_t i = 0; i < degamma.values.size(); i++) {
+            float x = static_cast<float>(i) / (degamma.values.size() - 1);
+            degamma.values[i] = static_cast<uint16_t>(std::lround(std::pow(x, gamma) * 4095));
+        }
+
+        auto &cgc = dqe.cgc.scratch();
+        const uint32_t mode = static_cast<uint32_t>(scene.color_mode);
+        const uint32_t intent = static_cast<uint32_t>(scene.render_intent);
+        auto fill = [&](auto &values, uint32_t channel) {
+            for (size_t i = 0; i < values.size(); i++) {
+                int32_t base = static_cast<int32_t>(i * 8191 / (values.size() - 1));
+                int32_t tint = static_cast<int32_t>((i * (mode + 3) * (channel + 1) +
+                                                     intent * 17) % 33) - 16;
+                values[i] = static_cast<uint32_t>(std::clamp(base + tint, 0, 8191));
+            }
+        };
+        fill(cgc.r_values, 0);
+        fill(cgc.g_values, 1);
+        fill(cgc.b_values, 2);
+    }
+    dqe.degamma.set(!native);
+    dqe.cgc.set(!native);
+
+    setRegamma();
+    return 0;
+}
+
+int DisplayColorStandIn::UpdatePresent(DisplayType display, const DisplayScene &scene) {
+    if (display != DisplayType::DISPLAY_PRIMARY)
+        return -EINVAL;
+    if (mOptions.updatePresentLatency.count())
+        std::this_thread::sleep_for(mOptions.updatePresentLatency);
+    mUpdatePresents++;
+
+    setTargetDbv(scene.dbv);
+    uint32_t &dbv = mPipeline.panel.dbv;
+    if (dbv < mTargetDbv)
+        dbv = std::min(dbv + mDbvStep, mTargetDbv);
+    else if (dbv > mTargetDbv)
+        dbv = (dbv - mTargetDbv > mDbvStep) ? dbv - mDbvStep : mTargetDbv;
+    setRegamma();
+    return 0;
+}
+
+const ColorModesMap DisplayColorStandIn::ColorModesAndRenderIntents(DisplayType display) const {
+    if (display != DisplayType::DISPLAY_PRIMARY)
+        return {};
+    return {
+            {hwc::ColorMode::NATIVE, {hwc::RenderIntent::COLORIMETRIC}},
+            {hwc::ColorMode::SRGB, {hwc::RenderIntent::COLORIMETRIC, hwc::RenderIntent::ENHANCE}},
+            {hwc::ColorMode::DISPLAY_P3,
+             {hwc::RenderIntent::COLORIMETRIC, hwc::RenderIntent::ENHANCE}},
+    };
+}
+
+bool DisplayColorStandIn::IsRrCompensationEnabled(DisplayType display) {
+    return (display == DisplayType::DISPLAY_PRIMARY) && mOptions.rrCompensation;
+}
+
+const IDisplayColorGS101::IDisplayPipelineData *DisplayColorStandIn::GetPipelineData(
+        DisplayType display) const {
+    return (display == DisplayType::DISPLAY_PRIMARY) ? &mPipeline : nullptr;
+}
+
+void DisplayColorStandIn::setTargetDbv(uint32_t dbv) {
+    dbv = std::min(dbv, kMaxDbv);
+    uint32_t &panelDbv = mPipeline.panel.dbv;
+    if (mOptions.dbvTransitionFrames == 0) {
+        panelDbv = mTargetDbv = dbv;
+        return;
+    }
+    if (dbv == mTargetDbv)
+        return;
+
+    mTargetDbv = dbv;
+    uint32_t distance = (dbv > panelDbv) ? dbv - panelDbv : panelDbv - dbv;
+    uint32_t frames = mOptions.dbvTransitionFrames;
+    mDbvStep = std::max((distance + frames - 1) / frames, 1u);
+}
+
+void DisplayColorStandIn::setDpp(Dpp &dpp, const LayerColorData &layer,
+                                 const DisplayScene &scene) {
+    const Dataspace target = targetDataspace(scene.color_mode);
+    const Dataspace source = (layer.dataspace == Dataspace::UNKNOWN) ? Dataspace::SRGB
+                                                                     : layer.dataspace;
+    const bool convert = source != target;
+
+    if (convert) {
+        /* 10-bit code to 16-bit linear */
+        auto &eotf = dpp.eotf.scratch().tf_data;
+        float gamma = transferGamma(source);
+        for (size_t i = 0; i < eotf.posx.size(); i++) {
+            eotf.posx[i] = static_cast<uint16_t>(std::lround(i * 1023.0f / (eotf.posx.size() - 1)));
+            eotf.posy[i] = static_cast<uint32_t>(
+                    std::lround(std::pow(eotf.posx[i] / 1023.0f, gamma) * 65535));
+        }
+
+        auto &gm = dpp.gm.scratch().matrix_data;
+        uint32_t seed = (standardOf(source) >> 16) * 7 + (standardOf(target) >> 16) * 3;
+        for (size_t i = 0; i < gm.coeffs.size(); i++) {
+            int32_t tweak = (standardOf(source) == standardOf(target))
+                    ? 0
+                    : static_cast<int32_t>((seed + i * 13) % 4096) - 2048;
+            gm.coeffs[i] = toGmCoeff(((i % 4 == 0) ? 65536 : 0) + tweak);
+        }
+
+        /* 16-bit linear to 10-bit code, HDR dimmed with the brightness */
+        auto &oetf = dpp.oetf.scratch().tf_data;
+        float inverse = 1.0f / transferGamma(target);
+        float scale = isHdr(source) ? 0.5f + 0.5f * mTargetDbv / kMaxDbv : 1.0f;
+        for (size_t i = 0; i < oetf.posx.size(); i++) {
+            oetf.posx[i] = static_cast<uint32_t>(std::lround(i * 65535.0f / (oetf.posx.size() - 1)));
+            oetf.posy[i] = static_cast<uint16_t>(
+                    std::lround(std::pow(oetf.posx[i] / 65535.0f, inverse) * 1023 * scale));
+        }
+    }
+    dpp.eotf.set(convert);
+    dpp.gm.set(convert);
+    dpp.oetf.set(convert);
+
+    float outputNits = kPanelPeakNits * std::max(mTargetDbv, 1u) / kMaxDbv;
+    bool dtm = hdr10plus::GenerateDtm(layer.dynamic_metadata, kHdrInputNits, outputNits,
+                                      dpp.dtm.scratch());
+    dpp.dtm.set(dtm);
+}
+
+void DisplayColorStandIn::setRegamma() {
+    /* one regamma per 16 dbv levels */
+    uint32_t level = mPipeline.panel.dbv >> 4;
+    if (level == mRegammaLevel)
+        return;
+    mRegammaLevel = level;
+
+    auto &regamma = mPipeline.dqe.regamma.scratch();
+    float scale = 0.9f + 0.1f * level / (kMaxDbv >> 4);
+    for (size_t i = 0; i < regamma.r_values.size(); i++) {
+        float y = std::pow(static_cast<float>(i) / (regamma.r_values.size() - 1), 1 / 2.2f);
+        auto code = [&](float tint) {
+            return static_cast<uint16_t>(std::min(std::lround(y * 4095 * scale * tint), 4095L));
+        };
+        regamma.r_values[i] = code(1.0f);
+        regamma.g_values[i] = code(0.99f);
+        regamma.b_values[i] = code(0.98f);
+    }
+    mPipeline.dqe.regamma.set(true);
+}
+
+}  // namespace standin
+
+extern "C" {
+
+IDisplayColorGS101 *GetDisplayColorGS101(size_t /* display_num */) {
+    static standin::DisplayColorStandIn displayColor;
+    return &displayColor;
+}
+}
+
+}  // namespace displaycolor
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DISPLAYCOLOR_STANDIN_H_
+#define DISPLAYCOLOR_STANDIN_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <gs101/displaycolor/displaycolor_gs101.h>
+
+namespace displaycolor {
+namespace standin {
+
+/**
+ * @brief Stand-in of libdisplaycolor for boards and tests without it.
+ *
+ * It is built from the same headers as the HWC, so a change of the
+ * interfaces that the prebuilt library would not follow fails to build or
+ * shows in the tests, instead of calling into the wrong vtable slots.
+ *
+ * The register data is derived deterministically from the scene, in the
+ * formats documented in reference_pipeline_gs101.h, and is not calibrated:
+ * - DPP: the layers whose dataspace differs from the color mode get EOTF,
+ *   GM and OETF; HDR10+ layers get DTM. The OETF of HDR layers follows the
+ *   brightness.
+ * - DQE: control always, the gamma matrix for a color transform, the linear
+ *   matrix in HBM, degamma and CGC for color modes other than native, and
+ *   regamma for the brightness the panel is at.
+ * As in libdisplaycolor, a stage is dirty once its data changes, and
+ * NotifyDataApplied() clears the dirty bit.
+ *
+ * UpdatePresent() moves the panel brightness to the dbv of the scene over
+ * Options::dbvTransitionFrames calls, and updates regamma on the way, so it
+ * may change the pipeline data of a frame whose scene did not change.
+ */
+class DisplayColorStandIn : public IDisplayColorGS101 {
+   public:
+    struct Options {
+        /// Time Update() and UpdatePresent() take, as the library would
+        std::chrono::microseconds updateLatency{0};
+        std::chrono::microseconds updatePresentLatency{0};
+        /// UpdatePresent() calls to reach a new dbv, 0 to reach it at once
+        uint32_t dbvTransitionFrames = 0;
+        bool rrCompensation = false;
+    };
+
+    DisplayColorStandIn() : DisplayColorStandIn(Options()) {}
+    explicit DisplayColorStandIn(const Options &options);
+
+    int Update(DisplayType display, const DisplayScene &scene) override;
+    int UpdatePresent(DisplayType display, const DisplayScene &scene) override;
+    const ColorModesMap ColorModesAndRenderIntents(DisplayType display) const override;
+    bool IsRrCompensationEnabled(DisplayType display) override;
+    const IDisplayPipelineData *GetPipelineData(DisplayType display) const override;
+
+    uint32_t updates() const { return mUpdates; }
+    uint32_t updatePresents() const { return mUpdatePresents; }
+
+    /**
+     * @brief Data of a pipeline stage. set() marks the stage dirty if its
+     * enable or config changed; the config is compared byte by byte, so
+     * generators fill the zeroed config of scratch(). The configs are
+     * trivially copyable, padding included.
+     */
+    template <typename StageData>
+    class Stage {
+       public:
+        using Config = typename StageData::ConfigType;
+        static_assert(std::is_trivially_copyable<Config>::value, "config is not plain data");
+
+        Stage() {
+            memset(static_cast<void *>(&mConfig), 0, sizeof(mConfig));
+            mData.config = &mConfig;
+            mData.data_applied_notifier = [this] { mData.dirty = false; };
+        }
+        Stage(const Stage &) = delete;
+        Stage &operator=(const Stage &) = delete;
+
+        Config &scratch() {
+            memset(static_cast<void *>(&mScratch), 0, sizeof(mScratch));
+            return mScratch;
+        }
+        /// Set the stage to @enable and, if enabled, the config of scratch()
+        void set(bool enable) {
+            if (enable != mData.enable) {
+                mData.enable = enable;
+                mData.dirty = true;
+            }
+            if (enable && memcmp(&mScratch, &mConfig, sizeof(mConfig))) {
+                memcpy(static_cast<void *>(&mConfig), &mScratch, sizeof(mConfig));
+                mData.dirty = true;
+            }
+        }
+        const StageData &data() const { return mData; }
+
+       private:
+        StageData mData;
+        Config mConfig;
+        Config mScratch;
+    };
+
+    class Dpp : public IDpp {
+       public:
+        const EotfData &EotfLut() const override { return eotf.data(); }
+        const GmData &Gm() const override { return gm.data(); }
+        const DtmData &Dtm() const override { return dtm.data(); }
+        const OetfData &OetfLut() const override { return oetf.data(); }
+
+        Stage<EotfData> eotf;
+        Stage<GmData> gm;
+        Stage<DtmData> dtm;
+        Stage<OetfData> oetf;
+    };
+
+    class Dqe : public IDqe {
+       public:
+        const DqeControlData &DqeControl() const override { return control.data(); }
+        const DqeMatrixData &GammaMatrix() const override { return gammaMatrix.data(); }
+        const DegammaLutData &DegammaLut() const override { return degamma.data(); }
+        const DqeMatrixData &LinearMatrix() const override { return linearMatrix.data(); }
+        const CgcData &Cgc() const override { return cgc.data(); }
+        const RegammaLutData &RegammaLut() const override { return regamma.data(); }
+
+        Stage<DqeControlData> control;
+        Stage<DqeMatrixData> gammaMatrix;
+        Stage<DegammaLutData> degamma;
+        Stage<DqeMatrixData> linearMatrix;
+        Stage<CgcData> cgc;
+        Stage<RegammaLutData> regamma;
+    };
+
+    class Panel : public IPanel {
+       public:
+        uint32_t GetAdjustedBrightnessLevel() const override { return dbv; }
+        uint32_t dbv = 0;
+    };
+
+   private:
+    class PipelineData : public IDisplayPipelineData {
+       public:
+        std::vector<std::reference_wrapper<const IDpp>> Dpp() const override {
+            std::vector<std::reference_wrapper<const IDpp>> handles;
+            for (auto &dpp : dpps)
+                handles.push_back(*dpp);
+            return handles;
+        }
+        const IDqe &Dqe() const override { return dqe; }
+        const IPanel &Panel() const override { return panel; }
+
+        /* the stages must not move, their notifiers point to them */
+        std::vector<std::unique_ptr<DisplayColorStandIn::Dpp>> dpps;
+        DisplayColorStandIn::Dqe dqe;
+        DisplayColorStandIn::Panel panel;
+    };
+
+    /* Set the dbv the panel moves to, and the step of UpdatePresent() */
+    void setTargetDbv(uint32_t dbv);
+    void setDpp(Dpp &dpp, const LayerColorData &layer, const DisplayScene &scene);
+    /* Set regamma for the brightness of the panel */
+    void setRegamma();
+
+    const Options mOptions;
+    PipelineData mPipeline;
+    /* the dbv the panel moves to, and the regamma level it was set for */
+    uint32_t mTargetDbv = 0;
+    uint32_t mDbvStep = 1;
+    uint32_t mRegammaLevel = UINT32_MAX;
+    std::atomic<uint32_t> mUpdates{0};
+    std::atomic<uint32_t> mUpdatePresents{0};
+};
+
+}  // namespace standin
+}  // namespace displaycolor
+
+#endif  // DISPLAYCOLOR_STANDIN_H_
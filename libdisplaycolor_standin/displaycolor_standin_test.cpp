@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "displaycolor_standin.h"
+
+namespace displaycolor {
+namespace {
+
+using standin::DisplayColorStandIn;
+
+DisplayScene makeScene(std::vector<hwc::Dataspace> dataspaces) {
+    DisplayScene scene;
+    for (auto dataspace : dataspaces) {
+        LayerColorData layer;
+        layer.dataspace = dataspace;
+        scene.layer_data.push_back(layer);
+    }
+    scene.color_mode = hwc::ColorMode::SRGB;
+    scene.render_intent = hwc::RenderIntent::COLORIMETRIC;
+    for (size_t i = 0; i < scene.matrix.size(); i++)
+        scene.matrix[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+    scene.dbv = 1000;
+    return scene;
+}
+
+template <typename StageData>
+void apply(const StageData &stage) {
+    if (stage.enable && stage.dirty)
+        stage.NotifyDataApplied();
+}
+
+void applyAll(const IDisplayColorGS101 &displayColor) {
+    auto *pipeline = displayColor.GetPipelineData(DisplayType::DISPLAY_PRIMARY);
+    const auto &dqe = pipeline->Dqe();
+    apply(dqe.DqeControl());
+    apply(dqe.GammaMatrix());
+    apply(dqe.DegammaLut());
+    apply(dqe.LinearMatrix());
+    apply(dqe.Cgc());
+    apply(dqe.RegammaLut());
+    for (const IDisplayColorGS101::IDpp &dpp : pipeline->Dpp()) {
+        apply(dpp.EotfLut());
+        apply(dpp.Gm());
+        apply(dpp.Dtm());
+        apply(dpp.OetfLut());
+    }
+}
+
+TEST(DisplayColorStandInTest, ExportsOneInstance) {
+    IDisplayColorGS101 *displayColor = GetDisplayColorGS101(1);
+    ASSERT_NE(displayColor, nullptr);
+    EXPECT_EQ(displayColor, GetDisplayColorGS101(1));
+    EXPECT_EQ(displayColor->GetPipelineData(DisplayType::DISPLAY_EXTERNAL), nullptr);
+    EXPECT_NE(displayColor->Update(DisplayType::DISPLAY_EXTERNAL, DisplayScene()), 0);
+}
+
+TEST(DisplayColorStandInTest, ConvertsLayersOutsideTheColorMode) {
+    DisplayColorStandIn displayColor;
+    ASSERT_EQ(displayColor.Update(DisplayType::DISPLAY_PRIMARY,
+                                  makeScene({hwc::Dataspace::SRGB, hwc::Dataspace::BT2020_PQ})),
+              0);
+
+    auto dpps = displayColor.GetPipelineData(DisplayType::DISPLAY_PRIMARY)->Dpp();
+    ASSERT_EQ(dpps.size(), 2u);
+    const IDisplayColorGS101::IDpp &sdr = dpps[0];
+    const IDisplayColorGS101::IDpp &hdr = dpps[1];
+    EXPECT_FALSE(sdr.EotfLut().enable);
+    EXPECT_FALSE(sdr.OetfLut().enable);
+    EXPECT_TRUE(hdr.EotfLut().enable && hdr.EotfLut().dirty);
+    EXPECT_TRUE(hdr.Gm().enable && hdr.Gm().dirty);
+    EXPECT_TRUE(hdr.OetfLut().enable && hdr.OetfLut().dirty);
+    EXPECT_FALSE(hdr.Dtm().enable);
+    ASSERT_NE(hdr.EotfLut().config, nullptr);
+    EXPECT_EQ(hdr.EotfLut().config->tf_data.posx.back(), 1023);
+}
+
+TEST(DisplayColorStandInTest, DirtyUntilApplied) {
+    DisplayColorStandIn displayColor;
+    DisplayScene scene = makeScene({hwc::Dataspace::BT2020_PQ});
+    ASSERT_EQ(displayColor.Update(DisplayType::DISPLAY_PRIMARY, scene), 0);
+    const auto &dqe = displayColor.GetPipelineData(DisplayType::DISPLAY_PRIMARY)->Dqe();
+    EXPECT_TRUE(dqe.RegammaLut().dirty);
+
+    applyAll(displayColor);
+    EXPECT_FALSE(dqe.RegammaLut().dirty);
+    const IDisplayColorGS101::IDpp &dpp =
+            displayColor.GetPipelineData(DisplayType::DISPLAY_PRIMARY)->Dpp()[0];
+    EXPECT_FALSE(dpp.EotfLut().dirty);
+
+    /* the same scene leaves the data clean */
+    ASSERT_EQ(displayColor.Update(DisplayType::DISPLAY_PRIMARY, scene), 0);
+    EXPECT_FALSE(dqe.RegammaLut().dirty);
+    EXPECT_FALSE(dpp.EotfLut().dirty);
+
+    /* the OETF of HDR layers follows the brightness */
+    scene.dbv = 3000;
+    ASSERT_EQ(displayColor.Update(DisplayType::DISPLAY_PRIMARY, scene), 0);
+    EXPECT_TRUE(dpp.OetfLut().dirty);
+    EXPECT_FALSE(dpp.EotfLut().dirty);
+}
+
+TEST(DisplayColorStandInTest, HbmTogglesTheLinearMatrix) {
+    DisplayColorStandIn displayColor;
+    DisplayScene scene = makeScene({hwc::Dataspace::SRGB});
+    const auto &dqe = displayColor.GetPipelineData(DisplayType::DISPLAY_PRIMARY)->Dqe();
+    ASSERT_EQ(displayColor.Update(DisplayType::DISPLAY_PRIMARY, scene), 0);
+    applyAll(displayColor);
+    EXPECT_FALSE(dqe.LinearMatrix().enable);
+
+    scene.bm = BrightnessMode::BM_HBM;
+    ASSERT_EQ(displayColor.Update(DisplayType::DISPLAY_PRIMARY, scene), 0);
+    EXPECT_TRUE(dqe.LinearMatrix().enable && dqe.LinearMatrix().dirty);
+    applyAll(displayColor);
+
+    scene.bm = BrightnessMode::BM_NOMINAL;
+    ASSERT_EQ(displayColor.Update(DisplayType::DISPLAY_PRIMARY, scene), 0);
+    EXPECT_FALSE(dqe.LinearMatrix().enable);
+}
+
+TEST(DisplayColorStandInTest, UpdatePresentMovesTheBrightness) {
+    DisplayColorStandIn::Options options;
+    options.dbvTransitionFrames = 4;
+    DisplayColorStandIn displayColor(options);
+    DisplayScene scene = makeScene({hwc::Dataspace::SRGB});
+    scene.dbv = 0;
+    ASSERT_EQ(displayColor.Update(DisplayType::DISPLAY_PRIMARY, scene), 0);
+    ASSERT_EQ(displayColor.UpdatePresent(DisplayType::DISPLAY_PRIMARY, scene), 0);
+    applyAll(displayColor);
+
+    auto *pipeline = displayColor.GetPipelineData(DisplayType::DISPLAY_PRIMARY);
+    scene.dbv = 4000;
+    ASSERT_EQ(displayColor.Update(DisplayType::DISPLAY_PRIMARY, scene), 0);
+    EXPECT_EQ(pipeline->Panel().GetAdjustedBrightnessLevel(), 0u);
+    for (uint32_t frame = 1; frame <= options.dbvTransitionFrames; frame++) {
+        ASSERT_EQ(displayColor.UpdatePresent(DisplayType::DISPLAY_PRIMARY, scene), 0);
+        EXPECT_EQ(pipeline->Panel().GetAdjustedBrightnessLevel(), 1000 * frame);
+        EXPECT_TRUE(pipeline->Dqe().RegammaLut().dirty);
+        applyAll(displayColor);
+    }
+
+    ASSERT_EQ(displayColor.UpdatePresent(DisplayType::DISPLAY_PRIMARY, scene), 0);
+    EXPECT_EQ(pipeline->Panel().GetAdjustedBrightnessLevel(), 4000u);
+    EXPECT_FALSE(pipeline->Dqe().RegammaLut().dirty);
+    EXPECT_EQ(displayColor.updates(), 2u);
+    EXPECT_EQ(displayColor.updatePresents(), 6u);
+}
+
+TEST(DisplayColorStandInTest, Hdr10PlusLayersGetDtm) {
+    DisplayColorStandIn displayColor;
+    DisplayScene scene = makeScene({hwc::Dataspace::BT2020_PQ});
+    auto &metadata = scene.layer_data[0].dynamic_metadata;
+    metadata.is_valid = true;
+    metadata.tm_flag = 1;
+    metadata.display_maximum_luminance = 500;
+    metadata.maxscl = {40000, 40000, 40000};
+    metadata.tm_knee_x = 1000;
+    metadata.tm_knee_y = 1500;
+    metadata.bezier_curve_anchors = {300, 600, 800};
+    ASSERT_EQ(displayColor.Update(DisplayType::DISPLAY_PRIMARY, scene), 0);
+
+    const IDisplayColorGS101::IDpp &dpp =
+            displayColor.GetPipelineData(DisplayType::DISPLAY_PRIMARY)->Dpp()[0];
+    EXPECT_TRUE(dpp.Dtm().enable && dpp.Dtm().dirty);
+    ASSERT_NE(dpp.Dtm().config, nullptr);
+    EXPECT_EQ(dpp.Dtm().config->tf_data.posx.back(), 65535);
+}
+
+}  // namespace
+}  // namespace displaycolor
@@ -21,7 +21,17 @@ LOCAL_SRC_FILES += \
 	../../$(TARGET_BOARD_PLATFORM)/libhwc2.1/libvirtualdisplay/ExynosVirtualDisplayModule.cpp \
 	../../$(TARGET_BOARD_PLATFORM)/libhwc2.1/libdisplayinterface/ExynosDisplayDrmInterfaceModule.cpp
 
-LOCAL_CFLAGS += -DDISPLAY_COLOR_LIB=\"libdisplaycolor.so\"
+# a board can load another implementation of GetDisplayColorGS101(), like
+# libdisplaycolor_standin.so of libdisplaycolor_standin/
+ifeq ($(BOARD_DISPLAY_COLOR_LIB),)
+BOARD_DISPLAY_COLOR_LIB := libdisplaycolor.so
+endif
+LOCAL_CFLAGS += -DDISPLAY_COLOR_LIB=\"$(BOARD_DISPLAY_COLOR_LIB)\"
+
+# run displaycolor scene updates off the composition thread
+ifeq ($(BOARD_USES_DISPLAY_COLOR_ASYNC_UPDATE), true)
+LOCAL_CFLAGS += -DDISPLAY_COLOR_ASYNC_UPDATE
+endif
 
 LOCAL_C_INCLUDES += \
 	$(TOP)/hardware/google/graphics/gs101/include
@@ -19,10 +19,14 @@
 
 #include <array>
 
+#include <gs101/libacryl_plugins/g2d_hdr_layers_gs101.h>
+
 #include "ExynosHWC.h"
 #include "DeconHeader.h"
 
 #define G2D_MAX_SRC_NUM 3
+// every source of a G2D job may be an HDR layer
+static_assert(G2D_MAX_SRC_NUM <= G2D_HDR_MAX_LAYER_COUNT, "more G2D sources than HDR layers");
 
 #define VSYNC_DEV_PREFIX "/sys/devices/platform/"
 #define PSR_DEV_NAME  "1c300000.decon_f/psr_info"
@@ -16,7 +16,29 @@
 
 #include "ExynosDisplayDrmInterfaceModule.h"
 #include "ExynosPrimaryDisplayModule.h"
+#include <android-base/stringprintf.h>
 #include <drm/samsung_drm.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <type_traits>
+
+using CgcConfigType = IDisplayColorGS101::IDqe::CgcData::ConfigType;
+
+/* CGC config of displaycolor is passed to the CGC blob as is */
+static_assert(std::is_same<CgcConfigType::Container, __u32>::value,
+              "CGC LUT entry type differs from struct cgc_lut");
+static_assert(CgcConfigType::kChannelLutLen == DRM_SAMSUNG_CGC_LUT_REG_CNT,
+              "CGC LUT length differs from struct cgc_lut");
+static_assert(sizeof(CgcConfigType) == sizeof(struct cgc_lut) &&
+              offsetof(CgcConfigType, r_values) == offsetof(struct cgc_lut, r_values) &&
+              offsetof(CgcConfigType, g_values) == offsetof(struct cgc_lut, g_values) &&
+              offsetof(CgcConfigType, b_values) == offsetof(struct cgc_lut, b_values),
+              "CGC config layout differs from struct cgc_lut");
 
 template <typename T, typename M>
 int32_t convertDqeMatrixDataToMatrix(T &colorMatrix, M &mat,
@@ -41,6 +63,166 @@ int32_t convertDqeMatrixDataToMatrix(T &colorMatrix, M &mat,
     return NO_ERROR;
 }
 
+/* Adds the time spent in its scope to a counter */
+class ScopedTimer {
+    public:
+        explicit ScopedTimer(uint64_t &us) : mUs(us), mStart(std::chrono::steady_clock::now()) {}
+        ~ScopedTimer() {
+            mUs += std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - mStart).count();
+        }
+    private:
+        uint64_t &mUs;
+        std::chrono::steady_clock::time_point mStart;
+};
+
+/*
+ * Signatures of the data the color properties are made from, hashed from
+ * the stage configs of displaycolor. The fields are hashed one by one, as
+ * the configs have padding.
+ */
+class SignatureHasher {
+    public:
+        /* 64-bit FNV-1a over 8-byte words, as BlobCache::acquire() */
+        void addBytes(const void *data, size_t size) {
+            const uint8_t *bytes = static_cast<const uint8_t *>(data);
+            size_t i = 0;
+            for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+                uint64_t word;
+                memcpy(&word, bytes + i, sizeof(word));
+                mHash = (mHash ^ word) * 0x100000001b3ULL;
+            }
+            for (; i < size; i++)
+                mHash = (mHash ^ bytes[i]) * 0x100000001b3ULL;
+        }
+        template <typename T, size_t N>
+        void add(const std::array<T, N> &values) {
+            addBytes(values.data(), sizeof(T) * N);
+        }
+        template <typename T>
+        void add(T value) {
+            static_assert(std::is_arithmetic<T>::value, "value is not a number");
+            addBytes(&value, sizeof(value));
+        }
+        uint64_t get() const {
+            /* 0 is kept for no signature */
+            return mHash ? mHash : 1;
+        }
+    private:
+        uint64_t mHash = 0xcbf29ce484222325ULL;
+};
+
+using IDqe = IDisplayColorGS101::IDqe;
+using IDpp = IDisplayColorGS101::IDpp;
+
+static void addConfig(SignatureHasher &hasher, const IDqe::DqeControlData::ConfigType &config)
+{
+    hasher.add(config.force_10bpc);
+    hasher.add(config.cgc_dither_override);
+    hasher.addBytes(&config.cgc_dither_reg, sizeof(config.cgc_dither_reg));
+    hasher.add(config.disp_dither_override);
+    hasher.addBytes(&config.disp_dither_reg, sizeof(config.disp_dither_reg));
+}
+
+static void addConfig(SignatureHasher &hasher, const IDqe::DqeMatrixData::ConfigType &config)
+{
+    hasher.add(config.matrix_data.coeffs);
+    hasher.add(config.matrix_data.offsets);
+}
+
+static void addConfig(SignatureHasher &hasher, const IDqe::DegammaLutData::ConfigType &config)
+{
+    hasher.add(config.values);
+}
+
+static void addConfig(SignatureHasher &hasher, const IDqe::CgcData::ConfigType &config)
+{
+    hasher.add(config.r_values);
+    hasher.add(config.g_values);
+    hasher.add(config.b_values);
+}
+
+static void addConfig(SignatureHasher &hasher, const IDqe::RegammaLutData::ConfigType &config)
+{
+    hasher.add(config.r_values);
+    hasher.add(config.g_values);
+    hasher.add(config.b_values);
+}
+
+static void addConfig(SignatureHasher &hasher, const IDpp::EotfData::ConfigType &config)
+{
+    hasher.add(config.tf_data.posx);
+    hasher.add(config.tf_data.posy);
+}
+
+static void addConfig(SignatureHasher &hasher, const IDpp::GmData::ConfigType &config)
+{
+    hasher.add(config.matrix_data.coeffs);
+    hasher.add(config.matrix_data.offsets);
+}
+
+static void addConfig(SignatureHasher &hasher, const IDpp::DtmData::ConfigType &config)
+{
+    hasher.add(config.tf_data.posx);
+    hasher.add(config.tf_data.posy);
+    hasher.add(config.coeff_r);
+    hasher.add(config.coeff_g);
+    hasher.add(config.coeff_b);
+    hasher.add(config.rng_x_min);
+    hasher.add(config.rng_x_max);
+    hasher.add(config.rng_y_min);
+    hasher.add(config.rng_y_max);
+}
+
+static void addConfig(SignatureHasher &hasher, const IDpp::OetfData::ConfigType &config)
+{
+    hasher.add(config.tf_data.posx);
+    hasher.add(config.tf_data.posy);
+}
+
+/* Adds a stage to a signature, false if the stage is enabled without config */
+template<typename StageDataType>
+static bool addStage(SignatureHasher &hasher, const StageDataType &stage)
+{
+    hasher.add(stage.enable);
+    if (!stage.enable)
+        return true;
+    if (stage.config == nullptr)
+        return false;
+    addConfig(hasher, *stage.config);
+    return true;
+}
+
+/* 0 if the signature is unknown, which matches no other */
+static uint64_t getDqeSignature(const IDqe &dqe)
+{
+    SignatureHasher hasher;
+
+    if (!addStage(hasher, dqe.DqeControl()) || !addStage(hasher, dqe.GammaMatrix()) ||
+        !addStage(hasher, dqe.DegammaLut()) || !addStage(hasher, dqe.LinearMatrix()) ||
+        !addStage(hasher, dqe.Cgc()) || !addStage(hasher, dqe.RegammaLut()))
+        return 0;
+    return hasher.get();
+}
+
+static uint64_t getDppSignature(const IDpp &dpp)
+{
+    SignatureHasher hasher;
+
+    if (!addStage(hasher, dpp.EotfLut()) || !addStage(hasher, dpp.Gm()) ||
+        !addStage(hasher, dpp.Dtm()) || !addStage(hasher, dpp.OetfLut()))
+        return 0;
+    return hasher.get();
+}
+
+/* The data of a stage is applied without setting its property again */
+template<typename StageDataType>
+static void notifyIfDirty(const StageDataType &stage)
+{
+    if (stage.enable && stage.dirty)
+        stage.NotifyDataApplied();
+}
+
 /////////////////////////////////////////////////// ExynosDisplayDrmInterfaceModule //////////////////////////////////////////////////////////////////
 ExynosDisplayDrmInterfaceModule::ExynosDisplayDrmInterfaceModule(ExynosDisplay *exynosDisplay)
 : ExynosDisplayDrmInterface(exynosDisplay)
@@ -75,7 +257,8 @@ int32_t ExynosDisplayDrmInterfaceModule::initDrmDevice(DrmDevice *drmDevice)
     if (isPrimary() == false)
         return ret;
 
-    mOldDqeBlobs.init(drmDevice);
+    mBlobCache.init(drmDevice);
+    mOldDqeBlobs.init(&mBlobCache);
 
     ExynosPrimaryDisplayModule* display =
         (ExynosPrimaryDisplayModule*)mExynosDisplay;
@@ -92,19 +275,206 @@ int32_t ExynosDisplayDrmInterfaceModule::initDrmDevice(DrmDevice *drmDevice)
     return ret;
 }
 
-void ExynosDisplayDrmInterfaceModule::destroyOldBlobs(
-        std::vector<uint32_t> &oldBlobs)
+uint64_t ExynosDisplayDrmInterfaceModule::getFrameDqeSignature(const IDqe &dqe)
+{
+    if (mFrameDqeSignature == 0)
+        mFrameDqeSignature = getDqeSignature(dqe);
+    return mFrameDqeSignature;
+}
+
+uint64_t ExynosDisplayDrmInterfaceModule::getFrameDppSignature(size_t dppIndex, const IDpp &dpp)
+{
+    if (dppIndex >= mFrameDppSignatures.size())
+        mFrameDppSignatures.resize(dppIndex + 1, 0);
+    if (mFrameDppSignatures[dppIndex] == 0)
+        mFrameDppSignatures[dppIndex] = getDppSignature(dpp);
+    return mFrameDppSignatures[dppIndex];
+}
+
+void ExynosDisplayDrmInterfaceModule::colorSettingDelivered(bool committed)
+{
+    if (isPrimary() == false)
+        return;
+
+    /* the kernel may not have the properties of the frame */
+    if (!committed) {
+        mDqeSignature = 0;
+        for (auto &dppBlobs : mOldDppBlobs) {
+            dppBlobs.signature = 0;
+        }
+    }
+
+    /* the committed state holds its own references to the blobs it uses */
+    mBlobWorkers.join();
+    for (auto blobId : mPreparedBlobs) {
+        mBlobCache.release(blobId);
+    }
+    mPreparedBlobs.clear();
+    mBlobCache.destroyEvicted();
+
+    /* blob creations are ioctls, hits are creations saved by the cache */
+    BlobCache::FrameStats stats = mBlobCache.takeFrameStats();
+    ATRACE_INT("ColorBlobCreates", stats.creates);
+    ATRACE_INT64("ColorBlobCreateBytes", stats.createBytes);
+    ATRACE_INT("ColorBlobHits", stats.hits);
+    ATRACE_INT64("ColorSettingUs", mColorSettingUs);
+    mColorSettingUs = 0;
+
+    if (--mColorBlobCheckCountdown == 0) {
+        mColorBlobCheckCountdown = kColorBlobCheckFrames;
+        std::string leaks;
+        if (!checkColorBlobs(leaks)) {
+            mColorBlobCheckFailures++;
+            ALOGE("color blob leak:\n%s", leaks.c_str());
+        }
+    }
+}
+
+bool ExynosDisplayDrmInterfaceModule::checkColorBlobs(std::string &result)
 {
-    for (auto &blob : oldBlobs) {
-        mDrmDevice->DestroyPropertyBlob(blob);
+    /* the references held by the module, by blob */
+    std::unordered_map<uint32_t, uint32_t> heldRefs;
+    for (uint32_t type = 0; type < DqeBlobs::DQE_BLOB_NUM; type++) {
+        if (uint32_t blobId = mOldDqeBlobs.getBlob(type))
+            heldRefs[blobId]++;
+    }
+    for (auto &dppBlobs : mOldDppBlobs) {
+        for (uint32_t type = 0; type < DppBlobs::DPP_BLOB_NUM; type++) {
+            if (uint32_t blobId = dppBlobs.getBlob(type))
+                heldRefs[blobId]++;
+        }
+    }
+    for (auto blobId : mPreparedBlobs) {
+        if (blobId)
+            heldRefs[blobId]++;
     }
-    oldBlobs.clear();
+
+    return mBlobCache.check(heldRefs, result);
+}
+
+void ExynosDisplayDrmInterfaceModule::dumpColorBlobs(std::string &result)
+{
+    if (isPrimary() == false)
+        return;
+
+    mBlobCache.dump(result);
+
+    android::base::StringAppendF(&result, "  crtc %d:", mDrmCrtc->id());
+    for (uint32_t type = 0; type < DqeBlobs::DQE_BLOB_NUM; type++) {
+        android::base::StringAppendF(&result, " %s %d", DqeBlobs::kNames[type],
+                mOldDqeBlobs.getBlob(type));
+    }
+    result.append("\n");
+    for (auto &dppBlobs : mOldDppBlobs) {
+        android::base::StringAppendF(&result, "  plane %d:", dppBlobs.planeId);
+        for (uint32_t type = 0; type < DppBlobs::DPP_BLOB_NUM; type++) {
+            android::base::StringAppendF(&result, " %s %d", DppBlobs::kNames[type],
+                    dppBlobs.getBlob(type));
+        }
+        result.append("\n");
+    }
+
+    std::string leaks;
+    bool ok = checkColorBlobs(leaks);
+    android::base::StringAppendF(&result, "  leak check: %s, %d periodic checks failed\n",
+            ok ? "ok" : "failed", mColorBlobCheckFailures);
+    result.append(leaks);
+}
+
+void ExynosDisplayDrmInterfaceModule::prepareColorBlobs()
+{
+    if (isPrimary() == false)
+        return;
+    if (!mForceDisplayColorSetting && !mColorSettingChanged)
+        return;
+
+    ScopedTimer timer(mColorSettingUs);
+    ExynosPrimaryDisplayModule* display =
+        (ExynosPrimaryDisplayModule*)mExynosDisplay;
+    std::vector<BlobWorkers::Job> jobs;
+
+    /* mPreparedBlobs is not resized once the jobs run */
+    auto addJob = [&](auto create, const auto &data, const auto &stage, bool force,
+            uint32_t avoidBlobId = 0) {
+        if (!stage.enable || (!stage.dirty && !force))
+            return;
+        size_t slot = mPreparedBlobs.size();
+        mPreparedBlobs.push_back(0);
+        jobs.push_back([this, create, &data, slot, avoidBlobId] {
+            (this->*create)(data, mPreparedBlobs[slot], avoidBlobId);
+        });
+    };
+
+    /* the stages setDisplayColorSetting() and setPlaneColorSetting() set */
+    const IDisplayColorGS101::IDqe &dqe = display->getDqe();
+    bool force = mForceDisplayColorSetting || (mDqeSignature == 0);
+    uint64_t dqeSignature = getFrameDqeSignature(dqe);
+    /* setDisplayColorSetting() sets no new blob for the data of the last commit */
+    if (mForceDisplayColorSetting || (dqeSignature == 0) || (dqeSignature != mDqeSignature)) {
+        /* a forced setting gets new blobs, see setDisplayColorBlob() */
+        auto avoid = [&](uint32_t type) {
+            return mForceDisplayColorSetting ? mOldDqeBlobs.getBlob(type) : 0;
+        };
+        if (mDrmCrtc->cgc_lut_property().id())
+            addJob(&ExynosDisplayDrmInterfaceModule::createCgcBlobFromIDqe, dqe, dqe.Cgc(),
+                    force, avoid(DqeBlobs::CGC));
+        if (mDrmCrtc->degamma_lut_property().id())
+            addJob(&ExynosDisplayDrmInterfaceModule::createDegammaLutBlobFromIDqe, dqe,
+                    dqe.DegammaLut(), force, avoid(DqeBlobs::DEGAMMA_LUT));
+        if (mDrmCrtc->gamma_lut_property().id())
+            addJob(&ExynosDisplayDrmInterfaceModule::createRegammaLutBlobFromIDqe, dqe,
+                    dqe.RegammaLut(), force, avoid(DqeBlobs::REGAMMA_LUT));
+        if (mDrmCrtc->gamma_matrix_property().id())
+            addJob(&ExynosDisplayDrmInterfaceModule::createGammaMatBlobFromIDqe, dqe,
+                    dqe.GammaMatrix(), force, avoid(DqeBlobs::GAMMA_MAT));
+        if (mDrmCrtc->linear_matrix_property().id())
+            addJob(&ExynosDisplayDrmInterfaceModule::createLinearMatBlobFromIDqe, dqe,
+                    dqe.LinearMatrix(), force, avoid(DqeBlobs::LINEAR_MAT));
+        if (mDrmCrtc->disp_dither_property().id())
+            addJob(&ExynosDisplayDrmInterfaceModule::createDispDitherBlobFromIDqe, dqe,
+                    dqe.DqeControl(), force, avoid(DqeBlobs::DISP_DITHER));
+        if (mDrmCrtc->cgc_dither_property().id())
+            addJob(&ExynosDisplayDrmInterfaceModule::createCgcDitherBlobFromIDqe, dqe,
+                    dqe.DqeControl(), force, avoid(DqeBlobs::CGC_DITHER));
+    }
+
+    /*
+     * setPlaneColorSetting() sets every stage of a plane with other data.
+     * The blobs a forced setting avoids depend on the plane, which is not
+     * known here.
+     */
+    size_t dppCount = mForceDisplayColorSetting ? 0 : display->getNumOfDpp();
+    for (size_t i = 0; i < dppCount; i++) {
+        const IDisplayColorGS101::IDpp &dpp = display->getDpp(i);
+        /* likely still set to its plane */
+        uint64_t dppSignature = getFrameDppSignature(i, dpp);
+        if ((dppSignature != 0) &&
+            std::any_of(mOldDppBlobs.begin(), mOldDppBlobs.end(),
+                    [dppSignature](const DppBlobs &dppBlobs) {
+                        return dppBlobs.signature == dppSignature;
+                    }))
+            continue;
+        addJob(&ExynosDisplayDrmInterfaceModule::createEotfBlobFromIDpp, dpp,
+                dpp.EotfLut(), true);
+        addJob(&ExynosDisplayDrmInterfaceModule::createGmBlobFromIDpp, dpp, dpp.Gm(), true);
+        addJob(&ExynosDisplayDrmInterfaceModule::createDtmBlobFromIDpp, dpp, dpp.Dtm(), true);
+        addJob(&ExynosDisplayDrmInterfaceModule::createOetfBlobFromIDpp, dpp,
+                dpp.OetfLut(), true);
+    }
+
+    /* a single blob is as fast to create where it is set */
+    if (jobs.size() < 2) {
+        mPreparedBlobs.clear();
+        return;
+    }
+    ATRACE_INT("ColorBlobJobs", jobs.size());
+    mBlobWorkers.run(std::move(jobs));
 }
 
 int32_t ExynosDisplayDrmInterfaceModule::createCgcBlobFromIDqe(
-        const IDisplayColorGS101::IDqe &dqe, uint32_t &blobId)
+        const IDisplayColorGS101::IDqe &dqe, uint32_t &blobId,
+        uint32_t avoidBlobId)
 {
-    struct cgc_lut cgc;
     const IDisplayColorGS101::IDqe::CgcData &cgcData = dqe.Cgc();
 
     if (cgcData.config == nullptr) {
@@ -112,22 +482,9 @@ int32_t ExynosDisplayDrmInterfaceModule::createCgcBlobFromIDqe(
         return -EINVAL;
     }
 
-    if ((cgcData.config->r_values.size() != DRM_SAMSUNG_CGC_LUT_REG_CNT) ||
-        (cgcData.config->g_values.size() != DRM_SAMSUNG_CGC_LUT_REG_CNT) ||
-        (cgcData.config->b_values.size() != DRM_SAMSUNG_CGC_LUT_REG_CNT)) {
-        ALOGE("CGC data size is not same (r: %zu, g: %zu: b: %zu)",
-                cgcData.config->r_values.size(),
-                cgcData.config->g_values.size(),
-                cgcData.config->b_values.size());
-        return -EINVAL;
-    }
-
-    for (uint32_t i = 0; i < DRM_SAMSUNG_CGC_LUT_REG_CNT; i++) {
-        cgc.r_values[i] = cgcData.config->r_values[i];
-        cgc.g_values[i] = cgcData.config->g_values[i];
-        cgc.b_values[i] = cgcData.config->b_values[i];
-    }
-    int ret = mDrmDevice->CreatePropertyBlob(&cgc, sizeof(cgc_lut), &blobId);
+    /* The layout of the config is checked against struct cgc_lut at compile time */
+    int ret = mBlobCache.acquire(DqeBlobs::kNames[DqeBlobs::CGC], cgcData.config,
+            sizeof(cgc_lut), blobId, avoidBlobId);
     if (ret) {
         HWC_LOGE(mExynosDisplay, "Failed to create cgc blob %d", ret);
         return ret;
@@ -136,7 +493,8 @@ int32_t ExynosDisplayDrmInterfaceModule::createCgcBlobFromIDqe(
 }
 
 int32_t ExynosDisplayDrmInterfaceModule::createDegammaLutBlobFromIDqe(
-        const IDisplayColorGS101::IDqe &dqe, uint32_t &blobId)
+        const IDisplayColorGS101::IDqe &dqe, uint32_t &blobId,
+        uint32_t avoidBlobId)
 {
     int ret = 0;
     uint64_t lut_size = 0;
@@ -158,11 +516,13 @@ int32_t ExynosDisplayDrmInterfaceModule::createDegammaLutBlobFromIDqe(
         return -EINVAL;
     }
 
-    struct drm_color_lut color_lut[IDisplayColorGS101::IDqe::DegammaLutData::ConfigType::kLutLen];
+    struct drm_color_lut
+            color_lut[IDisplayColorGS101::IDqe::DegammaLutData::ConfigType::kLutLen] = {};
     for (uint32_t i = 0; i < lut_size; i++) {
         color_lut[i].red = dqe.DegammaLut().config->values[i];
     }
-    ret = mDrmDevice->CreatePropertyBlob(color_lut, sizeof(color_lut), &blobId);
+    ret = mBlobCache.acquire(DqeBlobs::kNames[DqeBlobs::DEGAMMA_LUT], color_lut,
+            sizeof(color_lut), blobId, avoidBlobId);
     if (ret) {
         HWC_LOGE(mExynosDisplay, "Failed to create degamma lut blob %d", ret);
         return ret;
@@ -171,7 +531,8 @@ int32_t ExynosDisplayDrmInterfaceModule::createDegammaLutBlobFromIDqe(
 }
 
 int32_t ExynosDisplayDrmInterfaceModule::createRegammaLutBlobFromIDqe(
-        const IDisplayColorGS101::IDqe &dqe, uint32_t &blobId)
+        const IDisplayColorGS101::IDqe &dqe, uint32_t &blobId,
+        uint32_t avoidBlobId)
 {
     int ret = 0;
     uint64_t lut_size = 0;
@@ -193,13 +554,15 @@ int32_t ExynosDisplayDrmInterfaceModule::createRegammaLutBlobFromIDqe(
         return -EINVAL;
     }
 
-    struct drm_color_lut color_lut[IDisplayColorGS101::IDqe::DegammaLutData::ConfigType::kLutLen];
+    struct drm_color_lut
+            color_lut[IDisplayColorGS101::IDqe::DegammaLutData::ConfigType::kLutLen] = {};
     for (uint32_t i = 0; i < lut_size; i++) {
         color_lut[i].red = dqe.RegammaLut().config->r_values[i];
         color_lut[i].green = dqe.RegammaLut().config->g_values[i];
         color_lut[i].blue = dqe.RegammaLut().config->b_values[i];
     }
-    ret = mDrmDevice->CreatePropertyBlob(color_lut, sizeof(color_lut), &blobId);
+    ret = mBlobCache.acquire(DqeBlobs::kNames[DqeBlobs::REGAMMA_LUT], color_lut,
+            sizeof(color_lut), blobId, avoidBlobId);
     if (ret) {
         HWC_LOGE(mExynosDisplay, "Failed to create gamma lut blob %d", ret);
         return ret;
@@ -208,17 +571,19 @@ int32_t ExynosDisplayDrmInterfaceModule::createRegammaLutBlobFromIDqe(
 }
 
 int32_t ExynosDisplayDrmInterfaceModule::createGammaMatBlobFromIDqe(
-        const IDisplayColorGS101::IDqe &dqe, uint32_t &blobId)
+        const IDisplayColorGS101::IDqe &dqe, uint32_t &blobId,
+        uint32_t avoidBlobId)
 {
     int ret = 0;
-    struct exynos_matrix gamma_matrix;
+    struct exynos_matrix gamma_matrix = {};
     if ((ret = convertDqeMatrixDataToMatrix(
                     dqe.GammaMatrix().config->matrix_data, gamma_matrix, DRM_SAMSUNG_MATRIX_DIMENS)) != NO_ERROR)
     {
         HWC_LOGE(mExynosDisplay, "Failed to convert gamma matrix");
         return ret;
     }
-    ret = mDrmDevice->CreatePropertyBlob(&gamma_matrix, sizeof(gamma_matrix), &blobId);
+    ret = mBlobCache.acquire(DqeBlobs::kNames[DqeBlobs::GAMMA_MAT], &gamma_matrix,
+            sizeof(gamma_matrix), blobId, avoidBlobId);
     if (ret) {
         HWC_LOGE(mExynosDisplay, "Failed to create gamma matrix blob %d", ret);
         return ret;
@@ -228,17 +593,19 @@ int32_t ExynosDisplayDrmInterfaceModule::createGammaMatBlobFromIDqe(
 }
 
 int32_t ExynosDisplayDrmInterfaceModule::createLinearMatBlobFromIDqe(
-        const IDisplayColorGS101::IDqe &dqe, uint32_t &blobId)
+        const IDisplayColorGS101::IDqe &dqe, uint32_t &blobId,
+        uint32_t avoidBlobId)
 {
     int ret = 0;
-    struct exynos_matrix linear_matrix;
+    struct exynos_matrix linear_matrix = {};
     if ((ret = convertDqeMatrixDataToMatrix(
                     dqe.LinearMatrix().config->matrix_data, linear_matrix, DRM_SAMSUNG_MATRIX_DIMENS)) != NO_ERROR)
     {
         HWC_LOGE(mExynosDisplay, "Failed to convert linear matrix");
         return ret;
     }
-    ret = mDrmDevice->CreatePropertyBlob(&linear_matrix, sizeof(linear_matrix), &blobId);
+    ret = mBlobCache.acquire(DqeBlobs::kNames[DqeBlobs::LINEAR_MAT], &linear_matrix,
+            sizeof(linear_matrix), blobId, avoidBlobId);
     if (ret) {
         HWC_LOGE(mExynosDisplay, "Failed to create linear matrix blob %d", ret);
         return ret;
@@ -248,7 +615,8 @@ int32_t ExynosDisplayDrmInterfaceModule::createLinearMatBlobFromIDqe(
 }
 
 int32_t ExynosDisplayDrmInterfaceModule::createDispDitherBlobFromIDqe(
-        const IDisplayColorGS101::IDqe &dqe, uint32_t &blobId)
+        const IDisplayColorGS101::IDqe &dqe, uint32_t &blobId,
+        uint32_t avoidBlobId)
 {
     int ret = 0;
     const IDisplayColorGS101::IDqe::DqeControlData& dqeControl = dqe.DqeControl();
@@ -257,8 +625,9 @@ int32_t ExynosDisplayDrmInterfaceModule::createDispDitherBlobFromIDqe(
         return ret;
     }
 
-    ret = mDrmDevice->CreatePropertyBlob((void*)&dqeControl.config->disp_dither_reg,
-            sizeof(dqeControl.config->disp_dither_reg), &blobId);
+    ret = mBlobCache.acquire(DqeBlobs::kNames[DqeBlobs::DISP_DITHER],
+            (void*)&dqeControl.config->disp_dither_reg,
+            sizeof(dqeControl.config->disp_dither_reg), blobId, avoidBlobId);
     if (ret) {
         HWC_LOGE(mExynosDisplay, "Failed to create disp dither blob %d", ret);
         return ret;
@@ -268,7 +637,8 @@ int32_t ExynosDisplayDrmInterfaceModule::createDispDitherBlobFromIDqe(
 }
 
 int32_t ExynosDisplayDrmInterfaceModule::createCgcDitherBlobFromIDqe(
-        const IDisplayColorGS101::IDqe &dqe, uint32_t &blobId)
+        const IDisplayColorGS101::IDqe &dqe, uint32_t &blobId,
+        uint32_t avoidBlobId)
 {
     int ret = 0;
     const IDisplayColorGS101::IDqe::DqeControlData& dqeControl = dqe.DqeControl();
@@ -277,8 +647,9 @@ int32_t ExynosDisplayDrmInterfaceModule::createCgcDitherBlobFromIDqe(
         return ret;
     }
 
-    ret = mDrmDevice->CreatePropertyBlob((void*)&dqeControl.config->cgc_dither_reg,
-            sizeof(dqeControl.config->cgc_dither_reg), &blobId);
+    ret = mBlobCache.acquire(DqeBlobs::kNames[DqeBlobs::CGC_DITHER],
+            (void*)&dqeControl.config->cgc_dither_reg,
+            sizeof(dqeControl.config->cgc_dither_reg), blobId, avoidBlobId);
     if (ret) {
         HWC_LOGE(mExynosDisplay, "Failed to create disp dither blob %d", ret);
         return ret;
@@ -287,9 +658,10 @@ int32_t ExynosDisplayDrmInterfaceModule::createCgcDitherBlobFromIDqe(
 }
 
 int32_t ExynosDisplayDrmInterfaceModule::createEotfBlobFromIDpp(
-        const IDisplayColorGS101::IDpp &dpp, uint32_t &blobId)
+        const IDisplayColorGS101::IDpp &dpp, uint32_t &blobId,
+        uint32_t avoidBlobId)
 {
-    struct hdr_eotf_lut eotf_lut;
+    struct hdr_eotf_lut eotf_lut = {};
 
     if (dpp.EotfLut().config == nullptr) {
         ALOGE("no dpp eotf config");
@@ -308,7 +680,8 @@ int32_t ExynosDisplayDrmInterfaceModule::createEotfBlobFromIDpp(
         eotf_lut.posx[i] = dpp.EotfLut().config->tf_data.posx[i];
         eotf_lut.posy[i] = dpp.EotfLut().config->tf_data.posy[i];
     }
-    int ret = mDrmDevice->CreatePropertyBlob(&eotf_lut, sizeof(eotf_lut), &blobId);
+    int ret = mBlobCache.acquire(DppBlobs::kNames[DppBlobs::EOTF], &eotf_lut,
+            sizeof(eotf_lut), blobId, avoidBlobId);
     if (ret) {
         HWC_LOGE(mExynosDisplay, "Failed to create eotf lut blob %d", ret);
         return ret;
@@ -317,10 +690,11 @@ int32_t ExynosDisplayDrmInterfaceModule::createEotfBlobFromIDpp(
 }
 
 int32_t ExynosDisplayDrmInterfaceModule::createGmBlobFromIDpp(
-        const IDisplayColorGS101::IDpp &dpp, uint32_t &blobId)
+        const IDisplayColorGS101::IDpp &dpp, uint32_t &blobId,
+        uint32_t avoidBlobId)
 {
     int ret = 0;
-    struct hdr_gm_data gm_matrix;
+    struct hdr_gm_data gm_matrix = {};
 
     if (dpp.Gm().config == nullptr) {
         ALOGE("no dpp GM config");
@@ -333,7 +707,8 @@ int32_t ExynosDisplayDrmInterfaceModule::createGmBlobFromIDpp(
         HWC_LOGE(mExynosDisplay, "Failed to convert gm matrix");
         return ret;
     }
-    ret = mDrmDevice->CreatePropertyBlob(&gm_matrix, sizeof(gm_matrix), &blobId);
+    ret = mBlobCache.acquire(DppBlobs::kNames[DppBlobs::GM], &gm_matrix,
+            sizeof(gm_matrix), blobId, avoidBlobId);
     if (ret) {
         HWC_LOGE(mExynosDisplay, "Failed to create gm matrix blob %d", ret);
         return ret;
@@ -342,9 +717,10 @@ int32_t ExynosDisplayDrmInterfaceModule::createGmBlobFromIDpp(
 }
 
 int32_t ExynosDisplayDrmInterfaceModule::createDtmBlobFromIDpp(
-        const IDisplayColorGS101::IDpp &dpp, uint32_t &blobId)
+        const IDisplayColorGS101::IDpp &dpp, uint32_t &blobId,
+        uint32_t avoidBlobId)
 {
-    struct hdr_tm_data tm_data;
+    struct hdr_tm_data tm_data = {};
 
     if (dpp.Dtm().config == nullptr) {
         ALOGE("no dpp DTM config");
@@ -372,7 +748,8 @@ int32_t ExynosDisplayDrmInterfaceModule::createDtmBlobFromIDpp(
     tm_data.rng_y_min = dpp.Dtm().config->rng_y_min;
     tm_data.rng_y_max = dpp.Dtm().config->rng_y_max;
 
-    int ret = mDrmDevice->CreatePropertyBlob(&tm_data, sizeof(tm_data), &blobId);
+    int ret = mBlobCache.acquire(DppBlobs::kNames[DppBlobs::DTM], &tm_data,
+            sizeof(tm_data), blobId, avoidBlobId);
     if (ret) {
         HWC_LOGE(mExynosDisplay, "Failed to create tm_data blob %d", ret);
         return ret;
@@ -381,9 +758,10 @@ int32_t ExynosDisplayDrmInterfaceModule::createDtmBlobFromIDpp(
     return NO_ERROR;
 }
 int32_t ExynosDisplayDrmInterfaceModule::createOetfBlobFromIDpp(
-        const IDisplayColorGS101::IDpp &dpp, uint32_t &blobId)
+        const IDisplayColorGS101::IDpp &dpp, uint32_t &blobId,
+        uint32_t avoidBlobId)
 {
-    struct hdr_oetf_lut oetf_lut;
+    struct hdr_oetf_lut oetf_lut = {};
 
     if (dpp.OetfLut().config == nullptr) {
         ALOGE("no dpp OETF config");
@@ -402,7 +780,8 @@ int32_t ExynosDisplayDrmInterfaceModule::createOetfBlobFromIDpp(
         oetf_lut.posx[i] = dpp.OetfLut().config->tf_data.posx[i];
         oetf_lut.posy[i] = dpp.OetfLut().config->tf_data.posy[i];
     }
-    int ret = mDrmDevice->CreatePropertyBlob(&oetf_lut, sizeof(oetf_lut), &blobId);
+    int ret = mBlobCache.acquire(DppBlobs::kNames[DppBlobs::OETF], &oetf_lut,
+            sizeof(oetf_lut), blobId, avoidBlobId);
     if (ret) {
         HWC_LOGE(mExynosDisplay, "Failed to create oetf lut blob %d", ret);
         return ret;
@@ -416,39 +795,45 @@ int32_t ExynosDisplayDrmInterfaceModule::setDisplayColorBlob(
         const uint32_t type,
         const StageDataType &stage,
         const IDisplayColorGS101::IDqe &dqe,
-        ExynosDisplayDrmInterface::DrmModeAtomicReq &drmReq)
+        ExynosDisplayDrmInterface::DrmModeAtomicReq &drmReq,
+        bool forceUpdate)
 {
     /* dirty bit is valid only if enable is true */
     if (!prop.id())
         return NO_ERROR;
-    if (!mForceDisplayColorSetting && stage.enable && !stage.dirty)
+    if (!forceUpdate && stage.enable && !stage.dirty)
         return NO_ERROR;
 
     int32_t ret = 0;
     uint32_t blobId = 0;
+    /*
+     * The kernel does not apply a property set to its current blob again:
+     * a forced setting, as for a readback, needs new blobs.
+     */
+    uint32_t avoidBlobId = mForceDisplayColorSetting ? mOldDqeBlobs.getBlob(type) : 0;
 
     if (stage.enable) {
         switch (type) {
             case DqeBlobs::CGC:
-                ret = createCgcBlobFromIDqe(dqe, blobId);
+                ret = createCgcBlobFromIDqe(dqe, blobId, avoidBlobId);
                 break;
             case DqeBlobs::DEGAMMA_LUT:
-                ret = createDegammaLutBlobFromIDqe(dqe, blobId);
+                ret = createDegammaLutBlobFromIDqe(dqe, blobId, avoidBlobId);
                 break;
             case DqeBlobs::REGAMMA_LUT:
-                ret = createRegammaLutBlobFromIDqe(dqe, blobId);
+                ret = createRegammaLutBlobFromIDqe(dqe, blobId, avoidBlobId);
                 break;
             case DqeBlobs::GAMMA_MAT:
-                ret = createGammaMatBlobFromIDqe(dqe, blobId);
+                ret = createGammaMatBlobFromIDqe(dqe, blobId, avoidBlobId);
                 break;
             case DqeBlobs::LINEAR_MAT:
-                ret = createLinearMatBlobFromIDqe(dqe, blobId);
+                ret = createLinearMatBlobFromIDqe(dqe, blobId, avoidBlobId);
                 break;
             case DqeBlobs::DISP_DITHER:
-                ret = createDispDitherBlobFromIDqe(dqe, blobId);
+                ret = createDispDitherBlobFromIDqe(dqe, blobId, avoidBlobId);
                 break;
             case DqeBlobs::CGC_DITHER:
-                ret = createCgcDitherBlobFromIDqe(dqe, blobId);
+                ret = createCgcDitherBlobFromIDqe(dqe, blobId, avoidBlobId);
                 break;
             default:
                 ret = -EINVAL;
@@ -460,12 +845,13 @@ int32_t ExynosDisplayDrmInterfaceModule::setDisplayColorBlob(
     }
 
     /* Skip setting when previous and current setting is same with 0 */
-    if ((blobId == 0) && (mOldDqeBlobs.getBlob(type) == 0))
+    if ((blobId == 0) && (mOldDqeBlobs.getBlob(type) == 0) && !forceUpdate)
         return ret;
 
     if ((ret = drmReq.atomicAddProperty(mDrmCrtc->id(), prop, blobId)) < 0) {
         HWC_LOGE(mExynosDisplay, "%s: Fail to set property",
                 __func__);
+        mBlobCache.release(blobId);
         return ret;
     }
     mOldDqeBlobs.addBlob(type, blobId);
@@ -482,54 +868,79 @@ int32_t ExynosDisplayDrmInterfaceModule::setDisplayColorSetting(
 {
     if (isPrimary() == false)
         return NO_ERROR;
-    if (!mForceDisplayColorSetting && !mColorSettingChanged)
-        return NO_ERROR;
 
+    ScopedTimer timer(mColorSettingUs);
     ExynosPrimaryDisplayModule* display =
         (ExynosPrimaryDisplayModule*)mExynosDisplay;
 
     int ret = NO_ERROR;
     const IDisplayColorGS101::IDqe &dqe = display->getDqe();
 
+    /*
+     * Same data as the last commit: the kernel keeps the properties. This
+     * is checked even if the color setting did not change, as the last
+     * commit may have failed.
+     */
+    uint64_t signature = getFrameDqeSignature(dqe);
+    if (!mForceDisplayColorSetting && (signature != 0) && (signature == mDqeSignature)) {
+        notifyIfDirty(dqe.Cgc());
+        notifyIfDirty(dqe.DegammaLut());
+        notifyIfDirty(dqe.RegammaLut());
+        notifyIfDirty(dqe.GammaMatrix());
+        notifyIfDirty(dqe.LinearMatrix());
+        dqe.DqeControl().NotifyDataApplied();
+        return NO_ERROR;
+    }
+    /*
+     * The dirty bits tell what changed since the last commit, unless the
+     * committed data is unknown: then every stage is set.
+     */
+    bool forceUpdate = mForceDisplayColorSetting || (mDqeSignature == 0);
+    /* valid again once all the properties are set */
+    mDqeSignature = 0;
+
+    /* the prepared blobs are found in the cache from here */
+    mBlobWorkers.join();
+
     if ((ret = setDisplayColorBlob(mDrmCrtc->cgc_lut_property(),
                 static_cast<uint32_t>(DqeBlobs::CGC),
-                dqe.Cgc(), dqe, drmReq) != NO_ERROR)) {
+                dqe.Cgc(), dqe, drmReq, forceUpdate) != NO_ERROR)) {
         HWC_LOGE(mExynosDisplay, "%s: set Cgc blob fail", __func__);
         return ret;
     }
     if ((ret = setDisplayColorBlob(mDrmCrtc->degamma_lut_property(),
                 static_cast<uint32_t>(DqeBlobs::DEGAMMA_LUT),
-                dqe.DegammaLut(), dqe, drmReq) != NO_ERROR)) {
+                dqe.DegammaLut(), dqe, drmReq, forceUpdate) != NO_ERROR)) {
         HWC_LOGE(mExynosDisplay, "%s: set DegammaLut blob fail", __func__);
         return ret;
     }
     if ((ret = setDisplayColorBlob(mDrmCrtc->gamma_lut_property(),
                 static_cast<uint32_t>(DqeBlobs::REGAMMA_LUT),
-                dqe.RegammaLut(), dqe, drmReq) != NO_ERROR)) {
+                dqe.RegammaLut(), dqe, drmReq, forceUpdate) != NO_ERROR)) {
         HWC_LOGE(mExynosDisplay, "%s: set RegammaLut blob fail", __func__);
         return ret;
     }
     if ((ret = setDisplayColorBlob(mDrmCrtc->gamma_matrix_property(),
                 static_cast<uint32_t>(DqeBlobs::GAMMA_MAT),
-                dqe.GammaMatrix(), dqe, drmReq) != NO_ERROR)) {
+                dqe.GammaMatrix(), dqe, drmReq, forceUpdate) != NO_ERROR)) {
         HWC_LOGE(mExynosDisplay, "%s: set GammaMatrix blob fail", __func__);
         return ret;
     }
     if ((ret = setDisplayColorBlob(mDrmCrtc->linear_matrix_property(),
                 static_cast<uint32_t>(DqeBlobs::LINEAR_MAT),
-                dqe.LinearMatrix(), dqe, drmReq) != NO_ERROR)) {
+                dqe.LinearMatrix(), dqe, drmReq, forceUpdate) != NO_ERROR)) {
         HWC_LOGE(mExynosDisplay, "%s: set LinearMatrix blob fail", __func__);
         return ret;
     }
     if ((ret = setDisplayColorBlob(mDrmCrtc->disp_dither_property(),
                 static_cast<uint32_t>(DqeBlobs::DISP_DITHER),
-                dqe.DqeControl(), dqe, drmReq) != NO_ERROR)) {
+                dqe.DqeControl(), dqe, drmReq, forceUpdate) != NO_ERROR)) {
         HWC_LOGE(mExynosDisplay, "%s: set DispDither blob fail", __func__);
         return ret;
     }
     if ((ret = setDisplayColorBlob(mDrmCrtc->cgc_dither_property(),
                 static_cast<uint32_t>(DqeBlobs::CGC_DITHER),
-                dqe.DqeControl(), dqe, drmReq) != NO_ERROR)) {
+                dqe.DqeControl(), dqe, drmReq, forceUpdate) != NO_ERROR)) {
         HWC_LOGE(mExynosDisplay, "%s: set CgcDither blob fail", __func__);
         return ret;
     }
@@ -554,6 +965,7 @@ int32_t ExynosDisplayDrmInterfaceModule::setDisplayColorSetting(
         }
     }
     dqe.DqeControl().NotifyDataApplied();
+    mDqeSignature = signature;
 
     return NO_ERROR;
 }
@@ -565,42 +977,30 @@ int32_t ExynosDisplayDrmInterfaceModule::setPlaneColorBlob(
         const uint32_t type,
         const StageDataType &stage,
         const IDisplayColorGS101::IDpp &dpp,
-        const uint32_t dppIndex,
-        ExynosDisplayDrmInterface::DrmModeAtomicReq &drmReq,
-        bool forceUpdate)
+        DppBlobs &oldDppBlobs,
+        ExynosDisplayDrmInterface::DrmModeAtomicReq &drmReq)
 {
-    /* dirty bit is valid only if enable is true */
-    if (!prop.id() || (stage.enable && !stage.dirty && !forceUpdate))
+    if (!prop.id())
         return NO_ERROR;
 
-    uint32_t ix = 0;
-    for (;ix < mOldDppBlobs.size(); ix++) {
-        if (mOldDppBlobs[ix].planeId == plane->id()) {
-            break;
-        }
-    }
-    if (ix >= mOldDppBlobs.size()) {
-        HWC_LOGE(mExynosDisplay, "%s: could not find plane %d", __func__, plane->id());
-        return -EINVAL;
-    }
-    DppBlobs &oldDppBlobs = mOldDppBlobs[ix];
-
     int32_t ret = 0;
     uint32_t blobId = 0;
+    /* a forced setting needs new blobs, see setDisplayColorBlob() */
+    uint32_t avoidBlobId = mForceDisplayColorSetting ? oldDppBlobs.getBlob(type) : 0;
 
     if (stage.enable) {
         switch (type) {
             case DppBlobs::EOTF:
-                ret = createEotfBlobFromIDpp(dpp, blobId);
+                ret = createEotfBlobFromIDpp(dpp, blobId, avoidBlobId);
                 break;
             case DppBlobs::GM:
-                ret = createGmBlobFromIDpp(dpp, blobId);
+                ret = createGmBlobFromIDpp(dpp, blobId, avoidBlobId);
                 break;
             case DppBlobs::DTM:
-                ret = createDtmBlobFromIDpp(dpp, blobId);
+                ret = createDtmBlobFromIDpp(dpp, blobId, avoidBlobId);
                 break;
             case DppBlobs::OETF:
-                ret = createOetfBlobFromIDpp(dpp, blobId);
+                ret = createOetfBlobFromIDpp(dpp, blobId, avoidBlobId);
                 break;
             default:
                 ret = -EINVAL;
@@ -611,13 +1011,10 @@ int32_t ExynosDisplayDrmInterfaceModule::setPlaneColorBlob(
         }
     }
 
-    /* Skip setting when previous and current setting is same with 0 */
-    if ((blobId == 0) && (oldDppBlobs.getBlob(type) == 0) && !forceUpdate)
-        return ret;
-
     if ((ret = drmReq.atomicAddProperty(plane->id(), prop, blobId)) < 0) {
         HWC_LOGE(mExynosDisplay, "%s: Fail to set property",
                 __func__);
+        mBlobCache.release(blobId);
         return ret;
     }
 
@@ -632,10 +1029,11 @@ int32_t ExynosDisplayDrmInterfaceModule::setPlaneColorSetting(
         const std::unique_ptr<DrmPlane> &plane,
         const exynos_win_config_data &config)
 {
-    if ((mColorSettingChanged == false) ||
-        (isPrimary() == false))
+    if (isPrimary() == false)
         return NO_ERROR;
 
+    ScopedTimer timer(mColorSettingUs);
+
     if ((config.assignedMPP == nullptr) ||
         (config.assignedMPP->mAssignedSources.size() == 0)) {
         HWC_LOGE(mExynosDisplay, "%s:: config's mpp source size is invalid",
@@ -684,45 +1082,71 @@ int32_t ExynosDisplayDrmInterfaceModule::setPlaneColorSetting(
 
     const IDisplayColorGS101::IDpp &dpp = display->getDppForLayer(mppSource);
     const uint32_t dppIndex = static_cast<uint32_t>(display->getDppIndexForLayer(mppSource));
-    bool planeChanged = display->checkAndSaveLayerPlaneId(mppSource, plane->id());
+
+    DppBlobs *oldDppBlobs = getOldDppBlobs(plane->id());
+    if (oldDppBlobs == nullptr) {
+        HWC_LOGE(mExynosDisplay, "%s: could not find plane %d", __func__, plane->id());
+        return -EINVAL;
+    }
+
+    /*
+     * The plane has the properties of the same data, whichever layer it had.
+     * Otherwise it may have had another layer, whose dirty bits say nothing
+     * about it, so every stage is set.
+     */
+    uint64_t signature = getFrameDppSignature(dppIndex, dpp);
+    if (!mForceDisplayColorSetting && (signature != 0) &&
+        (signature == oldDppBlobs->signature)) {
+        notifyIfDirty(dpp.EotfLut());
+        notifyIfDirty(dpp.Gm());
+        notifyIfDirty(dpp.Dtm());
+        notifyIfDirty(dpp.OetfLut());
+        return NO_ERROR;
+    }
+    /* valid again once all the properties are set */
+    oldDppBlobs->signature = 0;
+
+    mBlobWorkers.join();
 
     int ret = 0;
     if ((ret = setPlaneColorBlob(plane, plane->eotf_lut_property(),
                 static_cast<uint32_t>(DppBlobs::EOTF),
-                dpp.EotfLut(), dpp, dppIndex, drmReq, planeChanged) != NO_ERROR)) {
+                dpp.EotfLut(), dpp, *oldDppBlobs, drmReq) != NO_ERROR)) {
         HWC_LOGE(mExynosDisplay, "%s: dpp[%d] set oetf blob fail",
                 __func__, dppIndex);
         return ret;
     }
     if ((ret = setPlaneColorBlob(plane, plane->gammut_matrix_property(),
                 static_cast<uint32_t>(DppBlobs::GM),
-                dpp.Gm(), dpp, dppIndex, drmReq, planeChanged) != NO_ERROR)) {
+                dpp.Gm(), dpp, *oldDppBlobs, drmReq) != NO_ERROR)) {
         HWC_LOGE(mExynosDisplay, "%s: dpp[%d] set GM blob fail",
                 __func__, dppIndex);
         return ret;
     }
     if ((ret = setPlaneColorBlob(plane, plane->tone_mapping_property(),
                 static_cast<uint32_t>(DppBlobs::DTM),
-                dpp.Dtm(), dpp, dppIndex, drmReq, planeChanged) != NO_ERROR)) {
+                dpp.Dtm(), dpp, *oldDppBlobs, drmReq) != NO_ERROR)) {
         HWC_LOGE(mExynosDisplay, "%s: dpp[%d] set DTM blob fail",
                 __func__, dppIndex);
         return ret;
     }
     if ((ret = setPlaneColorBlob(plane, plane->oetf_lut_property(),
                 static_cast<uint32_t>(DppBlobs::OETF),
-                dpp.OetfLut(), dpp, dppIndex, drmReq, planeChanged) != NO_ERROR)) {
+                dpp.OetfLut(), dpp, *oldDppBlobs, drmReq) != NO_ERROR)) {
         HWC_LOGE(mExynosDisplay, "%s: dpp[%d] set OETF blob fail",
                 __func__, dppIndex);
         return ret;
     }
 
+    oldDppBlobs->signature = signature;
+
     return 0;
 }
 
 ExynosDisplayDrmInterfaceModule::SaveBlob::~SaveBlob()
 {
     for (auto &it: blobs) {
-        mDrmDevice->DestroyPropertyBlob(it);
+        mBlobCache->release(it);
     }
     blobs.clear();
 }
@@ -735,7 +1159,7 @@ void ExynosDisplayDrmInterfaceModule::SaveBlob::addBlob(
         return;
     }
     if (blobs[type] > 0)
-        mDrmDevice->DestroyPropertyBlob(blobs[type]);
+        mBlobCache->release(blobs[type]);
 
     blobs[type] = blob;
 }
@@ -768,3 +1192,346 @@ ExynosExternalDisplayDrmInterfaceModule::ExynosExternalDisplayDrmInterfaceModule
 ExynosExternalDisplayDrmInterfaceModule::~ExynosExternalDisplayDrmInterfaceModule()
 {
 }
+
+ExynosDisplayDrmInterfaceModule::BlobCache::~BlobCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(mDestroyMutex);
+        mDestroyerExit = true;
+    }
+    mDestroyCond.notify_all();
+    if (mDestroyer.joinable())
+        mDestroyer.join();
+
+    for (auto blobId : mEvicted) {
+        destroy(blobId);
+    }
+    for (auto &it : mEntries) {
+        destroy(it.first);
+    }
+    if (!mLive.empty())
+        ALOGE("%s: %zu color blobs leaked", __func__, mLive.size());
+}
+
+int32_t ExynosDisplayDrmInterfaceModule::BlobCache::acquire(
+        const char *stage, const void *data, size_t size, uint32_t &blobId,
+        uint32_t avoidBlobId)
+{
+    /* 64-bit FNV-1a over 8-byte words */
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t hash = 0xcbf29ce484222325ULL ^ size;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ULL;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+
+    std::unique_lock<std::mutex> lock(mLock);
+    if (reference(hash, data, size, blobId, avoidBlobId)) {
+        mFrameStats.hits++;
+        return NO_ERROR;
+    }
+
+    /* Create without the lock, so the blob workers create in parallel */
+    lock.unlock();
+    /* CreatePropertyBlob() only reads the data */
+    int ret = mDrmDevice->CreatePropertyBlob(const_cast<void *>(data), size, &blobId);
+    if (ret)
+        return ret;
+    created(blobId, stage, size);
+    lock.lock();
+
+    /* Another thread may have created the same payload meanwhile, drop ours */
+    uint32_t createdId = blobId;
+    if (reference(hash, data, size, blobId, avoidBlobId)) {
+        addEvicted(createdId);
+        return NO_ERROR;
+    }
+
+    mEntries[blobId] =
+            Entry{hash, stage, std::vector<uint8_t>(bytes, bytes + size), 1, mUnused.end()};
+    mBlobIds.emplace(hash, blobId);
+    mFrameStats.creates++;
+    mFrameStats.createBytes += size;
+    return NO_ERROR;
+}
+
+bool ExynosDisplayDrmInterfaceModule::BlobCache::reference(
+        uint64_t hash, const void *data, size_t size, uint32_t &blobId,
+        uint32_t avoidBlobId)
+{
+    auto range = mBlobIds.equal_range(hash);
+    for (auto it = range.first; it != range.second; it++) {
+        if (it->second == avoidBlobId)
+            continue;
+        Entry &entry = mEntries[it->second];
+        if ((entry.payload.size() != size) || memcmp(entry.payload.data(), data, size))
+            continue;
+
+        if (entry.refs++ == 0) {
+            mUnused.erase(entry.unusedPos);
+            mUnusedBytes -= size;
+        }
+        blobId = it->second;
+        return true;
+    }
+    return false;
+}
+
+void ExynosDisplayDrmInterfaceModule::BlobCache::release(uint32_t blobId)
+{
+    if (blobId == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mEntries.find(blobId);
+    if (it == mEntries.end()) {
+        ALOGE("%s: unknown blob %d", __func__, blobId);
+        return;
+    }
+    if (--it->second.refs > 0)
+        return;
+
+    it->second.unusedPos = mUnused.insert(mUnused.end(), blobId);
+    mUnusedBytes += it->second.payload.size();
+    evict();
+}
+
+void ExynosDisplayDrmInterfaceModule::BlobCache::evict()
+{
+    while ((mUnusedBytes > kMaxUnusedBytes) && !mUnused.empty()) {
+        uint32_t blobId = mUnused.front();
+        mUnused.pop_front();
+
+        auto entry = mEntries.find(blobId);
+        mUnusedBytes -= entry->second.payload.size();
+        auto range = mBlobIds.equal_range(entry->second.hash);
+        for (auto it = range.first; it != range.second; it++) {
+            if (it->second == blobId) {
+                mBlobIds.erase(it);
+                break;
+            }
+        }
+        mEntries.erase(entry);
+        addEvicted(blobId);
+    }
+}
+
+void ExynosDisplayDrmInterfaceModule::BlobCache::addEvicted(uint32_t blobId)
+{
+    mEvicted.push_back(blobId);
+    std::lock_guard<std::mutex> lock(mAccountLock);
+    mDestroyPending++;
+}
+
+void ExynosDisplayDrmInterfaceModule::BlobCache::created(
+        uint32_t blobId, const char *stage, size_t size)
+{
+    std::lock_guard<std::mutex> lock(mAccountLock);
+    if (!mLive.emplace(blobId, LiveBlob{stage, size}).second)
+        ALOGE("%s: blob %d created twice", __func__, blobId);
+    mTotals.created++;
+    mTotals.createdBytes += size;
+    mTotals.liveBytes += size;
+    mTotals.maxLive = std::max(mTotals.maxLive, mLive.size());
+    mTotals.maxLiveBytes = std::max(mTotals.maxLiveBytes, mTotals.liveBytes);
+}
+
+void ExynosDisplayDrmInterfaceModule::BlobCache::destroy(uint32_t blobId)
+{
+    mDrmDevice->DestroyPropertyBlob(blobId);
+
+    std::lock_guard<std::mutex> lock(mAccountLock);
+    auto it = mLive.find(blobId);
+    if (it == mLive.end()) {
+        ALOGE("%s: blob %d was not created by the cache", __func__, blobId);
+        return;
+    }
+    mTotals.destroyed++;
+    mTotals.destroyedBytes += it->second.size;
+    mTotals.liveBytes -= it->second.size;
+    mLive.erase(it);
+}
+
+bool ExynosDisplayDrmInterfaceModule::BlobCache::check(
+        const std::unordered_map<uint32_t, uint32_t> &heldRefs, std::string &result)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    bool ok = true;
+
+    for (auto &it : mEntries) {
+        auto held = heldRefs.find(it.first);
+        uint32_t heldCount = (held == heldRefs.end()) ? 0 : held->second;
+        if (it.second.refs != heldCount) {
+            android::base::StringAppendF(&result,
+                    "blob %d (%s, %zu bytes): %d references, %d held\n", it.first,
+                    it.second.stage, it.second.payload.size(), it.second.refs, heldCount);
+            ok = false;
+        }
+    }
+    for (auto &held : heldRefs) {
+        if (mEntries.count(held.first) == 0) {
+            android::base::StringAppendF(&result, "blob %d: held but not cached\n",
+                    held.first);
+            ok = false;
+        }
+    }
+
+    /* blobs being destroyed are still pending, so only more blobs are a leak */
+    std::lock_guard<std::mutex> accountLock(mAccountLock);
+    size_t expected = mEntries.size() + mDestroyPending;
+    if (mLive.size() > expected) {
+        android::base::StringAppendF(&result,
+                "%zu blobs alive, %zu cached and %zu being destroyed\n", mLive.size(),
+                mEntries.size(), mDestroyPending);
+        ok = false;
+    }
+
+    return ok;
+}
+
+void ExynosDisplayDrmInterfaceModule::BlobCache::dump(std::string &result)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    std::lock_guard<std::mutex> accountLock(mAccountLock);
+
+    android::base::StringAppendF(&result,
+            "color blobs: %zu alive (%zu bytes), max %zu (%zu bytes)\n", mLive.size(),
+            mTotals.liveBytes, mTotals.maxLive, mTotals.maxLiveBytes);
+    android::base::StringAppendF(&result,
+            "  created %" PRIu64 " (%" PRIu64 " bytes), destroyed %" PRIu64
+            " (%" PRIu64 " bytes)\n",
+            mTotals.created, mTotals.createdBytes, mTotals.destroyed,
+            mTotals.destroyedBytes);
+    android::base::StringAppendF(&result,
+            "  cached %zu, unused %zu (%zu bytes, max %zu), being destroyed %zu\n",
+            mEntries.size(), mUnused.size(), mUnusedBytes, kMaxUnusedBytes,
+            mDestroyPending);
+
+    /* alive blobs by stage, stage names are literals */
+    std::map<const char *, std::pair<size_t, size_t>> stages;
+    for (auto &it : mLive) {
+        auto &stage = stages[it.second.stage];
+        stage.first++;
+        stage.second += it.second.size;
+    }
+    for (auto &it : stages) {
+        android::base::StringAppendF(&result, "  %s: %zu alive (%zu bytes)\n", it.first,
+                it.second.first, it.second.second);
+    }
+}
+
+void ExynosDisplayDrmInterfaceModule::BlobCache::destroyEvicted()
+{
+    std::lock_guard<std::mutex> evictedLock(mLock);
+    if (mEvicted.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mDestroyMutex);
+        mDestroyQueue.insert(mDestroyQueue.end(), mEvicted.begin(), mEvicted.end());
+        if (!mDestroyer.joinable())
+            mDestroyer = std::thread(&BlobCache::destroyerLoop, this);
+    }
+    mEvicted.clear();
+    mDestroyCond.notify_all();
+}
+
+void ExynosDisplayDrmInterfaceModule::BlobCache::destroyerLoop()
+{
+    std::vector<uint32_t> batch;
+    std::unique_lock<std::mutex> lock(mDestroyMutex);
+
+    while (true) {
+        mDestroyCond.wait(lock, [this] { return !mDestroyQueue.empty() || mDestroyerExit; });
+        if (mDestroyQueue.empty())
+            return;
+        batch.swap(mDestroyQueue);
+        lock.unlock();
+
+        ATRACE_NAME("destroyEvictedBlobs");
+        auto start = std::chrono::steady_clock::now();
+        for (auto blobId : batch) {
+            destroy(blobId);
+        }
+        mDestroyUs += std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        mDestroyedBlobs += batch.size();
+        {
+            std::lock_guard<std::mutex> accountLock(mAccountLock);
+            mDestroyPending -= batch.size();
+        }
+        batch.clear();
+
+        ATRACE_INT64("ColorBlobsDestroyed", mDestroyedBlobs);
+        ATRACE_INT64("ColorBlobsDestroyUs", mDestroyUs);
+
+        lock.lock();
+    }
+}
+
+ExynosDisplayDrmInterfaceModule::BlobWorkers::~BlobWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExit = true;
+    }
+    mCond.notify_all();
+    for (auto &thread : mThreads) {
+        thread.join();
+    }
+}
+
+void ExynosDisplayDrmInterfaceModule::BlobWorkers::run(std::vector<Job> &&jobs)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJobs = std::move(jobs);
+        mNext = mDone = 0;
+        while (mThreads.size() < kThreads)
+            mThreads.emplace_back(&BlobWorkers::threadLoop, this);
+    }
+    mCond.notify_all();
+}
+
+void ExynosDisplayDrmInterfaceModule::BlobWorkers::join()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (mJobs.empty())
+        return;
+
+    ATRACE_NAME("joinBlobWorkers");
+    while (runNext(lock)) {
+    }
+    mCond.wait(lock, [this] { return mDone == mJobs.size(); });
+    mJobs.clear();
+}
+
+bool ExynosDisplayDrmInterfaceModule::BlobWorkers::runNext(std::unique_lock<std::mutex> &lock)
+{
+    if (mNext == mJobs.size())
+        return false;
+
+    Job &job = mJobs[mNext++];
+    lock.unlock();
+    job();
+    lock.lock();
+    if (++mDone == mJobs.size())
+        mCond.notify_all();
+    return true;
+}
+
+void ExynosDisplayDrmInterfaceModule::BlobWorkers::threadLoop()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (true) {
+        mCond.wait(lock, [this] { return (mNext < mJobs.size()) || mExit; });
+        if (mExit)
+            return;
+        runNext(lock);
+    }
+}
@@ -19,6 +19,14 @@
 
 #include <gs101/displaycolor/displaycolor_gs101.h>
 
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
 #include "ExynosDisplayDrmInterface.h"
 
 using namespace displaycolor;
@@ -38,44 +46,215 @@ class ExynosDisplayDrmInterfaceModule : public ExynosDisplayDrmInterface {
         void setColorSettingChanged(bool changed, bool forceDisplay = false) {
             mColorSettingChanged = changed;
             mForceDisplayColorSetting = forceDisplay;
+            if (changed || forceDisplay) {
+                mFrameDqeSignature = 0;
+                mFrameDppSignatures.clear();
+            }
         };
-        void destroyOldBlobs(std::vector<uint32_t> &oldBlobs);
+        /*
+         * Call after setColorSettingChanged(): starts creating the blobs of
+         * the dirty stages on worker threads, so that setting the color
+         * properties finds them in the cache.
+         */
+        void prepareColorBlobs();
+        /*
+         * Call after the commit of each frame: destroys the blobs evicted
+         * by the frame and reports its color setting statistics.
+         * @committed is false if the commit failed.
+         */
+        void colorSettingDelivered(bool committed);
+        /*
+         * Dump the color blobs, their owners and the blob accounting. Call
+         * with the display mutex held, as the frames change them.
+         */
+        void dumpColorBlobs(std::string &result);
 
+        /*
+         * The create*Blob functions get a blob of the stage data, other than
+         * @avoidBlobId (see BlobCache::acquire()).
+         */
         int32_t createCgcBlobFromIDqe(const IDisplayColorGS101::IDqe &dqe,
-                uint32_t &blobId);
+                uint32_t &blobId, uint32_t avoidBlobId);
         int32_t createDegammaLutBlobFromIDqe(const IDisplayColorGS101::IDqe &dqe,
-                uint32_t &blobId);
+                uint32_t &blobId, uint32_t avoidBlobId);
         int32_t createRegammaLutBlobFromIDqe(const IDisplayColorGS101::IDqe &dqe,
-                uint32_t &blobId);
+                uint32_t &blobId, uint32_t avoidBlobId);
         int32_t createGammaMatBlobFromIDqe(const IDisplayColorGS101::IDqe &dqe,
-                uint32_t &blobId);
+                uint32_t &blobId, uint32_t avoidBlobId);
         int32_t createLinearMatBlobFromIDqe(const IDisplayColorGS101::IDqe &dqe,
-                uint32_t &blobId);
+                uint32_t &blobId, uint32_t avoidBlobId);
         int32_t createDispDitherBlobFromIDqe(const IDisplayColorGS101::IDqe &dqe,
-                uint32_t &blobId);
+                uint32_t &blobId, uint32_t avoidBlobId);
         int32_t createCgcDitherBlobFromIDqe(const IDisplayColorGS101::IDqe &dqe,
-                uint32_t &blobId);
+                uint32_t &blobId, uint32_t avoidBlobId);
 
         int32_t createEotfBlobFromIDpp(const IDisplayColorGS101::IDpp &dpp,
-                uint32_t &blobId);
+                uint32_t &blobId, uint32_t avoidBlobId);
         int32_t createGmBlobFromIDpp(const IDisplayColorGS101::IDpp &dpp,
-                uint32_t &blobId);
+                uint32_t &blobId, uint32_t avoidBlobId);
         int32_t createDtmBlobFromIDpp(const IDisplayColorGS101::IDpp &dpp,
-                uint32_t &blobId);
+                uint32_t &blobId, uint32_t avoidBlobId);
         int32_t createOetfBlobFromIDpp(const IDisplayColorGS101::IDpp &dpp,
-                uint32_t &blobId);
+                uint32_t &blobId, uint32_t avoidBlobId);
     private:
+        /*
+         * Property blobs of the color stages, shared by payload.
+         *
+         * A payload is created as a blob once and the blob is shared by the
+         * CRTC and all planes setting the same payload. Blobs without users
+         * are kept, so that switching back to a recent setting (HBM on/off,
+         * SDR/HDR) reuses them, and are evicted least recently used first
+         * once they take more than kMaxUnusedBytes.
+         *
+         * Evicted blobs are destroyed in a batch on a separate thread by
+         * destroyEvicted(), so the ioctls are not made while the atomic
+         * request is built.
+         *
+         * Every blob the module creates and destroys goes through the
+         * cache, which accounts for the blobs alive in the kernel.
+         */
+        class BlobCache {
+            public:
+                ~BlobCache();
+                void init(DrmDevice *drmDevice) {
+                    mDrmDevice = drmDevice;
+                };
+                /*
+                 * Get a blob of the payload and take a reference to it.
+                 * @stage names the color stage of the payload in dumps.
+                 * A blob is created instead of returning @avoidBlobId: the
+                 * kernel does not apply a property set to the blob it has
+                 * again.
+                 */
+                int32_t acquire(const char *stage, const void *data, size_t size,
+                        uint32_t &blobId, uint32_t avoidBlobId = 0);
+                /* Drop a reference taken by acquire(), 0 is ignored */
+                void release(uint32_t blobId);
+                /* Destroy the blobs evicted since the last call */
+                void destroyEvicted();
+
+                struct FrameStats {
+                    uint32_t creates = 0;
+                    uint64_t createBytes = 0;
+                    uint32_t hits = 0;
+                };
+                /* Get the statistics since the last call */
+                FrameStats takeFrameStats() {
+                    std::lock_guard<std::mutex> lock(mLock);
+                    FrameStats stats = mFrameStats;
+                    mFrameStats = FrameStats();
+                    return stats;
+                };
+                /*
+                 * Check the references of the blobs against @heldRefs, the
+                 * number of references the module holds to each blob, and
+                 * that every blob alive in the kernel is cached or about to
+                 * be destroyed. Returns false and describes the leaks in
+                 * @result otherwise.
+                 */
+                bool check(const std::unordered_map<uint32_t, uint32_t> &heldRefs,
+                        std::string &result);
+                void dump(std::string &result);
+            private:
+                static constexpr size_t kMaxUnusedBytes = 256 * 1024;
+                struct Entry {
+                    uint64_t hash;
+                    const char *stage;
+                    std::vector<uint8_t> payload;
+                    uint32_t refs;
+                    std::list<uint32_t>::iterator unusedPos;
+                };
+                /* Take a reference to the blob of a payload, false if there is none */
+                bool reference(uint64_t hash, const void *data, size_t size, uint32_t &blobId,
+                        uint32_t avoidBlobId);
+                void evict();
+                void destroyerLoop();
+                void created(uint32_t blobId, const char *stage, size_t size);
+                /* Queue a blob to destroyEvicted() */
+                void addEvicted(uint32_t blobId);
+                /* Destroy a blob and account for it */
+                void destroy(uint32_t blobId);
+                DrmDevice *mDrmDevice = NULL;
+                /* acquire() is called from the blob workers */
+                std::mutex mLock;
+                /* key: blob id */
+                std::unordered_map<uint32_t, Entry> mEntries;
+                /* key: payload hash, data: blob id */
+                std::unordered_multimap<uint64_t, uint32_t> mBlobIds;
+                /* blobs without users, least recently used first */
+                std::list<uint32_t> mUnused;
+                size_t mUnusedBytes = 0;
+                /* evicted and not destroyed yet */
+                std::vector<uint32_t> mEvicted;
+                FrameStats mFrameStats;
+
+                std::mutex mDestroyMutex;
+                std::condition_variable mDestroyCond;
+                std::thread mDestroyer;
+                bool mDestroyerExit = false;
+                /* blobs handed to mDestroyer */
+                std::vector<uint32_t> mDestroyQueue;
+                /* updated by mDestroyer only, time spent off the present thread */
+                uint64_t mDestroyedBlobs = 0;
+                uint64_t mDestroyUs = 0;
+
+                /* taken after mLock when both are taken */
+                std::mutex mAccountLock;
+                struct LiveBlob {
+                    const char *stage;
+                    size_t size;
+                };
+                /* blobs alive in the kernel, key: blob id */
+                std::unordered_map<uint32_t, LiveBlob> mLive;
+                /* evicted, in mDestroyQueue or being destroyed */
+                size_t mDestroyPending = 0;
+                struct {
+                    uint64_t created = 0;
+                    uint64_t createdBytes = 0;
+                    uint64_t destroyed = 0;
+                    uint64_t destroyedBytes = 0;
+                    size_t liveBytes = 0;
+                    size_t maxLive = 0;
+                    size_t maxLiveBytes = 0;
+                } mTotals;
+        };
+        /*
+         * Small pool running the jobs of a frame, joined before the results
+         * are used. join() also runs the jobs not started yet on the
+         * calling thread, so it never waits for a busy worker to pick them.
+         */
+        class BlobWorkers {
+            public:
+                using Job = std::function<void()>;
+                ~BlobWorkers();
+                /* Start running @jobs, the previous ones must be joined */
+                void run(std::vector<Job> &&jobs);
+                void join();
+            private:
+                static constexpr size_t kThreads = 2;
+                void threadLoop();
+                /* Run the next job with @lock released, false if none is left */
+                bool runNext(std::unique_lock<std::mutex> &lock);
+                std::mutex mMutex;
+                std::condition_variable mCond;
+                std::vector<std::thread> mThreads;
+                std::vector<Job> mJobs;
+                size_t mNext = 0;
+                size_t mDone = 0;
+                bool mExit = false;
+        };
         class SaveBlob {
             public:
                 ~SaveBlob();
-                void init(DrmDevice *drmDevice, uint32_t size) {
-                    mDrmDevice = drmDevice;
+                void init(BlobCache *blobCache, uint32_t size) {
+                    mBlobCache = blobCache;
                     blobs.resize(size, 0);
                 };
+                /* Replace the blob of the type, taking over the reference of @blob */
                 void addBlob(uint32_t type, uint32_t blob);
                 uint32_t getBlob(uint32_t type);
             private:
-                DrmDevice *mDrmDevice = NULL;
+                BlobCache *mBlobCache = NULL;
                 std::vector<uint32_t> blobs;
         };
         class DqeBlobs:public SaveBlob {
@@ -90,8 +269,12 @@ class ExynosDisplayDrmInterfaceModule : public ExynosDisplayDrmInterface {
                     CGC_DITHER,
                     DQE_BLOB_NUM // number of DQE blobs
                 };
-                void init(DrmDevice *drmDevice) {
-                    SaveBlob::init(drmDevice, DQE_BLOB_NUM);
+                static constexpr const char *kNames[DQE_BLOB_NUM] = {
+                    "cgc", "degamma_lut", "regamma_lut", "gamma_matrix", "linear_matrix",
+                    "disp_dither", "cgc_dither",
+                };
+                void init(BlobCache *blobCache) {
+                    SaveBlob::init(blobCache, DQE_BLOB_NUM);
                 };
         };
         class DppBlobs:public SaveBlob {
@@ -103,10 +286,15 @@ class ExynosDisplayDrmInterfaceModule : public ExynosDisplayDrmInterface {
                     OETF,
                     DPP_BLOB_NUM // number of DPP blobs
                 };
-                DppBlobs(DrmDevice *drmDevice, uint32_t pid) : planeId(pid) {
-                    SaveBlob::init(drmDevice, DPP_BLOB_NUM);
+                static constexpr const char *kNames[DPP_BLOB_NUM] = {
+                    "eotf", "gm", "dtm", "oetf",
+                };
+                DppBlobs(BlobCache *blobCache, uint32_t pid) : planeId(pid) {
+                    SaveBlob::init(blobCache, DPP_BLOB_NUM);
                 };
                 uint32_t planeId;
+                /* signature of the DPP data set to the plane, 0 if unknown */
+                uint64_t signature = 0;
         };
         template<typename StageDataType>
         int32_t setDisplayColorBlob(
@@ -114,7 +302,8 @@ class ExynosDisplayDrmInterfaceModule : public ExynosDisplayDrmInterface {
                 const uint32_t type,
                 const StageDataType &stage,
                 const IDisplayColorGS101::IDqe &dqe,
-                ExynosDisplayDrmInterface::DrmModeAtomicReq &drmReq);
+                ExynosDisplayDrmInterface::DrmModeAtomicReq &drmReq,
+                bool forceUpdate);
         template<typename StageDataType>
         int32_t setPlaneColorBlob(
                 const std::unique_ptr<DrmPlane> &plane,
@@ -122,17 +311,59 @@ class ExynosDisplayDrmInterfaceModule : public ExynosDisplayDrmInterface {
                 const uint32_t type,
                 const StageDataType &stage,
                 const IDisplayColorGS101::IDpp &dpp,
-                const uint32_t dppIndex,
-                ExynosDisplayDrmInterface::DrmModeAtomicReq &drmReq,
-                bool forceUpdate);
+                DppBlobs &oldDppBlobs,
+                ExynosDisplayDrmInterface::DrmModeAtomicReq &drmReq);
         void parseBpcEnums(const DrmProperty& property);
+        /* Check the blob references of the module, see BlobCache::check() */
+        bool checkColorBlobs(std::string &result);
+        /* frames between two checkColorBlobs() from colorSettingDelivered() */
+        static constexpr uint32_t kColorBlobCheckFrames = 600;
+        uint32_t mColorBlobCheckCountdown = kColorBlobCheckFrames;
+        uint32_t mColorBlobCheckFailures = 0;
+        /* declared before the blob owners, which release to it */
+        BlobCache mBlobCache;
+        /* declared after mBlobCache, so the jobs are done before it goes */
+        BlobWorkers mBlobWorkers;
+        /* referenced by prepareColorBlobs() until the frame is delivered */
+        std::vector<uint32_t> mPreparedBlobs;
         DqeBlobs mOldDqeBlobs;
         std::vector<DppBlobs> mOldDppBlobs;
+        /* index of mOldDppBlobs by plane id, -1 if the id is not a plane */
+        std::vector<int32_t> mOldDppBlobsIndex;
         void initOldDppBlobs(DrmDevice *drmDevice) {
             auto const &planes = drmDevice->planes();
-            for (uint32_t ix = 0; ix < planes.size(); ++ix)
-                mOldDppBlobs.emplace_back(mDrmDevice, planes[ix]->id());
+            for (uint32_t ix = 0; ix < planes.size(); ++ix) {
+                uint32_t planeId = planes[ix]->id();
+                mOldDppBlobs.emplace_back(&mBlobCache, planeId);
+                if (planeId >= mOldDppBlobsIndex.size())
+                    mOldDppBlobsIndex.resize(planeId + 1, -1);
+                mOldDppBlobsIndex[planeId] = ix;
+            }
+        };
+        DppBlobs *getOldDppBlobs(uint32_t planeId) {
+            if ((planeId >= mOldDppBlobsIndex.size()) || (mOldDppBlobsIndex[planeId] < 0))
+                return nullptr;
+            return &mOldDppBlobs[mOldDppBlobsIndex[planeId]];
         };
+        /*
+         * Signature of the DQE data the CRTC color properties were last
+         * committed from, 0 if unknown. A frame with the same signature
+         * omits the properties, as the kernel keeps them, unless the
+         * setting is forced. The planes keep their signature in DppBlobs.
+         */
+        uint64_t mDqeSignature = 0;
+        /*
+         * Signatures of the DQE and DPP data of the frame, 0 if not computed
+         * yet. The data only changes with the color setting, so they are
+         * kept until setColorSettingChanged() reports a change.
+         */
+        uint64_t getFrameDqeSignature(const IDisplayColorGS101::IDqe &dqe);
+        uint64_t getFrameDppSignature(size_t dppIndex, const IDisplayColorGS101::IDpp &dpp);
+        uint64_t mFrameDqeSignature = 0;
+        /* by DPP index */
+        std::vector<uint64_t> mFrameDppSignatures;
+        /* time spent setting color properties in the current frame */
+        uint64_t mColorSettingUs = 0;
         bool mColorSettingChanged = false;
         bool mForceDisplayColorSetting = false;
         enum Bpc_Type {
@@ -32,10 +32,10 @@ class DisplayColorLoader {
                                     dlsym(lib_handle, "GetDisplayColorGS101");
 
               if (get_display_color_gs101 == nullptr) {
-                  ALOGE("%s: failed to get GetDisplayColorGS101\n", __func__);
+                  ALOGE("%s: failed to get GetDisplayColorGS101 from %s\n", __func__, lib_name);
               }
           } else {
-              ALOGE("%s: failed to load library %s\n", __func__, lib_name);
+              ALOGE("%s: failed to load library %s: %s\n", __func__, lib_name, dlerror());
               get_display_color_gs101 = nullptr;
           }
       }
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DISPLAY_COLOR_UPDATER_H
+#define DISPLAY_COLOR_UPDATER_H
+
+#include <android-base/stringprintf.h>
+#include <gs101/displaycolor/displaycolor_gs101.h>
+#include <utils/Trace.h>
+
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+ * Runs IDisplayColorGeneric::Update() for the scenes of a display.
+ *
+ * If async, Update() runs on a worker thread, so the composition thread can
+ * go on with the frame while the pipeline data is computed. libdisplaycolor
+ * keeps a single copy of the pipeline data, so nothing may call into
+ * libdisplaycolor before wait() returns. A result that is not ready when
+ * wait() is called is late: the caller blocks until it is ready and the
+ * update is counted as late.
+ *
+ * Otherwise request() runs Update() itself, and the same statistics are
+ * kept so both modes can be compared.
+ */
+class DisplayColorUpdater {
+    public:
+      explicit DisplayColorUpdater(bool async) : mAsync(async) {}
+
+      ~DisplayColorUpdater() {
+          {
+              std::lock_guard<std::mutex> lock(mMutex);
+              mExit = true;
+          }
+          mCond.notify_all();
+          if (mThread.joinable())
+              mThread.join();
+      }
+
+      void init(displaycolor::IDisplayColorGS101 *displayColor,
+                displaycolor::DisplayType display) {
+          mDisplayColor = displayColor;
+          mDisplay = display;
+      }
+
+      /*
+       * Start updating the pipeline data for @scene. @scene is copied, so
+       * the caller may change it as soon as this returns. Returns the result
+       * of Update() if not async, NO_ERROR otherwise.
+       */
+      int request(const displaycolor::DisplayScene &scene) {
+          if (!mAsync) {
+              auto start = Clock::now();
+              int ret = mDisplayColor->Update(mDisplay, scene);
+              uint64_t us = elapsedUs(start);
+
+              std::lock_guard<std::mutex> lock(mMutex);
+              mResult = ret;
+              mStats.update.add(us);
+              mStats.blocked.add(us);
+              return ret;
+          }
+
+          std::unique_lock<std::mutex> lock(mMutex);
+          mCond.wait(lock, [this] { return !mUpdating; });
+          mScene = scene;
+          mRequested = mUpdating = mFirstWait = true;
+          if (!mThread.joinable())
+              mThread = std::thread(&DisplayColorUpdater::threadLoop, this);
+          lock.unlock();
+          mCond.notify_all();
+
+          return 0;
+      }
+
+      /* Wait for the last requested update and return the result of Update() */
+      int wait() {
+          std::unique_lock<std::mutex> lock(mMutex);
+          if (!mUpdating) {
+              if (mFirstWait)
+                  mStats.blocked.add(0);
+              mFirstWait = false;
+              return mResult;
+          }
+
+          ATRACE_NAME("DisplayColorUpdater::wait");
+          auto start = Clock::now();
+          mCond.wait(lock, [this] { return !mUpdating; });
+          if (mFirstWait) {
+              mStats.blocked.add(elapsedUs(start));
+              mStats.late++;
+          }
+          mFirstWait = false;
+
+          return mResult;
+      }
+
+      void dump(std::string &result) {
+          std::lock_guard<std::mutex> lock(mMutex);
+          android::base::StringAppendF(&result,
+                                       "DisplayColorUpdater: %s, late %" PRIu64 "/%" PRIu64 "\n",
+                                       mAsync ? "async" : "sync", mStats.late,
+                                       mStats.update.total());
+          mStats.update.dump(result, "update");
+          mStats.blocked.dump(result, "blocked");
+      }
+
+    private:
+      using Clock = std::chrono::steady_clock;
+
+      /* Counts of durations in buckets up to each bound, the last one unbounded */
+      struct Histogram {
+          static constexpr std::array<uint64_t, 7> kBoundsUs = {250,  500,  1000, 2000,
+                                                                4000, 8000, 16000};
+          std::array<uint64_t, kBoundsUs.size() + 1> counts{};
+
+          void add(uint64_t us) {
+              size_t i = 0;
+              while (i < kBoundsUs.size() && us > kBoundsUs[i])
+                  i++;
+              counts[i]++;
+          }
+
+          uint64_t total() const {
+              uint64_t sum = 0;
+              for (auto count : counts)
+                  sum += count;
+              return sum;
+          }
+
+          void dump(std::string &result, const char *name) const {
+              android::base::StringAppendF(&result, "  %s:", name);
+              for (size_t i = 0; i < kBoundsUs.size(); i++)
+                  android::base::StringAppendF(&result, " <=%" PRIu64 "us %" PRIu64, kBoundsUs[i],
+                                               counts[i]);
+              android::base::StringAppendF(&result, " >%" PRIu64 "us %" PRIu64 "\n",
+                                           kBoundsUs.back(), counts.back());
+          }
+      };
+
+      static uint64_t elapsedUs(Clock::time_point start) {
+          return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start)
+                  .count();
+      }
+
+      void threadLoop() {
+          std::unique_lock<std::mutex> lock(mMutex);
+          while (true) {
+              mCond.wait(lock, [this] { return mRequested || mExit; });
+              if (mExit)
+                  return;
+              mRequested = false;
+              lock.unlock();
+
+              int ret;
+              auto start = Clock::now();
+              {
+                  ATRACE_NAME("DisplayColorUpdater::update");
+                  ret = mDisplayColor->Update(mDisplay, mScene);
+              }
+              uint64_t us = elapsedUs(start);
+
+              lock.lock();
+              mResult = ret;
+              mUpdating = false;
+              mStats.update.add(us);
+              mCond.notify_all();
+          }
+      }
+
+      const bool mAsync;
+      displaycolor::IDisplayColorGS101 *mDisplayColor = nullptr;
+      displaycolor::DisplayType mDisplay = displaycolor::DisplayType::DISPLAY_PRIMARY;
+
+      std::mutex mMutex;
+      std::condition_variable mCond;
+      std::thread mThread;
+      /* the copy of the scene the worker updates, written only while not updating */
+      displaycolor::DisplayScene mScene;
+      bool mRequested = false;
+      bool mUpdating = false;
+      bool mFirstWait = false;
+      bool mExit = false;
+      int mResult = 0;
+
+      struct {
+          Histogram update;
+          Histogram blocked;
+          uint64_t late = 0;
+      } mStats;
+};
+
+#endif // DISPLAY_COLOR_UPDATER_H
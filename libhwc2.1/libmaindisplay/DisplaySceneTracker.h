@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DISPLAY_SCENE_TRACKER_H
+#define DISPLAY_SCENE_TRACKER_H
+
+#include <gs101/displaycolor/displaycolor_gs101.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Decides which frames of a display skip the color work.
+ *
+ * Update() of the scene last passed to it gives the same pipeline data once
+ * UpdatePresent() leaves the data steady, so it is skipped. UpdatePresent()
+ * runs every frame, as it may change the data of an unchanged scene, e.g.
+ * in brightness transitions. The DRM color setting of a frame is skipped
+ * only if its pipeline data is the same as in the last frame.
+ *
+ * Per frame: skipUpdate(), then updated() or updateFailed() if Update() was
+ * called, then presented() or presentFailed(), then needColorSetting().
+ */
+class DisplaySceneTracker {
+    public:
+        using DppHandles = std::vector<
+                std::reference_wrapper<const displaycolor::IDisplayColorGS101::IDpp>>;
+
+        /*
+         * Hash of the fields of @scene set by HWC, except refresh_rate which
+         * only UpdatePresent() takes. It catches the scene changes the
+         * setters of the scene do not report, like brightness. Never 0.
+         */
+        static uint64_t sceneHash(const displaycolor::DisplayScene &scene) {
+            SceneHasher hasher;
+
+            hasher.add(scene.color_mode);
+            hasher.add(scene.render_intent);
+            hasher.add(scene.dpu_bit_depth);
+            hasher.add(scene.matrix);
+            hasher.add(scene.bm);
+            hasher.add(scene.force_hdr);
+            hasher.add(scene.lhbm_on);
+            hasher.add(scene.hdr_full_screen);
+            hasher.add(scene.dbv);
+
+            hasher.add(scene.layer_data.size());
+            for (auto &layerData : scene.layer_data) {
+                hasher.add(layerData.dataspace);
+                hasher.add(layerData.matrix);
+
+                const auto &staticMetadata = layerData.static_metadata;
+                hasher.add(staticMetadata.is_valid);
+                hasher.add(staticMetadata.display_red_primary_x);
+                hasher.add(staticMetadata.display_red_primary_y);
+                hasher.add(staticMetadata.display_green_primary_x);
+                hasher.add(staticMetadata.display_green_primary_y);
+                hasher.add(staticMetadata.display_blue_primary_x);
+                hasher.add(staticMetadata.display_blue_primary_y);
+                hasher.add(staticMetadata.white_point_x);
+                hasher.add(staticMetadata.white_point_y);
+                hasher.add(staticMetadata.max_luminance);
+                hasher.add(staticMetadata.min_luminance);
+                hasher.add(staticMetadata.max_content_light_level);
+                hasher.add(staticMetadata.max_frame_average_light_level);
+
+                const auto &dynamicMetadata = layerData.dynamic_metadata;
+                hasher.add(dynamicMetadata.is_valid);
+                hasher.add(dynamicMetadata.display_maximum_luminance);
+                hasher.add(dynamicMetadata.maxscl);
+                hasher.addVector(dynamicMetadata.maxrgb_percentages);
+                hasher.addVector(dynamicMetadata.maxrgb_percentiles);
+                hasher.add(dynamicMetadata.tm_flag);
+                hasher.add(dynamicMetadata.tm_knee_x);
+                hasher.add(dynamicMetadata.tm_knee_y);
+                hasher.addVector(dynamicMetadata.bezier_curve_anchors);
+            }
+
+            return hasher.get();
+        }
+
+        /*
+         * Call before Update(), with the sceneHash() of the frame. @changed
+         * is true if the scene setters or the layer to DPP mapping reported
+         * a change. Returns true if Update() is skipped.
+         */
+        bool skipUpdate(bool changed, uint64_t sceneHash) {
+            mUpdateSkipped = !changed && mPipelineSteady && (sceneHash == mUpdatedSceneHash);
+            return mUpdateSkipped;
+        }
+        /* Update() was requested for the scene of @sceneHash */
+        void updated(uint64_t sceneHash) { mUpdatedSceneHash = sceneHash; }
+        /* Update() failed: the next frame updates again */
+        void updateFailed() { mUpdatedSceneHash = 0; }
+
+        /* UpdatePresent() succeeded, check whether it changed the pipeline data */
+        void presented(const displaycolor::IDisplayColorGS101::IDqe &dqe, const DppHandles &dpps) {
+            mPipelineSteady = !pipelineChanged(dqe, dpps);
+        }
+        void presentFailed() {
+            mUpdatedSceneHash = 0;
+            mPipelineSteady = false;
+        }
+
+        /* The pipeline data of the frame may differ from the last frame */
+        bool needColorSetting() const { return !(mUpdateSkipped && mPipelineSteady); }
+
+    private:
+        /* 64-bit FNV-1a over the bytes of values without padding */
+        class SceneHasher {
+            public:
+                template <typename T>
+                void add(const T &value) {
+                    static_assert(std::is_trivially_copyable<T>::value,
+                                  "value is not plain data");
+                    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+                    for (size_t i = 0; i < sizeof(value); i++)
+                        mHash = (mHash ^ bytes[i]) * 0x100000001b3ULL;
+                }
+                template <typename T>
+                void addVector(const std::vector<T> &values) {
+                    add(values.size());
+                    for (auto &value : values)
+                        add(value);
+                }
+                uint64_t get() const {
+                    /* 0 is kept for no hash */
+                    return mHash ? mHash : 1;
+                }
+            private:
+                uint64_t mHash = 0xcbf29ce484222325ULL;
+        };
+
+        /*
+         * Enabled stages that are dirty, or stages that were enabled or
+         * disabled since the last call.
+         */
+        bool pipelineChanged(const displaycolor::IDisplayColorGS101::IDqe &dqe,
+                             const DppHandles &dpps) {
+            uint64_t enableMask = 0;
+            uint32_t bit = 0;
+            bool dirty = false;
+            auto addStage = [&](const auto &stage) {
+                if (stage.enable) {
+                    enableMask |= 1ull << std::min(bit, 63u);
+                    dirty |= stage.dirty;
+                }
+                bit++;
+            };
+
+            addStage(dqe.DqeControl());
+            addStage(dqe.GammaMatrix());
+            addStage(dqe.DegammaLut());
+            addStage(dqe.LinearMatrix());
+            addStage(dqe.Cgc());
+            addStage(dqe.RegammaLut());
+            for (const displaycolor::IDisplayColorGS101::IDpp &dpp : dpps) {
+                addStage(dpp.EotfLut());
+                addStage(dpp.Gm());
+                addStage(dpp.Dtm());
+                addStage(dpp.OetfLut());
+            }
+
+            bool changed = dirty || (enableMask != mEnableMask);
+            mEnableMask = enableMask;
+            return changed;
+        }
+
+        /* sceneHash() of the scene last passed to Update(), 0 if it failed */
+        uint64_t mUpdatedSceneHash = 0;
+        /* the last UpdatePresent() left the pipeline data unchanged */
+        bool mPipelineSteady = false;
+        /* Update() is skipped in the current frame */
+        bool mUpdateSkipped = false;
+        uint64_t mEnableMask = 0;
+};
+
+#endif // DISPLAY_SCENE_TRACKER_H
@@ -39,14 +39,21 @@ mpp_phycal_type_t getMPPTypeFromDPPChannel(uint32_t channel) {
     return MPP_P_TYPE_MAX;
 }
 
+#ifdef DISPLAY_COLOR_ASYNC_UPDATE
+static constexpr bool kDisplayColorAsyncUpdate = true;
+#else
+static constexpr bool kDisplayColorAsyncUpdate = false;
+#endif
+
 // enable map layerDataMappingInfo comparison in needDisplayColorSetting()
 inline bool operator==(const ExynosPrimaryDisplayModule::DisplaySceneInfo::LayerMappingInfo &lm1,
                        const ExynosPrimaryDisplayModule::DisplaySceneInfo::LayerMappingInfo &lm2) {
-    return lm1.dppIdx == lm2.dppIdx && lm1.planeId == lm2.planeId;
+    return lm1.dppIdx == lm2.dppIdx;
 }
 
 ExynosPrimaryDisplayModule::ExynosPrimaryDisplayModule(uint32_t index, ExynosDevice *device)
-    :    ExynosPrimaryDisplay(index, device), mDisplayColorLoader(DISPLAY_COLOR_LIB)
+    :    ExynosPrimaryDisplay(index, device), mDisplayColorLoader(DISPLAY_COLOR_LIB),
+         mDisplayColorUpdater(kDisplayColorAsyncUpdate)
 {
 #ifdef FORCE_GPU_COMPOSITION
     exynosHWCControl.forceGpu = true;
@@ -57,6 +64,7 @@ ExynosPrimaryDisplayModule::ExynosPrimaryDisplayModule(uint32_t index, ExynosDev
 
 int ExynosPrimaryDisplayModule::initDisplayColor() {
     mDisplayColorInterface = mDisplayColorLoader.GetDisplayColorGS101(1);
+    mDisplayColorUpdater.init(mDisplayColorInterface, DisplayType::DISPLAY_PRIMARY);
     return mDisplayColorInterface == nullptr ? -EINVAL : NO_ERROR;
 }
 
@@ -129,7 +137,7 @@ int32_t ExynosPrimaryDisplayModule::getColorModes(
         uint32_t* outNumModes, int32_t* outModes)
 {
     const ColorModesMap colorModeMap =
-        mDisplayColorInterface->ColorModesAndRenderIntents(DisplayType::DISPLAY_PRIMARY);
+        getDisplayColor()->ColorModesAndRenderIntents(DisplayType::DISPLAY_PRIMARY);
     ALOGD("%s: size(%zu)", __func__, colorModeMap.size());
     if (outModes == nullptr) {
         *outNumModes = colorModeMap.size();
@@ -156,7 +164,7 @@ int32_t ExynosPrimaryDisplayModule::setColorMode(int32_t mode)
 {
     ALOGD("%s: mode(%d)", __func__, mode);
     const ColorModesMap colorModeMap =
-        mDisplayColorInterface->ColorModesAndRenderIntents(DisplayType::DISPLAY_PRIMARY);
+        getDisplayColor()->ColorModesAndRenderIntents(DisplayType::DISPLAY_PRIMARY);
     hwc::ColorMode colorMode =
         static_cast<hwc::ColorMode>(mode);
     const auto it = colorModeMap.find(colorMode);
@@ -177,7 +185,7 @@ int32_t ExynosPrimaryDisplayModule::getRenderIntents(int32_t mode,
         uint32_t* outNumIntents, int32_t* outIntents)
 {
     const ColorModesMap colorModeMap =
-        mDisplayColorInterface->ColorModesAndRenderIntents(DisplayType::DISPLAY_PRIMARY);
+        getDisplayColor()->ColorModesAndRenderIntents(DisplayType::DISPLAY_PRIMARY);
     ALOGD("%s, size(%zu)", __func__, colorModeMap.size());
     hwc::ColorMode colorMode =
         static_cast<hwc::ColorMode>(mode);
@@ -212,7 +220,7 @@ int32_t ExynosPrimaryDisplayModule::setColorModeWithRenderIntent(int32_t mode,
 {
     ALOGD("%s: mode(%d), intent(%d)", __func__, mode, intent);
     const ColorModesMap colorModeMap =
-        mDisplayColorInterface->ColorModesAndRenderIntents(DisplayType::DISPLAY_PRIMARY);
+        getDisplayColor()->ColorModesAndRenderIntents(DisplayType::DISPLAY_PRIMARY);
     hwc::ColorMode colorMode =
         static_cast<hwc::ColorMode>(mode);
     hwc::RenderIntent renderIntent =
@@ -327,7 +335,7 @@ bool ExynosPrimaryDisplayModule::hasDppForLayer(ExynosMPPSource* layer)
         return false;
 
     uint32_t index =  mDisplaySceneInfo.layerDataMappingInfo[layer].dppIdx;
-    auto size = mDisplayColorInterface->GetPipelineData(DisplayType::DISPLAY_PRIMARY)->Dpp().size();
+    auto size = getDpps().size();
     if (index >= size) {
         DISPLAY_LOGE("%s: invalid dpp index(%d) dpp size(%zu)", __func__, index, size);
         return false;
@@ -339,7 +347,7 @@ bool ExynosPrimaryDisplayModule::hasDppForLayer(ExynosMPPSource* layer)
 const IDisplayColorGS101::IDpp& ExynosPrimaryDisplayModule::getDppForLayer(ExynosMPPSource* layer)
 {
     uint32_t index = mDisplaySceneInfo.layerDataMappingInfo[layer].dppIdx;
-    return mDisplayColorInterface->GetPipelineData(DisplayType::DISPLAY_PRIMARY)->Dpp()[index].get();
+    return getDpps()[index].get();
 }
 
 int32_t ExynosPrimaryDisplayModule::getDppIndexForLayer(ExynosMPPSource* layer)
@@ -364,9 +372,12 @@ int ExynosPrimaryDisplayModule::deliverWinConfigData()
     moduleDisplayInterface->setColorSettingChanged(
             mDisplaySceneInfo.needDisplayColorSetting(),
             forceDisplayColorSetting);
+    moduleDisplayInterface->prepareColorBlobs();
 
     ret = ExynosDisplay::deliverWinConfigData();
 
+    moduleDisplayInterface->colorSettingDelivered(ret == NO_ERROR);
+
     checkAtcAnimation();
 
     if (mDpuData.enable_readback &&
@@ -397,12 +408,7 @@ int32_t ExynosPrimaryDisplayModule::DisplaySceneInfo::setLayerDataMappingInfo(
                 layer, index);
         return -EINVAL;
     }
-    // if assigned displaycolor dppIdx changes, do not reuse it (force plane color update).
-    uint32_t oldPlaneId = prev_layerDataMappingInfo.count(layer) != 0 &&
-                    prev_layerDataMappingInfo[layer].dppIdx != index
-            ? prev_layerDataMappingInfo[layer].planeId
-            : UINT_MAX;
-    layerDataMappingInfo.insert(std::make_pair(layer, LayerMappingInfo{ index, oldPlaneId }));
+    layerDataMappingInfo.insert(std::make_pair(layer, LayerMappingInfo{ index }));
 
     return NO_ERROR;
 }
@@ -637,11 +643,23 @@ int32_t ExynosPrimaryDisplayModule::updateColorConversionInfo()
     if (hwcCheckDebugMessages(eDebugColorManagement))
         mDisplaySceneInfo.printDisplayScene();
 
-    if ((ret = mDisplayColorInterface->Update(DisplayType::DISPLAY_PRIMARY,
-                                              mDisplaySceneInfo.displayScene)) != 0) {
+    /* The same scene gives the same pipeline data once it is steady */
+    DisplaySceneTracker &tracker = mDisplaySceneInfo.sceneTracker;
+    uint64_t sceneHash = DisplaySceneTracker::sceneHash(mDisplaySceneInfo.displayScene);
+    bool changed = mDisplaySceneInfo.colorSettingChanged ||
+            (mDisplaySceneInfo.prev_layerDataMappingInfo !=
+             mDisplaySceneInfo.layerDataMappingInfo);
+    if (tracker.skipUpdate(changed, sceneHash))
+        return NO_ERROR;
+
+    mDppsValid = false;
+    if ((ret = mDisplayColorUpdater.request(mDisplaySceneInfo.displayScene)) != 0) {
         DISPLAY_LOGE("Display Scene update error (%d)", ret);
+        tracker.updateFailed();
         return ret;
     }
+    /* reset by updatePresentColorConversionInfo() if the update fails */
+    tracker.updated(sceneHash);
 
     return ret;
 }
@@ -655,35 +673,73 @@ int32_t ExynosPrimaryDisplayModule::updatePresentColorConversionInfo()
         mDisplaySceneInfo.displayScene.refresh_rate = refresh_rate;
     }
 
+    /*
+     * Called even if Update() was skipped, as displaycolor may change the
+     * pipeline data here, e.g. while the brightness moves.
+     */
+    DisplaySceneTracker &tracker = mDisplaySceneInfo.sceneTracker;
     int ret = OK;
+    if ((ret = mDisplayColorUpdater.wait()) != 0) {
+        DISPLAY_LOGE("Display Scene update error (%d)", ret);
+        tracker.presentFailed();
+        return ret;
+    }
+
+    if (hwcCheckDebugMessages(eDebugColorManagement)) {
+        std::string stats;
+        mDisplayColorUpdater.dump(stats);
+        ALOGD("%s", stats.c_str());
+    }
+
+    mDppsValid = false;
     if ((ret = mDisplayColorInterface->UpdatePresent(DisplayType::DISPLAY_PRIMARY,
                                               mDisplaySceneInfo.displayScene)) != 0) {
         DISPLAY_LOGE("Display Scene update error (%d)", ret);
+        tracker.presentFailed();
         return ret;
     }
+    /* keep updating while displaycolor changes the data, e.g. in transitions */
+    tracker.presented(getDqe(), getDpps());
 
     return ret;
 }
 
+const std::vector<std::reference_wrapper<const IDisplayColorGS101::IDpp>>&
+ExynosPrimaryDisplayModule::getDpps()
+{
+    if (!mDppsValid) {
+        mDpps = getDisplayColor()->GetPipelineData(DisplayType::DISPLAY_PRIMARY)->Dpp();
+        mDppsValid = true;
+    }
+    return mDpps;
+}
+
 int32_t ExynosPrimaryDisplayModule::getColorAdjustedDbv(uint32_t &dbv_adj) {
-    dbv_adj = mDisplayColorInterface->GetPipelineData(DisplayType::DISPLAY_PRIMARY)
+    dbv_adj = getDisplayColor()->GetPipelineData(DisplayType::DISPLAY_PRIMARY)
                            ->Panel()
                            .GetAdjustedBrightnessLevel();
     return NO_ERROR;
 }
 
-bool ExynosPrimaryDisplayModule::DisplaySceneInfo::needDisplayColorSetting()
+void ExynosPrimaryDisplayModule::dump(String8& result)
 {
-    /* TODO: Check if we can skip color setting */
-    /* For now, propage setting every frame */
-    return true;
+    ExynosPrimaryDisplay::dump(result);
 
-    if (colorSettingChanged)
-        return true;
-    if (prev_layerDataMappingInfo != layerDataMappingInfo)
-        return true;
+    std::string colorStats;
+    mDisplayColorUpdater.dump(colorStats);
+    ExynosDisplayDrmInterfaceModule *moduleDisplayInterface =
+        (ExynosDisplayDrmInterfaceModule*)(mDisplayInterface.get());
+    {
+        /* presentDisplay() changes the color blobs */
+        Mutex::Autolock lock(mDisplayMutex);
+        moduleDisplayInterface->dumpColorBlobs(colorStats);
+    }
+    result.append(colorStats.c_str());
+}
 
-    return false;
+bool ExynosPrimaryDisplayModule::DisplaySceneInfo::needDisplayColorSetting()
+{
+    return sceneTracker.needColorSetting();
 }
 
 void ExynosPrimaryDisplayModule::DisplaySceneInfo::printDisplayScene()
@@ -708,7 +764,7 @@ void ExynosPrimaryDisplayModule::DisplaySceneInfo::printDisplayScene()
     ALOGD("layerDataMappingInfo: %zu ++++++",
             layerDataMappingInfo.size());
     for (auto layer : layerDataMappingInfo) {
-        ALOGD("[layer: %p] [%d, %d]", layer.first, layer.second.dppIdx, layer.second.planeId);
+        ALOGD("[layer: %p] [%d]", layer.first, layer.second.dppIdx);
     }
 }
 
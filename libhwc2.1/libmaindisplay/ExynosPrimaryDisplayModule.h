@@ -19,6 +19,8 @@
 #include <gs101/displaycolor/displaycolor_gs101.h>
 
 #include "DisplayColorLoader.h"
+#include "DisplayColorUpdater.h"
+#include "DisplaySceneTracker.h"
 #include "ExynosDisplay.h"
 #include "ExynosPrimaryDisplay.h"
 #include "ExynosLayer.h"
@@ -113,9 +115,11 @@ class ExynosPrimaryDisplayModule : public ExynosPrimaryDisplay {
         virtual int32_t updateColorConversionInfo();
         virtual int32_t updatePresentColorConversionInfo();
         virtual bool checkRrCompensationEnabled() {
-            return mDisplayColorInterface->IsRrCompensationEnabled(DisplayType::DISPLAY_PRIMARY);
+            return getDisplayColor()->IsRrCompensationEnabled(DisplayType::DISPLAY_PRIMARY);
         }
         virtual int32_t getColorAdjustedDbv(uint32_t &dbv_adj);
+        /* Adds the color scene update statistics and the color blobs */
+        virtual void dump(String8& result);
 
         virtual void initLbe();
         virtual void setLbeState(LbeState state);
@@ -127,16 +131,16 @@ class ExynosPrimaryDisplayModule : public ExynosPrimaryDisplay {
                 struct LayerMappingInfo {
                     // index in DisplayScene::layer_data
                     uint32_t dppIdx;
-                    // assigned drm plane id in last color setting update
-                    uint32_t planeId;
                 };
                 bool colorSettingChanged = false;
                 bool displaySettingDelivered = false;
                 DisplayScene displayScene;
 
+                /* which frames skip Update() and the color setting */
+                DisplaySceneTracker sceneTracker;
+
                 /*
                  * Index of LayerColorData in DisplayScene::layer_data
-                 * and assigned plane id in last color setting update.
                  * for each layer, including client composition
                  * key: ExynosMPPSource*
                  * data: LayerMappingInfo
@@ -214,22 +218,19 @@ class ExynosPrimaryDisplayModule : public ExynosPrimaryDisplay {
         bool hasDppForLayer(ExynosMPPSource* layer);
         const IDisplayColorGS101::IDpp& getDppForLayer(ExynosMPPSource* layer);
         int32_t getDppIndexForLayer(ExynosMPPSource* layer);
-        /* Check if layer's assigned plane id has changed, save the new planeId.
-         * call only if hasDppForLayer is true */
-        bool checkAndSaveLayerPlaneId(ExynosMPPSource* layer, uint32_t planeId) {
-            auto &info = mDisplaySceneInfo.layerDataMappingInfo[layer];
-            bool change = info.planeId != planeId;
-            info.planeId = planeId;
-            return change;
-        }
 
         size_t getNumOfDpp() {
-            return mDisplayColorInterface->GetPipelineData(DisplayType::DISPLAY_PRIMARY)->Dpp().size();
+            return getDpps().size();
+        };
+
+        /* index should be less than getNumOfDpp() */
+        const IDisplayColorGS101::IDpp& getDpp(size_t index) {
+            return getDpps()[index].get();
         };
 
         const IDisplayColorGS101::IDqe& getDqe()
         {
-            return mDisplayColorInterface->GetPipelineData(DisplayType::DISPLAY_PRIMARY)->Dqe();
+            return getDisplayColor()->GetPipelineData(DisplayType::DISPLAY_PRIMARY)->Dqe();
         };
 
     private:
@@ -237,6 +238,22 @@ class ExynosPrimaryDisplayModule : public ExynosPrimaryDisplay {
         IDisplayColorGS101 *mDisplayColorInterface;
         DisplaySceneInfo mDisplaySceneInfo;
         DisplayColorLoader mDisplayColorLoader;
+        DisplayColorUpdater mDisplayColorUpdater;
+
+        /*
+         * The DPP handles of the pipeline data. Dpp() builds a vector, so it
+         * is called once per update of the pipeline data instead of once
+         * per layer.
+         */
+        const std::vector<std::reference_wrapper<const IDisplayColorGS101::IDpp>>& getDpps();
+        std::vector<std::reference_wrapper<const IDisplayColorGS101::IDpp>> mDpps;
+        bool mDppsValid = false;
+
+        /* Wait for the pending scene update before calling into libdisplaycolor */
+        IDisplayColorGS101 *getDisplayColor() {
+            mDisplayColorUpdater.wait();
+            return mDisplayColorInterface;
+        }
 
         struct atc_lux_map {
             uint32_t lux;
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "ColorSettingHarness.h"
+
+namespace {
+
+using Frame = ColorSettingHarness::Frame;
+
+constexpr uint64_t kFrames = 2000000;
+/* the frames repeat with this period, so must the blobs alive */
+constexpr uint64_t kPeriod = 4096;
+constexpr uint64_t kWarmUpPeriods = 8;
+
+/*
+ * HDR videos starting and stopping, layers moving between planes, HBM and
+ * lhbm toggles, brightness ramps, color transforms, failed and forced
+ * commits.
+ */
+Frame soakFrame(uint64_t frame) {
+    uint64_t i = frame % kPeriod;
+    Frame f;
+    f.layers = {{0, 0}, {1, 1}};
+    if ((i / 64) % 2)
+        f.layers.push_back({2, 2, hwc::Dataspace::BT2020_PQ, (i / 128) % 2 == 1});
+    if ((i / 256) % 2)
+        f.layers.push_back({3, 3, hwc::Dataspace::BT2020_HLG});
+    if ((i / 32) % 3 == 1)
+        std::swap(f.layers[0].plane, f.layers.back().plane);
+    if ((i / 512) % 2)
+        f.colorMode = hwc::ColorMode::DISPLAY_P3;
+    f.bm = ((i / 16) % 5 == 4) ? BrightnessMode::BM_HBM : BrightnessMode::BM_NOMINAL;
+    f.lhbmOn = (i % 200) < 10;
+    f.dbv = 500 + static_cast<uint32_t>(i % 1024) * 3;
+    f.transform = (i / 1024) % 2;
+    f.fail = (i % 97) == 0;
+    f.force = (i % 1000) == 999;
+    return f;
+}
+
+TEST(ColorBlobSoakTest, BlobsDoNotGrow) {
+    ColorSettingHarness::Options options;
+    options.displayColor.dbvTransitionFrames = 8;
+    ColorSettingHarness harness(options);
+
+    size_t live = 0;
+    size_t liveBytes = 0;
+    for (uint64_t frame = 0; frame < kFrames; frame++) {
+        harness.present(soakFrame(frame));
+        if ((frame + 1) % kPeriod)
+            continue;
+
+        /* the references to the blobs match the blobs alive */
+        std::string dump;
+        harness.module().dumpColorBlobs(dump);
+        ASSERT_NE(dump.find("leak check: ok, 0 periodic checks failed"), std::string::npos)
+                << "frame " << frame << "\n" << dump;
+
+        /*
+         * The first periods fill the cache. The evicted blobs are destroyed
+         * on another thread, so the blobs alive vary a little from a period
+         * to the next, but must not grow.
+         */
+        DrmDevice::Stats stats = harness.drm().stats();
+        if (frame < kWarmUpPeriods * kPeriod) {
+            live = std::max(live, stats.live);
+            liveBytes = std::max(liveBytes, stats.liveBytes);
+            continue;
+        }
+        ASSERT_LE(stats.live, 2 * live) << "frame " << frame;
+        ASSERT_LE(stats.liveBytes, 2 * liveBytes) << "frame " << frame;
+    }
+
+    DrmDevice::Stats stats = harness.drm().stats();
+    RecordProperty("creates", std::to_string(stats.creates));
+    RecordProperty("maxLive", std::to_string(stats.maxLive));
+    RecordProperty("maxLiveBytes", std::to_string(stats.maxLiveBytes));
+}
+
+}  // namespace
@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ColorSettingHarness.h"
+
+/*
+ * Scene transitions: each sequence of frames is presented to a harness that
+ * skips the color work the way HWC does, and to a reference harness where
+ * every frame is forced, so every stage is programmed from the pipeline data
+ * of the frame. After each committed frame the blobs both hold on the CRTC
+ * and on the planes of the frame must have the same payloads.
+ */
+namespace {
+
+using Frame = ColorSettingHarness::Frame;
+using Layer = ColorSettingHarness::Layer;
+
+constexpr hwc::Dataspace kSrgb = hwc::Dataspace::SRGB;
+constexpr hwc::Dataspace kPq = hwc::Dataspace::BT2020_PQ;
+constexpr hwc::Dataspace kHlg = hwc::Dataspace::BT2020_HLG;
+
+/* name and payload of the committed color properties the frame uses */
+using Committed = std::vector<std::pair<std::string, std::vector<uint8_t>>>;
+
+Committed committedColor(DrmDevice &drm, const Frame &frame) {
+    Committed committed;
+    auto add = [&](uint32_t objectId, const DrmProperty &prop, bool blob) {
+        uint64_t value = drm.committedValue(objectId, prop.id());
+        std::string name = std::to_string(objectId) + "." + prop.name();
+        if (!blob || !value) {
+            committed.emplace_back(name + "=" + std::to_string(value), std::vector<uint8_t>());
+            return;
+        }
+        std::vector<uint8_t> payload = drm.blobPayload(value);
+        /* a committed blob is held by the kernel */
+        EXPECT_FALSE(payload.empty()) << name;
+        committed.emplace_back(name, std::move(payload));
+    };
+
+    const DrmCrtc &crtc = *drm.crtc();
+    add(crtc.id(), crtc.cgc_lut_property(), true);
+    add(crtc.id(), crtc.degamma_lut_property(), true);
+    add(crtc.id(), crtc.gamma_lut_property(), true);
+    add(crtc.id(), crtc.gamma_matrix_property(), true);
+    add(crtc.id(), crtc.linear_matrix_property(), true);
+    add(crtc.id(), crtc.disp_dither_property(), true);
+    add(crtc.id(), crtc.cgc_dither_property(), true);
+    add(crtc.id(), crtc.force_bpc_property(), false);
+    for (auto &layer : frame.layers) {
+        const DrmPlane &plane = *drm.planes()[layer.plane];
+        add(plane.id(), plane.eotf_lut_property(), true);
+        add(plane.id(), plane.gammut_matrix_property(), true);
+        add(plane.id(), plane.tone_mapping_property(), true);
+        add(plane.id(), plane.oetf_lut_property(), true);
+    }
+    return committed;
+}
+
+void expectSameAsForced(const std::vector<Frame> &frames,
+                        const ColorSettingHarness::Options &options = {}) {
+    ColorSettingHarness harness(options);
+    ColorSettingHarness reference(options);
+    for (size_t i = 0; i < frames.size(); i++) {
+        Frame forced = frames[i];
+        forced.force = true;
+        bool committed = harness.present(frames[i]);
+        ASSERT_EQ(reference.present(forced), committed) << "frame " << i;
+        if (!committed)
+            continue;
+
+        Committed expected = committedColor(reference.drm(), frames[i]);
+        Committed actual = committedColor(harness.drm(), frames[i]);
+        ASSERT_EQ(actual.size(), expected.size());
+        for (size_t p = 0; p < expected.size(); p++) {
+            ASSERT_EQ(actual[p].first, expected[p].first) << "frame " << i;
+            ASSERT_EQ(actual[p].second, expected[p].second)
+                    << "frame " << i << ": " << actual[p].first;
+        }
+    }
+}
+
+/* @frame @count times, HWC presents steady scenes again and again */
+void repeat(std::vector<Frame> &frames, const Frame &frame, size_t count = 3) {
+    frames.insert(frames.end(), count, frame);
+}
+
+Frame frameOf(std::vector<Layer> layers) {
+    Frame frame;
+    frame.layers = std::move(layers);
+    return frame;
+}
+
+TEST(ColorSceneTransitionTest, LayerReturnsToAPlaneUsedByAnother) {
+    /* X leaves P1, Z is programmed on P1 at the same DPP index, X returns */
+    Frame x = frameOf({{0, 0, kSrgb}, {1, 1, kPq}});
+    Frame z = frameOf({{0, 0, kSrgb}, {2, 1, kHlg}});
+    std::vector<Frame> frames;
+    repeat(frames, x);
+    repeat(frames, z);
+    repeat(frames, x);
+    expectSameAsForced(frames);
+}
+
+TEST(ColorSceneTransitionTest, LayersSwapPlanes) {
+    std::vector<Frame> frames;
+    repeat(frames, frameOf({{0, 0, kSrgb}, {1, 1, kPq, true}}));
+    repeat(frames, frameOf({{0, 1, kSrgb}, {1, 0, kPq, true}}));
+    repeat(frames, frameOf({{1, 0, kPq, true}, {0, 1, kSrgb}}));
+    repeat(frames, frameOf({{0, 0, kSrgb}, {1, 1, kPq, true}}));
+    expectSameAsForced(frames);
+}
+
+TEST(ColorSceneTransitionTest, HdrStartsAndStops) {
+    Frame sdr = frameOf({{0, 0, kSrgb}});
+    Frame hdr = frameOf({{0, 0, kSrgb}, {1, 1, kPq}});
+    Frame hdr10Plus = frameOf({{0, 0, kSrgb}, {1, 1, kPq, true}});
+    std::vector<Frame> frames;
+    repeat(frames, sdr);
+    repeat(frames, hdr);
+    repeat(frames, hdr10Plus);
+    repeat(frames, hdr);
+    repeat(frames, sdr);
+    repeat(frames, hdr10Plus);
+    repeat(frames, sdr);
+    expectSameAsForced(frames);
+}
+
+TEST(ColorSceneTransitionTest, HbmAndLhbmToggle) {
+    Frame frame = frameOf({{0, 0, kSrgb}, {1, 1, kPq}});
+    std::vector<Frame> frames;
+    repeat(frames, frame);
+    frame.bm = BrightnessMode::BM_HBM;
+    repeat(frames, frame);
+    frame.lhbmOn = true;
+    repeat(frames, frame);
+    frame.bm = BrightnessMode::BM_NOMINAL;
+    repeat(frames, frame);
+    frame.lhbmOn = false;
+    repeat(frames, frame);
+    expectSameAsForced(frames);
+}
+
+TEST(ColorSceneTransitionTest, BrightnessTransitions) {
+    /* UpdatePresent() changes regamma and the HDR OETF of a steady scene */
+    ColorSettingHarness::Options options;
+    options.displayColor.dbvTransitionFrames = 8;
+    Frame frame = frameOf({{0, 0, kSrgb}, {1, 1, kPq}});
+    std::vector<Frame> frames;
+    for (uint32_t dbv : {1000u, 200u, 3000u, 3000u, 1500u}) {
+        frame.dbv = dbv;
+        repeat(frames, frame, 12);
+    }
+    /* a new target in the middle of a transition */
+    frame.dbv = 500;
+    repeat(frames, frame, 3);
+    frame.dbv = 2500;
+    repeat(frames, frame, 12);
+    expectSameAsForced(frames, options);
+}
+
+TEST(ColorSceneTransitionTest, ColorModeAndTransformChange) {
+    Frame frame = frameOf({{0, 0, kSrgb}, {1, 1, kHlg}});
+    std::vector<Frame> frames;
+    repeat(frames, frame);
+    frame.colorMode = hwc::ColorMode::DISPLAY_P3;
+    repeat(frames, frame);
+    frame.transform = true;
+    repeat(frames, frame);
+    frame.colorMode = hwc::ColorMode::SRGB;
+    repeat(frames, frame);
+    frame.transform = false;
+    repeat(frames, frame);
+    expectSameAsForced(frames);
+}
+
+TEST(ColorSceneTransitionTest, FailedCommits) {
+    Frame sdr = frameOf({{0, 0, kSrgb}, {1, 1, kSrgb}});
+    Frame hdr = frameOf({{0, 0, kSrgb}, {1, 1, kPq}});
+    Frame moved = frameOf({{0, 0, kSrgb}, {1, 2, kPq}});
+    std::vector<Frame> frames;
+    repeat(frames, sdr);
+    /* the change is committed by the frame after the failed one */
+    Frame failed = hdr;
+    failed.fail = true;
+    frames.push_back(failed);
+    repeat(frames, hdr);
+    /* and by a frame after several failed ones */
+    failed = sdr;
+    failed.fail = true;
+    repeat(frames, failed);
+    repeat(frames, hdr);
+    failed = moved;
+    failed.fail = true;
+    frames.push_back(failed);
+    repeat(frames, sdr);
+    repeat(frames, moved);
+    expectSameAsForced(frames);
+}
+
+TEST(ColorSceneTransitionTest, ForcedFramesGetNewBlobs) {
+    Frame frame = frameOf({{0, 0, kSrgb}, {1, 1, kPq, true}});
+    frame.transform = true;
+    ColorSettingHarness harness;
+    std::vector<Frame> frames;
+    repeat(frames, frame);
+    frame.force = true;
+    frames.push_back(frame);
+    repeat(frames, frameOf({{0, 0, kSrgb}, {1, 1, kPq, true}}));
+    expectSameAsForced(frames);
+
+    for (int i = 0; i < 3; i++)
+        ASSERT_TRUE(harness.present(frames[0]));
+    const DrmPlane &plane = *harness.drm().planes()[1];
+    uint64_t eotf = harness.drm().committedValue(plane.id(), plane.eotf_lut_property().id());
+    uint64_t gammaMatrix = harness.drm().committedValue(
+            harness.drm().crtc()->id(), harness.drm().crtc()->gamma_matrix_property().id());
+    ASSERT_NE(eotf, 0u);
+    ASSERT_NE(gammaMatrix, 0u);
+
+    /* the kernel ignores a property set to the blob it holds */
+    Frame forced = frames[0];
+    forced.force = true;
+    ASSERT_TRUE(harness.present(forced));
+    EXPECT_NE(harness.drm().committedValue(plane.id(), plane.eotf_lut_property().id()), eotf);
+    EXPECT_NE(harness.drm().committedValue(harness.drm().crtc()->id(),
+                                           harness.drm().crtc()->gamma_matrix_property().id()),
+              gammaMatrix);
+}
+
+/* A fixed pseudo-random mix of the transitions above, steady runs included */
+TEST(ColorSceneTransitionTest, MixedTransitions) {
+    ColorSettingHarness::Options options;
+    options.displayColor.dbvTransitionFrames = 4;
+
+    uint32_t state = 0x2545f491;
+    auto next = [&state](uint32_t n) {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) % n;
+    };
+    const hwc::Dataspace dataspaces[] = {kSrgb, kSrgb, kPq, kHlg};
+    const uint32_t dbvs[] = {300, 1000, 2000, 3000};
+
+    std::vector<Frame> frames;
+    Frame frame = frameOf({{0, 0, kSrgb}});
+    for (int i = 0; i < 3000; i++) {
+        if (next(3) == 0) {
+            frame = Frame();
+            std::vector<uint32_t> planes = {0, 1, 2, 3, 4, 5};
+            for (uint32_t id = 0; id < 4; id++) {
+                if (id && next(2))
+                    continue;
+                uint32_t p = next(planes.size());
+                hwc::Dataspace dataspace = dataspaces[(id + next(2)) % 4];
+                frame.layers.push_back({id, planes[p], dataspace, next(4) == 0});
+                planes.erase(planes.begin() + p);
+            }
+            if (next(2))
+                std::swap(frame.layers.front(), frame.layers.back());
+            frame.colorMode = next(4) ? hwc::ColorMode::SRGB : hwc::ColorMode::DISPLAY_P3;
+            frame.bm = next(6) ? BrightnessMode::BM_NOMINAL : BrightnessMode::BM_HBM;
+            frame.lhbmOn = next(8) == 0;
+            frame.dbv = dbvs[next(4)];
+            frame.transform = next(4) == 0;
+        }
+        Frame presented = frame;
+        presented.fail = next(20) == 0;
+        presented.force = next(50) == 0;
+        frames.push_back(presented);
+    }
+    expectSameAsForced(frames, options);
+}
+
+}  // namespace
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <functional>
+
+#include "ColorSettingHarness.h"
+
+/*
+ * Cost of the color setting of a frame, from DisplayScene to commit, with
+ * the displaycolor stand-in and the fake DrmDevice. The argument is the time
+ * each ioctl takes in us, to weigh the ioctls as a kernel would.
+ *
+ * Reported per frame: us (wall time of the frame), ioctls (blob ioctls and
+ * the commit) and blob_bytes (bytes of the blobs created).
+ */
+
+namespace {
+
+using Frame = ColorSettingHarness::Frame;
+
+/* Runs the frames of @sequence in a loop */
+void run(benchmark::State &state, const std::function<Frame(uint64_t)> &sequence) {
+    ColorSettingHarness::Options options;
+    options.drm.ioctlLatency = std::chrono::microseconds(state.range(0));
+    ColorSettingHarness harness(options);
+    /* the first frame creates every blob */
+    harness.present(sequence(0));
+    DrmDevice::Stats start = harness.drm().stats();
+
+    uint64_t frame = 1;
+    double us = 0;
+    for (auto _ : state) {
+        auto begin = std::chrono::steady_clock::now();
+        harness.present(sequence(frame++));
+        us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin)
+                      .count();
+    }
+
+    DrmDevice::Stats end = harness.drm().stats();
+    state.counters["us"] = benchmark::Counter(us, benchmark::Counter::kAvgIterations);
+    state.counters["ioctls"] = benchmark::Counter(static_cast<double>(end.ioctls - start.ioctls),
+                                                  benchmark::Counter::kAvgIterations);
+    state.counters["blob_bytes"] =
+            benchmark::Counter(static_cast<double>(end.createBytes - start.createBytes),
+                               benchmark::Counter::kAvgIterations);
+}
+
+Frame sdrFrame() {
+    Frame frame;
+    frame.layers = {{0, 0}, {1, 1}};
+    return frame;
+}
+
+void BM_SteadySdr(benchmark::State &state) {
+    run(state, [](uint64_t) { return sdrFrame(); });
+}
+BENCHMARK(BM_SteadySdr)->Arg(0)->Arg(20)->UseRealTime();
+
+/* An HDR video starts and stops every 8 frames */
+void BM_HdrStartStop(benchmark::State &state) {
+    run(state, [](uint64_t frame) {
+        Frame f = sdrFrame();
+        if ((frame / 8) % 2)
+            f.layers.push_back({2, 2, hwc::Dataspace::BT2020_PQ});
+        return f;
+    });
+}
+BENCHMARK(BM_HdrStartStop)->Arg(0)->Arg(20)->UseRealTime();
+
+/* HBM toggles every 4 frames, with an HDR layer */
+void BM_HbmToggle(benchmark::State &state) {
+    run(state, [](uint64_t frame) {
+        Frame f = sdrFrame();
+        f.layers.push_back({2, 2, hwc::Dataspace::BT2020_PQ});
+        f.bm = ((frame / 4) % 2) ? BrightnessMode::BM_HBM : BrightnessMode::BM_NOMINAL;
+        return f;
+    });
+}
+BENCHMARK(BM_HbmToggle)->Arg(0)->Arg(20)->UseRealTime();
+
+/* Six planes, three of them HDR, with the brightness changing every frame */
+void BM_SixPlanes(benchmark::State &state) {
+    run(state, [](uint64_t frame) {
+        Frame f;
+        f.colorMode = hwc::ColorMode::DISPLAY_P3;
+        f.layers = {{0, 0},
+                    {1, 1, hwc::Dataspace::BT2020_PQ, true},
+                    {2, 2, hwc::Dataspace::DISPLAY_P3},
+                    {3, 3, hwc::Dataspace::BT2020_HLG},
+                    {4, 4},
+                    {5, 5, hwc::Dataspace::BT2020_PQ, true}};
+        f.dbv = 1000 + static_cast<uint32_t>(frame % 64) * 16;
+        return f;
+    });
+}
+BENCHMARK(BM_SixPlanes)->Arg(0)->Arg(20)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COLOR_SETTING_HARNESS_H
+#define COLOR_SETTING_HARNESS_H
+
+#include <displaycolor_standin.h>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "../libmaindisplay/DisplaySceneTracker.h"
+#include "ExynosDisplayDrmInterfaceModule.h"
+#include "ExynosPrimaryDisplayModule.h"
+#include "FakeDrmDevice.h"
+
+/*
+ * Presents frames as ExynosPrimaryDisplayModule does: Update() and
+ * UpdatePresent() of the displaycolor stand-in as DisplaySceneTracker
+ * decides, then the color setting of ExynosDisplayDrmInterfaceModule as
+ * deliverWinConfigData() does, committed to the fake DrmDevice.
+ */
+class ColorSettingHarness {
+    public:
+        struct Options {
+            DrmDevice::Options drm;
+            displaycolor::standin::DisplayColorStandIn::Options displayColor;
+        };
+        /* A layer of a frame: which of the layers it is and the plane it is on */
+        struct Layer {
+            uint32_t id;
+            uint32_t plane;
+            hwc::Dataspace dataspace = hwc::Dataspace::SRGB;
+            bool hdr10Plus = false;
+        };
+        struct Frame {
+            /* in the order of DisplayScene::layer_data */
+            std::vector<Layer> layers;
+            hwc::ColorMode colorMode = hwc::ColorMode::SRGB;
+            BrightnessMode bm = BrightnessMode::BM_NOMINAL;
+            bool lhbmOn = false;
+            uint32_t dbv = 1000;
+            /* color transform, identity if false */
+            bool transform = false;
+            /* the setting is forced, as for a readback */
+            bool force = false;
+            /* the commit fails */
+            bool fail = false;
+        };
+
+        static constexpr uint32_t kMaxLayers = 8;
+
+        ColorSettingHarness() : ColorSettingHarness(Options()) {}
+        explicit ColorSettingHarness(const Options &options)
+              : mDrm(options.drm),
+                mDisplayColor(options.displayColor),
+                mDisplay(&mDisplayColor),
+                mModule(&mDisplay),
+                mMpps(options.drm.planes) {
+            mModule.initDrmDevice(&mDrm);
+        }
+
+        /* Returns whether the frame was committed */
+        bool present(const Frame &frame) {
+            DisplayScene scene = makeScene(frame);
+            bool mappingChanged = !mPresented || !sameLayers(frame, mLastFrame);
+            uint64_t sceneHash = DisplaySceneTracker::sceneHash(scene);
+            if (!mTracker.skipUpdate(mappingChanged, sceneHash)) {
+                mDisplayColor.Update(DisplayType::DISPLAY_PRIMARY, scene);
+                mTracker.updated(sceneHash);
+            }
+            mDisplayColor.UpdatePresent(DisplayType::DISPLAY_PRIMARY, scene);
+            const auto *pipeline = mDisplayColor.GetPipelineData(DisplayType::DISPLAY_PRIMARY);
+            mTracker.presented(pipeline->Dqe(), pipeline->Dpp());
+
+            mDisplay.resetLayerDataMappingInfo();
+            for (uint32_t i = 0; i < frame.layers.size(); i++)
+                mDisplay.setLayerDataMappingInfo(&mLayers[frame.layers[i].id], i);
+
+            mModule.setColorSettingChanged(mTracker.needColorSetting(), frame.force);
+            mModule.prepareColorBlobs();
+            ExynosDisplayDrmInterface::DrmModeAtomicReq drmReq;
+            int32_t ret = mModule.setDisplayColorSetting(drmReq);
+            for (auto &layer : frame.layers) {
+                ExynosMPP &mpp = mMpps[layer.plane];
+                mpp.mAssignedSources = {&mLayers[layer.id]};
+                exynos_win_config_data config;
+                config.assignedMPP = &mpp;
+                if (ret == NO_ERROR)
+                    ret = mModule.setPlaneColorSetting(drmReq, mDrm.planes()[layer.plane],
+                                                       config);
+            }
+            bool committed = (ret == NO_ERROR) && mDrm.commit(drmReq.values(), frame.fail);
+            mModule.colorSettingDelivered(committed);
+
+            mLastFrame = frame;
+            mPresented = true;
+            return committed;
+        }
+
+        DrmDevice &drm() { return mDrm; }
+        displaycolor::standin::DisplayColorStandIn &displayColor() { return mDisplayColor; }
+        ExynosDisplayDrmInterfaceModule &module() { return mModule; }
+
+    private:
+        static DisplayScene makeScene(const Frame &frame) {
+            DisplayScene scene;
+            for (auto &layer : frame.layers) {
+                LayerColorData data;
+                data.dataspace = layer.dataspace;
+                if (layer.hdr10Plus) {
+                    auto &metadata = data.dynamic_metadata;
+                    metadata.is_valid = true;
+                    metadata.tm_flag = 1;
+                    metadata.display_maximum_luminance = 500;
+                    metadata.maxscl = {40000, 40000, 40000};
+                    metadata.tm_knee_x = 1000;
+                    metadata.tm_knee_y = 1500;
+                    metadata.bezier_curve_anchors = {300, 600, 800};
+                }
+                scene.layer_data.push_back(data);
+            }
+            scene.color_mode = frame.colorMode;
+            scene.render_intent = hwc::RenderIntent::COLORIMETRIC;
+            for (size_t i = 0; i < scene.matrix.size(); i++)
+                scene.matrix[i] = (i % 5 == 0) ? (frame.transform ? 0.9f : 1.0f) : 0.0f;
+            scene.bm = frame.bm;
+            scene.lhbm_on = frame.lhbmOn;
+            scene.dbv = frame.dbv;
+            return scene;
+        }
+
+        /* The same layers map to the same DPPs */
+        static bool sameLayers(const Frame &a, const Frame &b) {
+            if (a.layers.size() != b.layers.size())
+                return false;
+            for (size_t i = 0; i < a.layers.size(); i++) {
+                if (a.layers[i].id != b.layers[i].id)
+                    return false;
+            }
+            return true;
+        }
+
+        DrmDevice mDrm;
+        displaycolor::standin::DisplayColorStandIn mDisplayColor;
+        ExynosPrimaryDisplayModule mDisplay;
+        ExynosDisplayDrmInterfaceModule mModule;
+        std::array<ExynosLayer, kMaxLayers> mLayers;
+        /* by plane */
+        std::vector<ExynosMPP> mMpps;
+        DisplaySceneTracker mTracker;
+        Frame mLastFrame;
+        bool mPresented = false;
+};
+
+#endif // COLOR_SETTING_HARNESS_H
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <drm/samsung_drm.h>
+#include <gtest/gtest.h>
+
+#include "ColorSettingHarness.h"
+
+namespace {
+
+using Frame = ColorSettingHarness::Frame;
+
+Frame sdrAndHdrFrame() {
+    Frame frame;
+    frame.layers = {{0, 0, hwc::Dataspace::SRGB}, {1, 1, hwc::Dataspace::BT2020_PQ}};
+    return frame;
+}
+
+TEST(ColorSettingTest, SetsThePlaneOfAnHdrLayer) {
+    ColorSettingHarness harness;
+    ASSERT_TRUE(harness.present(sdrAndHdrFrame()));
+
+    const DrmPlane &plane = *harness.drm().planes()[1];
+    uint64_t eotf = harness.drm().committedValue(plane.id(), plane.eotf_lut_property().id());
+    ASSERT_NE(eotf, 0u);
+    EXPECT_EQ(harness.drm().blobPayload(eotf).size(), sizeof(hdr_eotf_lut));
+
+    const DrmPlane &sdrPlane = *harness.drm().planes()[0];
+    EXPECT_EQ(harness.drm().committedValue(sdrPlane.id(), sdrPlane.eotf_lut_property().id()),
+              0u);
+}
+
+TEST(ColorSettingTest, SteadyFramesMakeNoBlobIoctls) {
+    ColorSettingHarness harness;
+    Frame frame = sdrAndHdrFrame();
+    ASSERT_TRUE(harness.present(frame));
+    ASSERT_TRUE(harness.present(frame));
+
+    /* the commit is the only ioctl */
+    uint64_t ioctls = harness.drm().stats().ioctls;
+    ASSERT_TRUE(harness.present(frame));
+    EXPECT_EQ(harness.drm().stats().ioctls, ioctls + 1);
+    EXPECT_TRUE(harness.drm().replaced().empty());
+}
+
+}  // namespace
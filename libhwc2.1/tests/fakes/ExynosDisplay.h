@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FAKE_EXYNOS_DISPLAY_H
+#define FAKE_EXYNOS_DISPLAY_H
+
+#include <system/graphics.h>
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Host stand-ins of the libhwc2.1 common classes, with the members the gs101
+ * color setting uses.
+ */
+
+enum {
+    MPP_SOURCE_COMPOSITION_TARGET,
+    MPP_SOURCE_LAYER,
+    MPP_SOURCE_MAX
+};
+
+class ExynosMPP;
+
+struct exynos_image {
+    android_dataspace dataSpace = HAL_DATASPACE_UNKNOWN;
+};
+
+class ExynosMPPSource {
+    public:
+        explicit ExynosMPPSource(uint32_t sourceType) : mSourceType(sourceType) {}
+        virtual ~ExynosMPPSource() = default;
+        uint32_t mSourceType;
+        exynos_image mSrcImg;
+        exynos_image mMidImg;
+};
+
+class ExynosLayer : public ExynosMPPSource {
+    public:
+        ExynosLayer() : ExynosMPPSource(MPP_SOURCE_LAYER) {}
+        ExynosMPP *mM2mMPP = nullptr;
+};
+
+class ExynosMPP {
+    public:
+        std::vector<ExynosMPPSource *> mAssignedSources;
+};
+
+struct exynos_win_config_data {
+    ExynosMPP *assignedMPP = nullptr;
+};
+
+class ExynosDisplay {
+    public:
+        virtual ~ExynosDisplay() = default;
+};
+
+#endif // FAKE_EXYNOS_DISPLAY_H
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FAKE_EXYNOS_DISPLAY_DRM_INTERFACE_H
+#define FAKE_EXYNOS_DISPLAY_DRM_INTERFACE_H
+
+#include <log/log.h>
+#include <utils/Errors.h>
+
+#include <cinttypes>
+#include <cstring>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ExynosDisplay.h"
+#include "FakeDrmDevice.h"
+
+using namespace android;
+
+#define HWC_LOGE(display, msg, ...) ALOGE(msg, ##__VA_ARGS__)
+
+using DrmPropertyMap = std::unordered_map<uint32_t, uint64_t>;
+
+/*
+ * Host stand-in of the common ExynosDisplayDrmInterface: an atomic request
+ * collects the properties the gs101 module sets, for DrmDevice::commit().
+ */
+class ExynosDisplayDrmInterface {
+    public:
+        class DrmModeAtomicReq {
+            public:
+                int atomicAddProperty(const uint32_t id, const DrmProperty &property,
+                        uint64_t value, bool optional = false) {
+                    if (!property.id())
+                        return optional ? NO_ERROR : -EINVAL;
+                    mValues.push_back({id, property.id(), value});
+                    return NO_ERROR;
+                }
+                const std::vector<DrmDevice::PropertyValue> &values() const {
+                    return mValues;
+                }
+            private:
+                std::vector<DrmDevice::PropertyValue> mValues;
+        };
+
+        explicit ExynosDisplayDrmInterface(ExynosDisplay *exynosDisplay)
+              : mExynosDisplay(exynosDisplay) {}
+        virtual ~ExynosDisplayDrmInterface() = default;
+        virtual int32_t initDrmDevice(DrmDevice *drmDevice) {
+            mDrmDevice = drmDevice;
+            mDrmCrtc = drmDevice->crtc();
+            return NO_ERROR;
+        }
+        bool isPrimary() { return true; }
+
+        /* The fake properties have no enums, values map to themselves */
+        static void parseEnums(const DrmProperty &,
+                const std::vector<std::pair<uint32_t, const char *>> &enums,
+                DrmPropertyMap &out_enums) {
+            for (auto &e : enums)
+                out_enums[e.first] = e.first;
+        }
+        static std::tuple<uint64_t, int> halToDrmEnum(const int32_t halData,
+                const DrmPropertyMap &drmEnums) {
+            auto it = drmEnums.find(halData);
+            if (it == drmEnums.end())
+                return std::make_tuple(0, -EINVAL);
+            return std::make_tuple(it->second, NO_ERROR);
+        }
+
+    protected:
+        ExynosDisplay *mExynosDisplay;
+        DrmDevice *mDrmDevice = nullptr;
+        DrmCrtc *mDrmCrtc = nullptr;
+};
+
+#endif // FAKE_EXYNOS_DISPLAY_DRM_INTERFACE_H
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FAKE_EXYNOS_PRIMARY_DISPLAY_MODULE_H
+#define FAKE_EXYNOS_PRIMARY_DISPLAY_MODULE_H
+
+#include <gs101/displaycolor/displaycolor_gs101.h>
+
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "ExynosDisplay.h"
+
+using namespace displaycolor;
+
+/*
+ * Host stand-in of the primary display of gs101, with the DPP lookups
+ * ExynosDisplayDrmInterfaceModule makes. The test maps the layers of a frame
+ * to the layer data of the scene it passes to displaycolor.
+ */
+class ExynosPrimaryDisplayModule : public ExynosDisplay {
+    public:
+        explicit ExynosPrimaryDisplayModule(IDisplayColorGS101 *displayColor)
+              : mDisplayColorInterface(displayColor) {}
+
+        int initDisplayColor() {
+            return mDisplayColorInterface == nullptr ? -EINVAL : NO_ERROR;
+        }
+
+        /* Map @layer to DisplayScene::layer_data[@dppIdx] in the next frame */
+        void setLayerDataMappingInfo(ExynosMPPSource *layer, uint32_t dppIdx) {
+            mLayerDataMappingInfo[layer].dppIdx = dppIdx;
+        }
+        /* Call once the pipeline data is updated for a new frame */
+        void resetLayerDataMappingInfo() {
+            mLayerDataMappingInfo.clear();
+            mDppsValid = false;
+        }
+
+        bool hasDppForLayer(ExynosMPPSource *layer) {
+            auto it = mLayerDataMappingInfo.find(layer);
+            return (it != mLayerDataMappingInfo.end()) && (it->second.dppIdx < getDpps().size());
+        }
+        const IDisplayColorGS101::IDpp &getDppForLayer(ExynosMPPSource *layer) {
+            return getDpps()[mLayerDataMappingInfo[layer].dppIdx].get();
+        }
+        int32_t getDppIndexForLayer(ExynosMPPSource *layer) {
+            auto it = mLayerDataMappingInfo.find(layer);
+            return (it == mLayerDataMappingInfo.end()) ? -1
+                                                       : static_cast<int32_t>(it->second.dppIdx);
+        }
+
+        size_t getNumOfDpp() { return getDpps().size(); }
+        const IDisplayColorGS101::IDpp &getDpp(size_t index) { return getDpps()[index].get(); }
+        const IDisplayColorGS101::IDqe &getDqe() {
+            return mDisplayColorInterface->GetPipelineData(DisplayType::DISPLAY_PRIMARY)->Dqe();
+        }
+
+    private:
+        struct LayerMappingInfo {
+            uint32_t dppIdx;
+        };
+
+        const std::vector<std::reference_wrapper<const IDisplayColorGS101::IDpp>> &getDpps() {
+            if (!mDppsValid) {
+                mDpps = mDisplayColorInterface->GetPipelineData(DisplayType::DISPLAY_PRIMARY)
+                                ->Dpp();
+                mDppsValid = true;
+            }
+            return mDpps;
+        }
+
+        IDisplayColorGS101 *mDisplayColorInterface;
+        std::map<ExynosMPPSource *, LayerMappingInfo> mLayerDataMappingInfo;
+        std::vector<std::reference_wrapper<const IDisplayColorGS101::IDpp>> mDpps;
+        bool mDppsValid = false;
+};
+
+#endif // FAKE_EXYNOS_PRIMARY_DISPLAY_MODULE_H
@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FAKE_DRM_DEVICE_H
+#define FAKE_DRM_DEVICE_H
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Host stand-ins of the DRM objects of libdrmresource, with the members the
+ * gs101 modules use. DrmDevice keeps the property blobs and the committed
+ * state of the objects in memory, counts the ioctls and can be made as slow
+ * as a kernel.
+ */
+
+class DrmProperty {
+    public:
+        DrmProperty() = default;
+        DrmProperty(uint32_t id, const char *name, uint64_t value = 0)
+              : mId(id), mName(name), mValue(value) {}
+        /* 0 if the object does not have the property */
+        uint32_t id() const { return mId; }
+        const std::string &name() const { return mName; }
+        std::tuple<int, uint64_t> value() const {
+            return std::make_tuple(mId ? 0 : -ENOENT, mValue);
+        }
+    private:
+        uint32_t mId = 0;
+        std::string mName;
+        uint64_t mValue = 0;
+};
+
+class DrmPlane {
+    public:
+        DrmPlane(uint32_t id, uint32_t firstPropId)
+              : mId(id),
+                mEotfLut(firstPropId, "eotf_lut"),
+                mGammutMatrix(firstPropId + 1, "gammut_matrix"),
+                mToneMapping(firstPropId + 2, "tone_mapping"),
+                mOetfLut(firstPropId + 3, "oetf_lut") {}
+        uint32_t id() const { return mId; }
+        const DrmProperty &eotf_lut_property() const { return mEotfLut; }
+        const DrmProperty &gammut_matrix_property() const { return mGammutMatrix; }
+        const DrmProperty &tone_mapping_property() const { return mToneMapping; }
+        const DrmProperty &oetf_lut_property() const { return mOetfLut; }
+        static constexpr uint32_t kPropertyCount = 4;
+    private:
+        uint32_t mId;
+        DrmProperty mEotfLut;
+        DrmProperty mGammutMatrix;
+        DrmProperty mToneMapping;
+        DrmProperty mOetfLut;
+};
+
+class DrmCrtc {
+    public:
+        DrmCrtc(uint32_t id, uint32_t firstPropId, uint64_t degammaLutSize,
+                uint64_t gammaLutSize)
+              : mId(id),
+                mCgcLut(firstPropId, "cgc_lut"),
+                mDegammaLut(firstPropId + 1, "degamma_lut"),
+                mDegammaLutSize(firstPropId + 2, "degamma_lut_size", degammaLutSize),
+                mGammaLut(firstPropId + 3, "gamma_lut"),
+                mGammaLutSize(firstPropId + 4, "gamma_lut_size", gammaLutSize),
+                mGammaMatrix(firstPropId + 5, "gamma_matrix"),
+                mLinearMatrix(firstPropId + 6, "linear_matrix"),
+                mDispDither(firstPropId + 7, "disp_dither"),
+                mCgcDither(firstPropId + 8, "cgc_dither"),
+                mForceBpc(firstPropId + 9, "force_bpc") {}
+        uint32_t id() const { return mId; }
+        const DrmProperty &cgc_lut_property() const { return mCgcLut; }
+        const DrmProperty &degamma_lut_property() const { return mDegammaLut; }
+        const DrmProperty &degamma_lut_size_property() const { return mDegammaLutSize; }
+        const DrmProperty &gamma_lut_property() const { return mGammaLut; }
+        const DrmProperty &gamma_lut_size_property() const { return mGammaLutSize; }
+        const DrmProperty &gamma_matrix_property() const { return mGammaMatrix; }
+        const DrmProperty &linear_matrix_property() const { return mLinearMatrix; }
+        const DrmProperty &disp_dither_property() const { return mDispDither; }
+        const DrmProperty &cgc_dither_property() const { return mCgcDither; }
+        const DrmProperty &force_bpc_property() const { return mForceBpc; }
+        static constexpr uint32_t kPropertyCount = 10;
+    private:
+        uint32_t mId;
+        DrmProperty mCgcLut;
+        DrmProperty mDegammaLut;
+        DrmProperty mDegammaLutSize;
+        DrmProperty mGammaLut;
+        DrmProperty mGammaLutSize;
+        DrmProperty mGammaMatrix;
+        DrmProperty mLinearMatrix;
+        DrmProperty mDispDither;
+        DrmProperty mCgcDither;
+        DrmProperty mForceBpc;
+};
+
+class DrmDevice {
+    public:
+        struct Options {
+            uint32_t planes = 6;
+            /* time each blob ioctl takes */
+            std::chrono::microseconds ioctlLatency{0};
+        };
+        /* An object property as set in an atomic request */
+        struct PropertyValue {
+            uint32_t objectId;
+            uint32_t propertyId;
+            uint64_t value;
+        };
+        struct Stats {
+            uint64_t ioctls = 0;
+            uint64_t creates = 0;
+            uint64_t createBytes = 0;
+            uint64_t destroys = 0;
+            /* blobs not destroyed by the user yet */
+            size_t live = 0;
+            size_t liveBytes = 0;
+            size_t maxLive = 0;
+            size_t maxLiveBytes = 0;
+        };
+
+        DrmDevice() : DrmDevice(Options()) {}
+        explicit DrmDevice(const Options &options) : mOptions(options) {
+            uint32_t propId = 1000;
+            mCrtc = std::make_unique<DrmCrtc>(1, propId, 65, 65);
+            propId += DrmCrtc::kPropertyCount;
+            for (uint32_t i = 0; i < options.planes; i++) {
+                mPlanes.push_back(std::make_unique<DrmPlane>(100 + i, propId));
+                propId += DrmPlane::kPropertyCount;
+            }
+        }
+
+        int CreatePropertyBlob(void *data, size_t length, uint32_t *blob_id) {
+            ioctl();
+            if ((data == nullptr) || (length == 0))
+                return -EINVAL;
+
+            std::lock_guard<std::mutex> lock(mMutex);
+            uint32_t id = mNextBlobId++;
+            const uint8_t *bytes = static_cast<const uint8_t *>(data);
+            mBlobs[id] = Blob{std::vector<uint8_t>(bytes, bytes + length), true, 0};
+            mStats.creates++;
+            mStats.createBytes += length;
+            mStats.live++;
+            mStats.liveBytes += length;
+            mStats.maxLive = std::max(mStats.maxLive, mStats.live);
+            mStats.maxLiveBytes = std::max(mStats.maxLiveBytes, mStats.liveBytes);
+            *blob_id = id;
+            return 0;
+        }
+
+        int DestroyPropertyBlob(uint32_t blob_id) {
+            ioctl();
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto it = mBlobs.find(blob_id);
+            if ((it == mBlobs.end()) || !it->second.owned)
+                return -ENOENT;
+
+            it->second.owned = false;
+            mStats.destroys++;
+            mStats.live--;
+            mStats.liveBytes -= it->second.payload.size();
+            /* the kernel keeps a blob while a committed property holds it */
+            if (it->second.committedRefs == 0)
+                mBlobs.erase(it);
+            return 0;
+        }
+
+        DrmCrtc *crtc() const { return mCrtc.get(); }
+        const std::vector<std::unique_ptr<DrmPlane>> &planes() const { return mPlanes; }
+
+        /*
+         * Commit the properties of an atomic request. A blob property holds
+         * the blob until it is replaced. Fails without a change if @fail or
+         * if a blob does not exist.
+         */
+        bool commit(const std::vector<PropertyValue> &values, bool fail = false) {
+            ioctl();
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCommits++;
+            for (auto &value : values) {
+                if (isBlobProperty(value.propertyId) && value.value &&
+                    (mBlobs.count(value.value) == 0))
+                    fail = true;
+            }
+            if (fail)
+                return false;
+
+            mReplaced.clear();
+            for (auto &value : values) {
+                auto key = std::make_pair(value.objectId, value.propertyId);
+                uint64_t &committed = mCommitted[key];
+                if (committed == value.value)
+                    continue;
+                if (isBlobProperty(value.propertyId)) {
+                    if (value.value)
+                        mBlobs[value.value].committedRefs++;
+                    unreference(committed);
+                }
+                committed = value.value;
+                mReplaced.push_back(value);
+            }
+            return true;
+        }
+
+        /* Value of a property in the committed state, 0 if never set */
+        uint64_t committedValue(uint32_t objectId, uint32_t propertyId) const {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto it = mCommitted.find(std::make_pair(objectId, propertyId));
+            return (it == mCommitted.end()) ? 0 : it->second;
+        }
+        /* Payload of a blob the kernel has, empty if none */
+        std::vector<uint8_t> blobPayload(uint64_t blobId) const {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto it = mBlobs.find(static_cast<uint32_t>(blobId));
+            return (it == mBlobs.end()) ? std::vector<uint8_t>() : it->second.payload;
+        }
+        /* Properties whose value the last successful commit changed */
+        std::vector<PropertyValue> replaced() const {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mReplaced;
+        }
+        /* Blobs the kernel holds: not destroyed yet, or held by a property */
+        size_t kernelBlobs() const {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mBlobs.size();
+        }
+        Stats stats() const {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mStats;
+        }
+        uint64_t commits() const {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mCommits;
+        }
+
+    private:
+        struct Blob {
+            std::vector<uint8_t> payload;
+            /* not destroyed by the user */
+            bool owned;
+            /* committed properties holding the blob */
+            uint32_t committedRefs;
+        };
+
+        void ioctl() {
+            if (mOptions.ioctlLatency.count())
+                std::this_thread::sleep_for(mOptions.ioctlLatency);
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStats.ioctls++;
+        }
+
+        bool isBlobProperty(uint32_t propertyId) const {
+            const DrmProperty *notBlobs[] = {&mCrtc->degamma_lut_size_property(),
+                                             &mCrtc->gamma_lut_size_property(),
+                                             &mCrtc->force_bpc_property()};
+            return std::none_of(std::begin(notBlobs), std::end(notBlobs),
+                                [propertyId](const DrmProperty *prop) {
+                                    return prop->id() == propertyId;
+                                });
+        }
+
+        void unreference(uint64_t blobId) {
+            auto it = mBlobs.find(static_cast<uint32_t>(blobId));
+            if (it == mBlobs.end())
+                return;
+            if ((--it->second.committedRefs == 0) && !it->second.owned)
+                mBlobs.erase(it);
+        }
+
+        const Options mOptions;
+        std::unique_ptr<DrmCrtc> mCrtc;
+        std::vector<std::unique_ptr<DrmPlane>> mPlanes;
+
+        mutable std::mutex mMutex;
+        uint32_t mNextBlobId = 1;
+        std::unordered_map<uint32_t, Blob> mBlobs;
+        std::map<std::pair<uint32_t, uint32_t>, uint64_t> mCommitted;
+        std::vector<PropertyValue> mReplaced;
+        uint64_t mCommits = 0;
+        Stats mStats;
+};
+
+#endif // FAKE_DRM_DEVICE_H
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FAKE_SAMSUNG_DRM_H
+#define FAKE_SAMSUNG_DRM_H
+
+#include <linux/types.h>
+
+/*
+ * The color structures of the Samsung DRM uapi of gs101 and drm_color_lut,
+ * for host builds without the kernel headers.
+ */
+
+struct drm_color_lut {
+    __u16 red;
+    __u16 green;
+    __u16 blue;
+    __u16 reserved;
+};
+
+#define DRM_SAMSUNG_CGC_LUT_REG_CNT 2457
+
+struct cgc_lut {
+    __u32 r_values[DRM_SAMSUNG_CGC_LUT_REG_CNT];
+    __u32 g_values[DRM_SAMSUNG_CGC_LUT_REG_CNT];
+    __u32 b_values[DRM_SAMSUNG_CGC_LUT_REG_CNT];
+};
+
+#define DRM_SAMSUNG_MATRIX_DIMENS 3
+
+struct exynos_matrix {
+    __u16 coeffs[DRM_SAMSUNG_MATRIX_DIMENS * DRM_SAMSUNG_MATRIX_DIMENS];
+    __u16 offsets[DRM_SAMSUNG_MATRIX_DIMENS];
+};
+
+#define DRM_SAMSUNG_HDR_EOTF_LUT_LEN 129
+
+struct hdr_eotf_lut {
+    __u16 posx[DRM_SAMSUNG_HDR_EOTF_LUT_LEN];
+    __u32 posy[DRM_SAMSUNG_HDR_EOTF_LUT_LEN];
+};
+
+#define DRM_SAMSUNG_HDR_OETF_LUT_LEN 33
+
+struct hdr_oetf_lut {
+    __u16 posx[DRM_SAMSUNG_HDR_OETF_LUT_LEN];
+    __u16 posy[DRM_SAMSUNG_HDR_OETF_LUT_LEN];
+};
+
+#define DRM_SAMSUNG_HDR_GM_DIMENS 3
+
+struct hdr_gm_data {
+    __u32 coeffs[DRM_SAMSUNG_HDR_GM_DIMENS * DRM_SAMSUNG_HDR_GM_DIMENS];
+    __u32 offsets[DRM_SAMSUNG_HDR_GM_DIMENS];
+};
+
+#define DRM_SAMSUNG_HDR_TM_LUT_LEN 33
+
+struct hdr_tm_data {
+    __u16 coeff_r;
+    __u16 coeff_g;
+    __u16 coeff_b;
+    __u16 rng_x_min;
+    __u16 rng_x_max;
+    __u16 rng_y_min;
+    __u16 rng_y_max;
+    __u16 posx[DRM_SAMSUNG_HDR_TM_LUT_LEN];
+    __u32 posy[DRM_SAMSUNG_HDR_TM_LUT_LEN];
+};
+
+#endif // FAKE_SAMSUNG_DRM_H